@@ -50,6 +50,7 @@
 #include "cam_INDI.h"
 
 Camera_INDIClass::Camera_INDIClass() 
+    : m_blobCond(m_blobLock)
 {
     ClearStatus();
     // load the values from the current profile
@@ -83,6 +84,13 @@ void Camera_INDIClass::ClearStatus()
     pulseGuideEW_prop = NULL;
     // gui self destroy on lost connection
     gui = NULL;
+    // reset the blob and frame status
+    cam_bp = NULL;
+    m_blobReady = false;
+    m_maxSize = wxSize();
+    m_roi = wxRect();
+    // set once the driver shows a CCD_FRAME property
+    HasSubframes = false;
     // reset connection status
     has_blob = false;
     Connected = false;
@@ -132,6 +140,9 @@ void Camera_INDIClass::newNumber(INumberVectorProperty *nvp)
 {
     // we go here every time a Number value change
     //printf("Camera Receving Number: %s = %g\n", nvp->name, nvp->np->value);
+    if (nvp == binning_prop) {
+	UpdateFrameSize();
+    }
 }
 
 void Camera_INDIClass::newText(ITextVectorProperty *tvp)
@@ -147,11 +158,15 @@ void  Camera_INDIClass::newBLOB(IBLOB *bp)
     //printf("Got camera blob %s \n",bp->name);
     if (expose_prop) {
 	if (strcmp(bp->name,INDICameraBlobName)==0){
-	cam_bp = bp;
-	modal = false;
+	    // wake up Capture() waiting on the worker thread
+	    wxMutexLocker lock(m_blobLock);
+	    cam_bp = bp;
+	    m_blobReady = true;
+	    m_blobCond.Signal();
 	}
     }
     else if (video_prop){
+	wxMutexLocker lock(m_blobLock);
 	cam_bp = bp;
 	// TODO : cumulate the frames received during exposure
     }
@@ -178,6 +193,7 @@ void Camera_INDIClass::newProperty(INDI::Property *property)
     else if ((strcmp(PropName, INDICameraCCDCmd+"FRAME") == 0) && Proptype == INDI_NUMBER) {
 	//printf("Found CCD_FRAME for %s %s\n", DeviName, PropName);
 	frame_prop = property->getNumber();
+	HasSubframes = true;
     }
     else if ((strcmp(PropName, INDICameraCCDCmd+"FRAME_TYPE") == 0) && Proptype == INDI_SWITCH) {
 	//printf("Found CCD_FRAME_TYPE for %s %s\n", DeviName, PropName);
@@ -186,6 +202,7 @@ void Camera_INDIClass::newProperty(INDI::Property *property)
     else if ((strcmp(PropName, INDICameraCCDCmd+"BINNING") == 0) && Proptype == INDI_NUMBER) {
 	//printf("Found CCD_BINNING for %s %s\n",DeviName, PropName);
 	binning_prop = property->getNumber();
+	UpdateFrameSize();
     }
     else if ((strcmp(PropName, "VIDEO_STREAM") == 0) && Proptype == INDI_SWITCH) {
 	//printf("Found Video %s %s\n",DeviName, PropName);
@@ -213,7 +230,8 @@ void Camera_INDIClass::newProperty(INDI::Property *property)
     }
     else if (strcmp(PropName, INDICameraCCDCmd+"INFO") == 0 && Proptype == INDI_NUMBER) {
         PixelSize = IUFindNumber(property->getNumber(),"CCD_PIXEL_SIZE")->value;
-	FullSize = wxSize(IUFindNumber(property->getNumber(),"CCD_MAX_X")->value,IUFindNumber(property->getNumber(),"CCD_MAX_Y")->value);
+	m_maxSize = wxSize(IUFindNumber(property->getNumber(),"CCD_MAX_X")->value,IUFindNumber(property->getNumber(),"CCD_MAX_Y")->value);
+	UpdateFrameSize();
     }
     
     CheckState();
@@ -373,7 +391,91 @@ void  Camera_INDIClass::SetCCDdevice()
     } 
 }
 
-bool Camera_INDIClass::ReadFITS(usImage& img) 
+void Camera_INDIClass::GetBinning(int *binX, int *binY)
+{
+    *binX = *binY = 1;
+    if (binning_prop) {
+        INumber *hor = IUFindNumber(binning_prop, "HOR_BIN");
+        INumber *ver = IUFindNumber(binning_prop, "VER_BIN");
+        if (hor && hor->value >= 1)
+            *binX = (int) hor->value;
+        if (ver && ver->value >= 1)
+            *binY = (int) ver->value;
+    }
+}
+
+// CCD_INFO gives the sensor size in unbinned pixels, the images we
+// receive are binned
+void Camera_INDIClass::UpdateFrameSize(void)
+{
+    if (m_maxSize.x <= 0 || m_maxSize.y <= 0)
+        return;
+
+    int binX, binY;
+    GetBinning(&binX, &binY);
+    FullSize = wxSize(m_maxSize.x / binX, m_maxSize.y / binY);
+}
+
+// Ask the server to send only the given part of the frame, in binned
+// pixels; returns true if the driver has no CCD_FRAME property or the
+// sensor size is not known yet, so the server sends whatever it has.
+bool Camera_INDIClass::SetROI(const wxRect& roi)
+{
+    if (!frame_prop || m_maxSize.x <= 0 || m_maxSize.y <= 0)
+        return true;
+
+    // CCD_FRAME is in unbinned pixels
+    int binX, binY;
+    GetBinning(&binX, &binY);
+    wxRect frame(roi.x * binX, roi.y * binY, roi.width * binX, roi.height * binY);
+    if (frame == m_roi)
+        return false;
+
+    INumber *x = IUFindNumber(frame_prop, "X");
+    INumber *y = IUFindNumber(frame_prop, "Y");
+    INumber *w = IUFindNumber(frame_prop, "WIDTH");
+    INumber *h = IUFindNumber(frame_prop, "HEIGHT");
+    if (!x || !y || !w || !h)
+        return true;
+
+    Debug.AddLine("INDI Camera: set frame (%d,%d)+(%d,%d) bin %dx%d", frame.x, frame.y, frame.width, frame.height, binX, binY);
+
+    x->value = frame.x;
+    y->value = frame.y;
+    w->value = frame.width;
+    h->value = frame.height;
+    sendNewNumber(frame_prop);
+
+    m_roi = frame;
+    return false;
+}
+
+// Wait for newBLOB to deliver the image; returns true on timeout or
+// when the worker thread is terminating.
+bool Camera_INDIClass::WaitForBLOB(const CameraWatchdog& watchdog)
+{
+    while (true)
+    {
+        {
+            wxMutexLocker lock(m_blobLock);
+            if (!m_blobReady)
+                m_blobCond.WaitTimeout(100);
+            if (m_blobReady)
+                return false;
+        }
+
+        if (WorkerThread::TerminateRequested())
+            return true;
+
+        if (watchdog.Expired())
+        {
+            DisconnectWithAlert(CAPT_FAIL_TIMEOUT);
+            return true;
+        }
+    }
+}
+
+bool Camera_INDIClass::ReadFITS(usImage& img, bool useSubframe, const wxRect& subframe) 
 {
     int xsize, ysize;
     fitsfile *fptr;  // FITS file pointer
@@ -414,13 +516,30 @@ bool Camera_INDIClass::ReadFITS(usImage& img)
         PHD_fits_close_file(fptr);
         return true;
     }
-    if (img.Init(xsize,ysize)) {
+    // the server may ignore CCD_FRAME and send the full frame; only place
+    // the rows in the full frame if the image really is the subframe
+    if (useSubframe && (xsize != subframe.width || ysize != subframe.height || !wxRect(FullSize).Contains(subframe)))
+        useSubframe = false;
+
+    if (img.Init(useSubframe ? FullSize : wxSize(xsize, ysize))) {
         pFrame->Alert(_("Memory allocation error"));
         PHD_fits_close_file(fptr);
         return true;
     }
-    // Read image
-    if (fits_read_pix(fptr, TUSHORT, fpixel, xsize*ysize, NULL, img.ImageData, NULL, &status) ) { 
+    // Read image, decoding each row of a subframe straight to its place in the full frame
+    if (useSubframe) {
+        img.Subframe = subframe;
+        img.Clear();
+        for (int row = 0; row < ysize && !status; row++) {
+            fpixel[1] = row + 1;
+            unsigned short *dst = img.ImageData + (subframe.y + row) * FullSize.GetWidth() + subframe.x;
+            fits_read_pix(fptr, TUSHORT, fpixel, xsize, NULL, dst, NULL, &status);
+        }
+    }
+    else {
+        fits_read_pix(fptr, TUSHORT, fpixel, xsize*ysize, NULL, img.ImageData, NULL, &status);
+    }
+    if (status) {
         pFrame->Alert(_("Error reading data"));
         PHD_fits_close_file(fptr);
         return true;
@@ -429,73 +548,81 @@ bool Camera_INDIClass::ReadFITS(usImage& img)
     return false;
 }
 
-bool Camera_INDIClass::ReadStream(usImage& img) 
+bool Camera_INDIClass::ReadStream(usImage& img, bool useSubframe, const wxRect& subframe) 
 {
     int xsize, ysize;
     unsigned char *inptr;
     unsigned short *outptr;
 
-    if (! frame_prop) {
-        pFrame->Alert(_("No CCD_FRAME property, failed to determine image dimensions"));
-        return true;
+    // a stream blob has no header, so tell the subframe from the full frame
+    // by the size of what was received (one byte per pixel)
+    size_t bsize = static_cast<size_t>(cam_bp->bloblen);
+
+    if (useSubframe && (bsize != (size_t) subframe.width * subframe.height || !wxRect(FullSize).Contains(subframe)))
+        useSubframe = false;
+
+    if (useSubframe) {
+        xsize = subframe.width;
+        ysize = subframe.height;
     }
-    
-    INumber *f_num = IUFindNumber(frame_prop,"WIDTH");
- 
-    if (! (f_num)) {
-        pFrame->Alert(_("No WIDTH value, failed to determine image dimensions"));
-        return true;
+    else if (bsize == (size_t) FullSize.GetWidth() * FullSize.GetHeight()) {
+        xsize = FullSize.GetWidth();
+        ysize = FullSize.GetHeight();
     }
-    xsize = f_num->value;
-
-    f_num = IUFindNumber(frame_prop,"HEIGHT");
-    
-    if (! (f_num)) {
-        pFrame->Alert(_("No HEIGHT value, failed to determine image dimensions"));
+    else {
+        pFrame->Alert(_("CCD stream: image size does not match the frame size"));
         return true;
     }
-    ysize = f_num->value;
-    
+
     // allocate image
-    if (img.Init(xsize,ysize)) {
+    if (img.Init(useSubframe ? FullSize : wxSize(xsize, ysize))) {
         pFrame->Alert(_("CCD stream: memory allocation error"));
         return true;
     }
     // copy image
-    outptr = img.ImageData;
     inptr = (unsigned char *) cam_bp->blob;
-    for (int i = 0; i < xsize * ysize; i++)
-        *outptr ++ = *inptr++;
+    if (useSubframe) {
+        img.Subframe = subframe;
+        img.Clear();
+        for (int row = 0; row < ysize; row++) {
+            outptr = img.ImageData + (subframe.y + row) * FullSize.GetWidth() + subframe.x;
+            for (int i = 0; i < xsize; i++)
+                *outptr++ = *inptr++;
+        }
+    }
+    else {
+        outptr = img.ImageData;
+        for (int i = 0; i < xsize * ysize; i++)
+            *outptr++ = *inptr++;
+    }
     return false;
 }
 
 bool Camera_INDIClass::Capture(int duration, usImage& img, int options, const wxRect& subframe)
 {
   if (Connected) {
+      // have the server send only the subframe
+      bool useSubframe = UseSubframes && subframe.width > 0 && subframe.height > 0;
+      if (SetROI(useSubframe ? subframe : wxRect(FullSize)))
+	  useSubframe = false;
+
       // we can set the exposure time directly in the camera
       if (expose_prop) {
 	  //printf("Exposing for %d(ms)\n", duration);
-	  
+
+	  {
+	      wxMutexLocker lock(m_blobLock);
+	      m_blobReady = false;  // will be set when the image blob is received
+	  }
+
 	  // set the exposure time, this immediately start the exposure
 	  expose_prop->np->value = (double)duration/1000;
 	  sendNewNumber(expose_prop);
-	  
-	  modal = true;  // will be reset when the image blob is received
-	  
-	  unsigned long loopwait = duration > 100 ? 10 : 1;
-	  
+
 	  CameraWatchdog watchdog(duration, GetTimeoutMs());
-	  
-	  while (modal) {
-	     wxMilliSleep(loopwait);
-	     if (WorkerThread::TerminateRequested())
-		return true;
-	     if (watchdog.Expired())
-	     {
-		DisconnectWithAlert(CAPT_FAIL_TIMEOUT);
-		return true;
-	     }
-	  }
+
+	  if (WaitForBLOB(watchdog))
+	      return true;
       }
       // for video camera without exposure time setting
       else if (video_prop){
@@ -520,28 +647,36 @@ bool Camera_INDIClass::Capture(int duration, usImage& img, int options, const wx
       }
 
       //printf("Exposure end\n");
-      
-      if (strcmp(cam_bp->format, ".fits") == 0) {
-	 //printf("Processing fits file\n");
-	 // for CCD camera
-	 if ( ! ReadFITS(img) ) {
-         if (options & CAPTURE_SUBTRACT_DARK) {
-	       //printf("Subtracting dark\n");
-	       SubtractDark(img);
-	    }
-	    return false;
-	 } else {
-	    return true;
-	 }
-      } else if (strcmp(cam_bp->format, ".stream") == 0) {
-	 //printf("Processing stream file\n");
-	 // for video camera
-	 return ReadStream(img);
-      } else {
-	 pFrame->Alert(_("Unknown image format: ") + wxString::FromAscii(cam_bp->format));
-	 return true;
+
+      bool isFits = false;
+      bool error;
+      {
+	  // keep the listener thread from replacing the blob while it is decoded
+	  wxMutexLocker lock(m_blobLock);
+
+	  if (!cam_bp)
+	      return true;
+
+	  if (strcmp(cam_bp->format, ".fits") == 0) {
+	      //printf("Processing fits file\n");
+	      // for CCD camera
+	      isFits = true;
+	      error = ReadFITS(img, useSubframe, subframe);
+	  } else if (strcmp(cam_bp->format, ".stream") == 0) {
+	      //printf("Processing stream file\n");
+	      // for video camera
+	      error = ReadStream(img, useSubframe, subframe);
+	  } else {
+	      pFrame->Alert(_("Unknown image format: ") + wxString::FromAscii(cam_bp->format));
+	      error = true;
+	  }
       }
 
+      if (!error && isFits && (options & CAPTURE_SUBTRACT_DARK)) {
+	  //printf("Subtracting dark\n");
+	  SubtractDark(img);
+      }
+      return error;
   }
   else {
       // in case the camera is not connected
@@ -62,6 +62,11 @@ private:
     INumber               *pulseW_prop;
     IndiGui  *gui ;
     IBLOB    *cam_bp;
+    wxMutex     m_blobLock;     // guards cam_bp and m_blobReady, newBLOB runs on the INDI listener thread
+    wxCondition m_blobCond;
+    bool     m_blobReady;
+    wxSize   m_maxSize;         // CCD_MAX_X/Y in unbinned pixels, empty until CCD_INFO is received
+    wxRect   m_roi;             // frame last sent in CCD_FRAME, in unbinned pixels
     bool     has_blob;
     bool     modal;
     bool     ready;
@@ -77,8 +82,12 @@ private:
     void     CheckState();
     void     CameraDialog();
     void     CameraSetup();
-    bool     ReadFITS(usImage& img);
-    bool     ReadStream(usImage& img);
+    void     GetBinning(int *binX, int *binY);
+    void     UpdateFrameSize(void);
+    bool     SetROI(const wxRect& roi);
+    bool     WaitForBLOB(const CameraWatchdog& watchdog);
+    bool     ReadFITS(usImage& img, bool useSubframe, const wxRect& subframe);
+    bool     ReadStream(usImage& img, bool useSubframe, const wxRect& subframe);
     
 protected:
     virtual void newDevice(INDI::BaseDevice *dp);
@@ -43,10 +43,67 @@
 # include <DelayImp.h>
 #endif
 
+// The driver does not report when a frame was exposed, so the exposure is
+// assumed to have ended a readout allowance before the frame was read: a fixed
+// latency plus the transfer time of the frame at a conservative USB rate,
+// scaled by the bandwidth limit set on the camera. Erring on the long side
+// keeps a frame from looking newer than it really is, so that a frame exposed
+// during a guide pulse is not taken for a clean one.
+enum
+{
+    STREAM_READOUT_LATENCY_MS = 20,
+    USB2_BYTES_PER_MS = 35000,      // about 35 MB/s, a USB 2 host at full bandwidth
+    USB3_BYTES_PER_MS = 250000,     // about 250 MB/s
+};
+
+class ZWOStreamThread : public wxThread
+{
+    Camera_ZWO *m_camera;
+public:
+    ZWOStreamThread(Camera_ZWO *camera) : wxThread(wxTHREAD_JOINABLE), m_camera(camera) { }
+    ExitCode Entry();
+};
+
+wxThread::ExitCode ZWOStreamThread::Entry()
+{
+    Debug.AddLine("ZWO: stream thread begins");
+
+    while (!TestDestroy())
+    {
+        wxRect frame;
+        int slot = m_camera->AcquireWriteSlot(&frame);
+
+        ASI_ERROR_CODE status = ASIGetVideoData(m_camera->m_cameraId, m_camera->m_streamFrames[slot].data,
+            frame.GetWidth() * frame.GetHeight(), 200);
+
+        if (status == ASI_SUCCESS)
+            m_camera->PublishFrame(slot, ::wxGetUTCTimeMillis().GetValue());
+        else
+            m_camera->ReleaseSlot(slot);
+    }
+
+    Debug.AddLine("ZWO: stream thread ends");
+
+    return (ExitCode) 0;
+}
+
 Camera_ZWO::Camera_ZWO()
-    : m_buffer(0),
-    m_capturing(false)
+    : m_streamCond(m_streamLock),
+    m_streamSeq(0),
+    m_streamExposureMs(0),
+    m_deliveredSeq(0),
+    m_settingsChangedMs(0),
+    m_streamThread(0),
+    m_capturing(false),
+    m_bytesPerMs(USB2_BYTES_PER_MS)
 {
+    for (int i = 0; i < NUM_STREAM_FRAMES; i++)
+    {
+        m_streamFrames[i].data = 0;
+        m_streamFrames[i].valid = false;
+        m_streamFrames[i].busy = false;
+    }
+
     Name = _T("ZWO ASI Camera");
     Connected = false;
     m_hasGuideOutput = true;
@@ -56,7 +113,8 @@ Camera_ZWO::Camera_ZWO()
 
 Camera_ZWO::~Camera_ZWO()
 {
-    delete[] m_buffer;
+    StopCapture();
+    FreeStreamFrames();
 }
 
 inline static int cam_gain(int minval, int maxval, int pct)
@@ -188,11 +246,13 @@ bool Camera_ZWO::Connect()
     FullSize.x = info.MaxWidth;
     FullSize.y = info.MaxHeight;
 
-    delete[] m_buffer;
-    m_buffer = new unsigned char[FullSize.x * FullSize.y];
+    AllocStreamFrames();
 
     PixelSize = info.PixelSize;
 
+    int usbBytesPerMs = info.IsUSB3Host ? USB3_BYTES_PER_MS : USB2_BYTES_PER_MS;
+    m_bytesPerMs = usbBytesPerMs;
+
     wxYield();
 
     int numControls;
@@ -224,6 +284,9 @@ bool Camera_ZWO::Connect()
                 break;
             case ASI_BANDWIDTHOVERLOAD:
                 ASISetControlValue(m_cameraId, ASI_BANDWIDTHOVERLOAD, caps.MinValue, ASI_FALSE);
+                // the value is a percentage of the USB bandwidth
+                if (caps.MinValue > 0 && caps.MinValue < 100)
+                    m_bytesPerMs = wxMax(1L, (long) usbBytesPerMs * caps.MinValue / 100);
                 break;
             default:
                 break;
@@ -234,7 +297,10 @@ bool Camera_ZWO::Connect()
 
     wxYield();
 
-    m_frame = wxRect(FullSize);
+    {
+        wxMutexLocker lock(m_streamLock);
+        m_frame = wxRect(FullSize);
+    }
     Debug.AddLine("ZWO: frame (%d,%d)+(%d,%d)", m_frame.x, m_frame.y, m_frame.width, m_frame.height);
 
     ASISetStartPos(m_cameraId, m_frame.GetLeft(), m_frame.GetTop());
@@ -243,13 +309,61 @@ bool Camera_ZWO::Connect()
     return false;
 }
 
+void Camera_ZWO::AllocStreamFrames(void)
+{
+    FreeStreamFrames();
+
+    for (int i = 0; i < NUM_STREAM_FRAMES; i++)
+        m_streamFrames[i].data = new unsigned char[FullSize.x * FullSize.y];
+}
+
+void Camera_ZWO::FreeStreamFrames(void)
+{
+    for (int i = 0; i < NUM_STREAM_FRAMES; i++)
+    {
+        delete[] m_streamFrames[i].data;
+        m_streamFrames[i].data = 0;
+        m_streamFrames[i].valid = false;
+        m_streamFrames[i].busy = false;
+    }
+}
+
+void Camera_ZWO::StartCapture(void)
+{
+    if (m_capturing)
+        return;
+
+    Debug.AddLine("ZWO: startcapture");
+    ASIStartVideoCapture(m_cameraId);
+    m_capturing = true;
+
+    m_streamThread = new ZWOStreamThread(this);
+    if (m_streamThread->Create() != wxTHREAD_NO_ERROR || m_streamThread->Run() != wxTHREAD_NO_ERROR)
+    {
+        Debug.AddLine("ZWO: could not start the stream thread");
+        delete m_streamThread;
+        m_streamThread = 0;
+    }
+}
+
 bool Camera_ZWO::StopCapture(void)
 {
     if (m_capturing)
     {
+        if (m_streamThread)
+        {
+            m_streamThread->Delete();   // waits for the thread to exit
+            delete m_streamThread;
+            m_streamThread = 0;
+        }
+
         Debug.AddLine("ZWO: stopcapture");
         ASIStopVideoCapture(m_cameraId);
         m_capturing = false;
+
+        wxMutexLocker lock(m_streamLock);
+        for (int i = 0; i < NUM_STREAM_FRAMES; i++)
+            m_streamFrames[i].valid = false;
     }
     return true;
 }
@@ -261,12 +375,84 @@ bool Camera_ZWO::Disconnect()
 
     Connected = false;
 
-    delete[] m_buffer;
-    m_buffer = 0;
+    FreeStreamFrames();
 
     return false;
 }
 
+// Called by the reader thread to get a buffer for the next frame. Prefers an
+// empty slot, then the oldest frame not being copied out by Capture().
+int Camera_ZWO::AcquireWriteSlot(wxRect *frame)
+{
+    wxMutexLocker lock(m_streamLock);
+
+    int slot = -1;
+    for (int i = 0; i < NUM_STREAM_FRAMES; i++)
+    {
+        const StreamFrame& f = m_streamFrames[i];
+        if (f.busy)
+            continue;
+        if (slot < 0 || !f.valid || (m_streamFrames[slot].valid && f.seq < m_streamFrames[slot].seq))
+            slot = i;
+        if (!f.valid)
+            break;
+    }
+
+    // only Capture() and the reader thread mark slots busy, so there is always a free one
+    assert(slot >= 0);
+
+    StreamFrame& f = m_streamFrames[slot];
+    f.valid = false;
+    f.busy = true;
+    f.frame = m_frame;
+    *frame = m_frame;
+
+    return slot;
+}
+
+// time from the end of the exposure of a frame with the given ROI until it
+// can be read from the driver, on the long side; 8 bits per pixel
+long Camera_ZWO::ReadoutAllowanceMs(const wxRect& frame) const
+{
+    return STREAM_READOUT_LATENCY_MS + (long) ((wxLongLong_t) frame.GetWidth() * frame.GetHeight() / m_bytesPerMs);
+}
+
+void Camera_ZWO::PublishFrame(int slot, wxLongLong_t arrivalMs)
+{
+    wxMutexLocker lock(m_streamLock);
+
+    StreamFrame& f = m_streamFrames[slot];
+    f.arrivalMs = arrivalMs;
+    f.startMs = arrivalMs - m_streamExposureMs - ReadoutAllowanceMs(f.frame);
+    f.seq = ++m_streamSeq;
+    f.valid = true;
+    f.busy = false;
+
+    m_streamCond.Broadcast();
+}
+
+void Camera_ZWO::ReleaseSlot(int slot)
+{
+    wxMutexLocker lock(m_streamLock);
+    m_streamFrames[slot].busy = false;
+}
+
+// Newest frame, not yet returned by Capture(), which was read with the current
+// ROI and started no earlier than notBefore. Caller must hold m_streamLock.
+int Camera_ZWO::FindNewestFrame(wxLongLong_t notBefore) const
+{
+    int slot = -1;
+    for (int i = 0; i < NUM_STREAM_FRAMES; i++)
+    {
+        const StreamFrame& f = m_streamFrames[i];
+        if (!f.valid || f.busy || f.seq <= m_deliveredSeq || f.startMs < notBefore || f.frame != m_frame)
+            continue;
+        if (slot < 0 || f.seq > m_streamFrames[slot].seq)
+            slot = i;
+    }
+    return slot;
+}
+
 inline static int round_down(int v, int m)
 {
     return v & ~(m - 1);
@@ -277,20 +463,19 @@ inline static int round_up(int v, int m)
     return round_down(v + m - 1, m);
 }
 
-static void flush_buffered_image(int cameraId, usImage& img)
+// end time of the most recent guide pulse on either mount
+static wxLongLong_t LastGuidePulseEnd(void)
 {
-    enum { NUM_IMAGE_BUFFERS = 2 }; // camera has 2 internal frame buffers
-
-    // clear buffered frames if any
-
-    for (unsigned int num_cleared = 0; num_cleared < NUM_IMAGE_BUFFERS; num_cleared++)
+    wxLongLong t = 0;
+    if (pMount)
+        t = pMount->LastMoveEndTime();
+    if (pSecondaryMount)
     {
-        ASI_ERROR_CODE status = ASIGetVideoData(cameraId, (unsigned char *) img.ImageData, img.NPixels * sizeof(unsigned short), 0);
-        if (status != ASI_SUCCESS)
-            break; // no more buffered frames
-
-        Debug.AddLine("ZWO: getimagedata clearbuf %u ret %d", num_cleared + 1, status);
+        wxLongLong t2 = pSecondaryMount->LastMoveEndTime();
+        if (t2 > t)
+            t = t2;
     }
+    return t.GetValue();
 }
 
 bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect& subframe)
@@ -301,31 +486,43 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
         return true;
     }
 
-    wxRect frame;
-    wxPoint subframePos; // position of subframe within frame
-
     bool useSubframe = UseSubframes;
 
     if (subframe.width <= 0 || subframe.height <= 0)
         useSubframe = false;
 
+    wxRect frame;
+
     if (useSubframe)
     {
-        // ensure transfer size is a multiple of 1024
-        //  moving the sub-frame or resizing it is somewhat costly (stopCapture / startCapture)
+        // Stream a margin around the subframe so that small moves of the
+        // guide star do not change the ROI.  Resizing the ROI restarts the
+        // video capture, so keep the current one while it still contains the
+        // subframe and is not much larger than needed.
 
-        frame.SetLeft(round_down(subframe.GetLeft(), 32));
-        frame.SetRight(round_up(subframe.GetRight() + 1, 32) - 1);
-        frame.SetTop(round_down(subframe.GetTop(), 32));
-        frame.SetBottom(round_up(subframe.GetBottom() + 1, 32) - 1);
+        wxRect padded(subframe);
+        padded.Inflate(subframe.width / 2, subframe.height / 2);
+        padded.Intersect(wxRect(FullSize));
 
-        subframePos = subframe.GetLeftTop() - frame.GetLeftTop();
+        // ensure transfer size is a multiple of 1024
+        wxRect aligned;
+        aligned.SetLeft(round_down(padded.GetLeft(), 32));
+        aligned.SetRight(round_up(padded.GetRight() + 1, 32) - 1);
+        aligned.SetTop(round_down(padded.GetTop(), 32));
+        aligned.SetBottom(round_up(padded.GetBottom() + 1, 32) - 1);
+
+        if (m_frame.Contains(subframe) && m_frame.GetWidth() * m_frame.GetHeight() <= 4 * aligned.GetWidth() * aligned.GetHeight())
+            frame = m_frame;
+        else
+            frame = aligned;
     }
     else
     {
         frame = wxRect(FullSize);
     }
 
+    bool settingsChanged = false;
+
     long exposureUS = duration * 1000;
     ASI_BOOL tmp;
     long cur_exp;
@@ -334,6 +531,7 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
     {
         Debug.AddLine("ZWO: set CONTROL_EXPOSURE %d", exposureUS);
         ASISetControlValue(m_cameraId, ASI_EXPOSURE, exposureUS, ASI_FALSE);
+        settingsChanged = true;
     }
 
     long new_gain = cam_gain(m_minGain, m_maxGain, GuideCameraGain);
@@ -343,17 +541,12 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
     {
         Debug.AddLine("ZWO: set CONTROL_GAIN %d%% %d", GuideCameraGain, new_gain);
         ASISetControlValue(m_cameraId, ASI_GAIN, new_gain, ASI_FALSE);
+        settingsChanged = true;
     }
 
     bool size_change = frame.GetSize() != m_frame.GetSize();
     bool pos_change = frame.GetLeftTop() != m_frame.GetLeftTop();
 
-    if (size_change || pos_change)
-    {
-        m_frame = frame;
-        Debug.AddLine("ZWO: frame (%d,%d)+(%d,%d)", m_frame.x, m_frame.y, m_frame.width, m_frame.height);
-    }
-
     if (size_change)
     {
         StopCapture();
@@ -370,52 +563,84 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
             Debug.AddLine("ZWO: setStartPos(%d,%d) => %d", frame.GetLeft(), frame.GetTop(), status);
     }
 
-    // the camera and/or driver will buffer frames and return the oldest frame,
-    // which could be quite stale. read out all buffered frames so the frame we
-    // get is current
-
-    flush_buffered_image(m_cameraId, img);
+    if (size_change || pos_change)
+    {
+        Debug.AddLine("ZWO: frame (%d,%d)+(%d,%d)", frame.x, frame.y, frame.width, frame.height);
+        settingsChanged = true;
+    }
 
     if (!m_capturing)
     {
-        Debug.AddLine("ZWO: startcapture");
-        ASIStartVideoCapture(m_cameraId);
-        m_capturing = true;
+        // the stream is (re)started, every frame will have the new settings
+        m_settingsChangedMs = 0;
+    }
+    else if (settingsChanged)
+    {
+        // frames already in the stream were taken with the old settings
+        m_settingsChangedMs = ::wxGetUTCTimeMillis().GetValue();
+    }
+
+    if (settingsChanged || !m_capturing)
+    {
+        wxMutexLocker lock(m_streamLock);
+        m_frame = frame;
+        m_streamExposureMs = duration;
     }
 
-    int frameSize = frame.GetWidth() * frame.GetHeight();
+    StartCapture();
+
+    // take the newest frame whose exposure started after the last guide
+    // pulse ended; anything older does not show the result of the pulse
 
-    int poll = wxMin(duration, 100);
+    wxLongLong_t notBefore = wxMax(m_settingsChangedMs, LastGuidePulseEnd());
 
     CameraWatchdog watchdog(duration, duration + GetTimeoutMs() + 10000); // total timeout is 2 * duration + 15s (typically)
 
-    if (WorkerThread::MilliSleep(duration, WorkerThread::INT_ANY) &&
-        (WorkerThread::TerminateRequested() || StopCapture()))
-    {
-        return true;
-    }
+    int slot;
+    unsigned int skipped;
 
     while (true)
     {
-        ASI_ERROR_CODE status = ASIGetVideoData(m_cameraId, m_buffer, frameSize, poll);
-        if (status == ASI_SUCCESS)
-            break;
+        {
+            wxMutexLocker lock(m_streamLock);
+            slot = FindNewestFrame(notBefore);
+            if (slot < 0)
+            {
+                m_streamCond.WaitTimeout(100);
+                slot = FindNewestFrame(notBefore);
+            }
+            if (slot >= 0)
+            {
+                m_streamFrames[slot].busy = true;
+                skipped = m_streamFrames[slot].seq - m_deliveredSeq - 1;
+                break;
+            }
+        }
+
         if (WorkerThread::InterruptRequested())
         {
             StopCapture();
             return true;
         }
-        if (watchdog.Expired())
+        if (watchdog.Expired() || !m_streamThread)
         {
-            Debug.AddLine("ZWO: getimagedata ret %d", status);
+            Debug.AddLine("ZWO: no frame received");
             StopCapture();
             DisconnectWithAlert(CAPT_FAIL_TIMEOUT);
             return true;
         }
     }
 
+    // the slot is marked busy, so the reader thread leaves it alone while we copy it
+
+    const StreamFrame& f = m_streamFrames[slot];
+
+    Debug.AddLine("ZWO: frame seq %u age %ld ms skipped %u", f.seq, (long)(::wxGetUTCTimeMillis().GetValue() - f.arrivalMs), skipped);
+
     if (useSubframe)
     {
+        wxPoint subframePos = subframe.GetLeftTop() - f.frame.GetLeftTop(); // position of subframe within frame
+
         img.Subframe = subframe;
 
         // Clear out the image
@@ -423,7 +648,7 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
 
         for (int y = 0; y < subframe.height; y++)
         {
-            const unsigned char *src = m_buffer + (y + subframePos.y) * frame.width + subframePos.x;
+            const unsigned char *src = f.data + (y + subframePos.y) * f.frame.width + subframePos.x;
             unsigned short *dst = img.ImageData + (y + subframe.y) * FullSize.GetWidth() + subframe.x;
             for (int x = 0; x < subframe.width; x++)
                 *dst++ = *src++;
@@ -432,7 +657,16 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
     else
     {
         for (int i = 0; i < img.NPixels; i++)
-            img.ImageData[i] = m_buffer[i];
+            img.ImageData[i] = f.data[i];
+    }
+
+    img.ImgStartMs = f.startMs;
+    img.ImgEndMs = f.arrivalMs;
+
+    {
+        wxMutexLocker lock(m_streamLock);
+        m_deliveredSeq = f.seq;
+        m_streamFrames[slot].busy = false;
     }
 
     if (options & CAPTURE_SUBTRACT_DARK) SubtractDark(img);
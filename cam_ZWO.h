@@ -36,11 +36,45 @@
 
 #include "camera.h"
 
+class ZWOStreamThread;
+
+/*
+ * The camera streams video continuously while capturing. A reader thread
+ * pulls frames from the driver as they arrive and keeps the most recent
+ * ones in a small ring, along with an estimate of when each exposure
+ * started. Capture() returns the newest frame that started after the last
+ * guide pulse ended and after the camera settings last changed, so no
+ * buffered frames have to be read and thrown away.
+ */
 class Camera_ZWO : public GuideCamera
 {
+    friend class ZWOStreamThread;
+
+    enum { NUM_STREAM_FRAMES = 3 };
+
+    struct StreamFrame
+    {
+        unsigned char *data;
+        wxRect frame;               // the ROI the frame was read with
+        wxLongLong_t startMs;       // estimated UTC time the exposure started
+        wxLongLong_t arrivalMs;     // UTC time the frame was read from the driver
+        unsigned int seq;
+        bool valid;
+        bool busy;                  // being written by the reader thread or copied by Capture()
+    };
+
+    // m_frame, m_streamFrames, m_streamSeq and m_streamExposureMs are guarded by m_streamLock
+    wxMutex m_streamLock;
+    wxCondition m_streamCond;
     wxRect m_frame;
-    unsigned char *m_buffer;
+    StreamFrame m_streamFrames[NUM_STREAM_FRAMES];
+    unsigned int m_streamSeq;       // sequence number of the last frame read
+    long m_streamExposureMs;
+    unsigned int m_deliveredSeq;    // sequence number of the last frame returned by Capture()
+    wxLongLong_t m_settingsChangedMs;
+    ZWOStreamThread *m_streamThread;
     bool m_capturing;
+    long m_bytesPerMs;              // estimated transfer rate, for ReadoutAllowanceMs
     int m_cameraId;
     int m_minGain;
     int m_maxGain;
@@ -60,7 +94,15 @@ public:
     virtual bool ST4HasNonGuiMove(void) { return true; }
 
 private:
+    void StartCapture(void);
     bool StopCapture(void);
+    void AllocStreamFrames(void);
+    void FreeStreamFrames(void);
+    int AcquireWriteSlot(wxRect *frame);
+    long ReadoutAllowanceMs(const wxRect& frame) const;
+    void PublishFrame(int slot, wxLongLong_t arrivalMs);
+    void ReleaseSlot(int slot);
+    int FindNewestFrame(wxLongLong_t notBefore) const;
 };
 
 #endif
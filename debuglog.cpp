@@ -40,15 +40,22 @@
 void DebugLog::InitVars(void)
 {
     m_bEnabled = false;
-    m_lastWriteTime = wxDateTime::UNow();
+    for (int i = 0; i < DBGLOG_NUM_CATEGORIES; i++)
+        m_levels[i] = DBGLOG_VERBOSE;
+    m_lastWriteMs = ::wxGetUTCTimeMillis();
+    m_stopFlusher = false;
+    m_flusher = NULL;
+    m_dropped = 0;
 }
 
 DebugLog::DebugLog(void)
+    : m_queueNotEmpty(m_queueLock)
 {
     InitVars();
 }
 
 DebugLog::DebugLog(const char *pName, bool bEnabled = true)
+    : m_queueNotEmpty(m_queueLock)
 {
     InitVars();
 
@@ -57,10 +64,138 @@ DebugLog::DebugLog(const char *pName, bool bEnabled = true)
 
 DebugLog::~DebugLog(void)
 {
-    wxFFile::Flush();
+    // normally the flusher was stopped by PhdApp::OnExit, but OnExit is not
+    // called if OnInit fails, and the thread must not outlive the log
+    Shutdown();
+
+    wxCriticalSectionLocker lock(m_criticalSection);
     wxFFile::Close();
 }
 
+void DebugLog::StartFlusher(void)
+{
+    if (m_flusher)
+        return;
+
+    FlusherThread *flusher = new FlusherThread(this);
+
+    if (flusher->Create() != wxTHREAD_NO_ERROR || flusher->Run() != wxTHREAD_NO_ERROR)
+    {
+        // lines will be written by the thread that logs them
+        delete flusher;
+        return;
+    }
+
+    wxMutexLocker lock(m_queueLock);
+    m_stopFlusher = false;
+    m_flusher = flusher;
+}
+
+// Stops the flusher thread, writing out anything still queued. Called when the
+// app exits and again by the destructor.
+void DebugLog::Shutdown(void)
+{
+    if (m_flusher)
+    {
+        {
+            wxMutexLocker lock(m_queueLock);
+            m_stopFlusher = true;
+            m_queueNotEmpty.Signal();
+        }
+
+        m_flusher->Wait();
+        delete m_flusher;
+
+        wxMutexLocker lock(m_queueLock);
+        m_flusher = NULL;
+        m_stopFlusher = false;
+    }
+
+    Flush();
+}
+
+wxThread::ExitCode DebugLog::FlusherThread::Entry(void)
+{
+    m_log->FlusherLoop();
+    return (wxThread::ExitCode) 0;
+}
+
+void DebugLog::FlusherLoop(void)
+{
+    while (true)
+    {
+        { // lock scope
+            wxMutexLocker lock(m_queueLock);
+
+            while (m_queue.empty() && !m_stopFlusher)
+                m_queueNotEmpty.Wait();
+
+            if (m_queue.empty())
+                break;
+        }
+
+        wxCriticalSectionLocker lock(m_criticalSection);
+        WriteBatch();
+#if defined(ALWAYS_FLUSH_DEBUGLOG)
+        if (wxFFile::IsOpened())
+            wxFFile::Flush();
+#endif
+    }
+}
+
+// Takes everything queued so far and writes it to the file. The caller must
+// hold m_criticalSection, which keeps batches in order.
+void DebugLog::WriteBatch(void)
+{
+    unsigned long dropped;
+    wxLongLong swapMs;
+
+    { // lock scope
+        wxMutexLocker lock(m_queueLock);
+        m_batch.swap(m_queue);
+        dropped = m_dropped;
+        m_dropped = 0;
+        swapMs = ::wxGetUTCTimeMillis();
+    }
+
+    if (dropped)
+    {
+        // the lines were dropped after the ones in this batch were queued
+        LogRecord rec;
+        rec.timeMs = swapMs;
+        rec.threadId = (unsigned long) wxThread::GetCurrentId();
+        rec.text = std::string(wxString::Format("Debug log fell behind, %lu lines dropped\n", dropped).mb_str(wxConvUTF8));
+        m_batch.push_back(rec);
+    }
+
+    WriteRecords();
+}
+
+// Formats and writes the records in m_batch. The caller must hold m_criticalSection.
+void DebugLog::WriteRecords(void)
+{
+    for (std::vector<LogRecord>::const_iterator it = m_batch.begin(); it != m_batch.end(); ++it)
+    {
+        wxDateTime when(it->timeMs);
+        wxLongLong deltaMs = it->timeMs - m_lastWriteMs;
+        m_lastWriteMs = it->timeMs;
+        wxString prefix = wxString::Format("%s %s %lu ", when.Format("%H:%M:%S.%l"),
+                                                         wxTimeSpan::Milliseconds(deltaMs).Format("%S.%l"),
+                                                         it->threadId);
+
+        if (wxFFile::IsOpened())
+        {
+            wxFFile::Write(prefix);
+            wxFFile::Write(it->text.data(), it->text.size());
+        }
+#if defined(__WINDOWS__) && defined(_DEBUG)
+        OutputDebugString((prefix + wxString::FromUTF8(it->text.c_str())).c_str());
+#endif
+    }
+
+    m_batch.clear();
+}
+
 bool DebugLog::Enable(bool bEnabled)
 {
     bool prevState = m_bEnabled;
@@ -70,10 +205,64 @@ bool DebugLog::Enable(bool bEnabled)
     return prevState;
 }
 
+static const char *const s_categoryNames[DBGLOG_NUM_CATEGORIES] =
+{
+    "general", "camera", "mount", "star", "server", "algorithm",
+};
+
+const char *DebugLog::CategoryName(DebugLogCategory category)
+{
+    return s_categoryNames[category];
+}
+
+bool DebugLog::CategoryFromName(const wxString& name, DebugLogCategory *category)
+{
+    for (int i = 0; i < DBGLOG_NUM_CATEGORIES; i++)
+    {
+        if (name.IsSameAs(s_categoryNames[i], false))
+        {
+            *category = (DebugLogCategory) i;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void DebugLog::SetLevel(DebugLogCategory category, DebugLogLevel level)
+{
+    if (level < DBGLOG_OFF)
+        level = DBGLOG_OFF;
+    else if (level > DBGLOG_VERBOSE)
+        level = DBGLOG_VERBOSE;
+
+    if (level != m_levels[category])
+    {
+        Write(wxString::Format("Debug log level for %s set to %d\n", CategoryName(category), level));
+        m_levels[category] = level;
+    }
+
+    if (pConfig)
+        pConfig->Profile.SetInt(wxString("/debuglog/level/") + CategoryName(category), level);
+}
+
+void DebugLog::LoadProfileSettings(void)
+{
+    for (int i = 0; i < DBGLOG_NUM_CATEGORIES; i++)
+    {
+        DebugLogCategory category = (DebugLogCategory) i;
+        SetLevel(category, (DebugLogLevel) pConfig->Profile.GetInt(wxString("/debuglog/level/") + CategoryName(category),
+            DBGLOG_VERBOSE));
+    }
+}
+
 bool DebugLog::Init(const char *pName, bool bEnable, bool bForceOpen)
 {
     wxCriticalSectionLocker lock(m_criticalSection);
 
+    // lines logged so far go to the file they were logged for
+    WriteBatch();
+
     if (m_bEnabled)
     {
         wxFFile::Flush();
@@ -96,6 +285,9 @@ bool DebugLog::Init(const char *pName, bool bEnable, bool bForceOpen)
 
     m_bEnabled = bEnable;
 
+    if (m_bEnabled)
+        StartFlusher();
+
     return m_bEnabled;
 }
 
@@ -139,6 +331,7 @@ wxString DebugLog::AddBytes(const wxString& str, const unsigned char *pBytes, un
     return Write(Line + "\n");
 }
 
+// Writes out everything queued so far on the calling thread
 bool DebugLog::Flush(void)
 {
     bool bReturn = true;
@@ -147,33 +340,76 @@ bool DebugLog::Flush(void)
     {
         wxCriticalSectionLocker lock(m_criticalSection);
 
+        WriteBatch();
         bReturn = wxFFile::Flush();
     }
 
     return bReturn;
 }
 
+// Called from the fatal exception handler. The crashing thread may be holding
+// either lock, so never wait for them, and the heap may be damaged, so do not
+// format or allocate anything: write the message bytes that are already queued,
+// without their timestamps.
+void DebugLog::FlushOnCrash(void)
+{
+    if (!m_bEnabled || !wxFFile::IsOpened())
+        return;
+
+    FILE *fp = wxFFile::fp();
+
+    if (m_criticalSection.TryEnter())
+    {
+        if (m_queueLock.TryLock() == wxMUTEX_NO_ERROR)
+        {
+            static const char hdr[] = "Fatal exception, unwritten debug log lines follow without timestamps\n";
+            fwrite(hdr, 1, sizeof(hdr) - 1, fp);
+
+            for (std::vector<LogRecord>::const_iterator it = m_queue.begin(); it != m_queue.end(); ++it)
+                fwrite(it->text.data(), 1, it->text.size(), fp);
+
+            m_queueLock.Unlock();
+        }
+        m_criticalSection.Leave();
+    }
+
+    fflush(fp);
+}
+
 wxString DebugLog::Write(const wxString& str)
 {
     if (m_bEnabled)
     {
-        wxCriticalSectionLocker lock(m_criticalSection);
+        LogRecord rec;
+        rec.threadId = (unsigned long) wxThread::GetCurrentId();
+        rec.text = std::string(str.mb_str(wxConvUTF8));
 
-        wxDateTime now = wxDateTime::UNow();
-        wxTimeSpan deltaTime = now - m_lastWriteTime;
-        m_lastWriteTime = now;
-        wxString outputLine = wxString::Format("%s %s %lu %s", now.Format("%H:%M:%S.%l"),
-                                                              deltaTime.Format("%S.%l"),
-                                                              (unsigned long) wxThread::GetCurrentId(),
-                                                              str);
-
-        wxFFile::Write(outputLine);
-#if defined(ALWAYS_FLUSH_DEBUGLOG)
-        wxFFile::Flush();
-#endif
-#if defined(__WINDOWS__) && defined(_DEBUG)
-        OutputDebugString(outputLine.c_str());
-#endif
+        bool writeNow;
+
+        { // lock scope
+            wxMutexLocker lock(m_queueLock);
+
+            // timestamp under the lock so that lines are queued in time order
+            rec.timeMs = ::wxGetUTCTimeMillis();
+
+            // the flusher is stopped after the queue is drained, so once
+            // m_stopFlusher is set the line must be written here
+            writeNow = !m_flusher || m_stopFlusher;
+
+            if (!writeNow && m_queue.size() >= MAX_QUEUED)
+            {
+                // never make a writer (possibly the guide loop) wait for the file
+                ++m_dropped;
+                return str;
+            }
+
+            m_queue.push_back(rec);
+            if (m_queue.size() == 1)
+                m_queueNotEmpty.Signal();
+        }
+
+        if (writeNow)
+            Flush();
     }
 
     return str;
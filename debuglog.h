@@ -38,15 +38,79 @@
 
 #include "logger.h"
 
+// Debug log lines can be filtered by category and verbosity. Use DEBUG_LOG
+// for lines in frequently run code: the arguments are not evaluated (so no
+// formatting is done) unless the category is logged at that level.
+enum DebugLogCategory
+{
+    DBGLOG_GENERAL = 0,
+    DBGLOG_CAMERA,
+    DBGLOG_MOUNT,
+    DBGLOG_STAR,
+    DBGLOG_SERVER,
+    DBGLOG_ALGORITHM,
+    DBGLOG_NUM_CATEGORIES
+};
+
+enum DebugLogLevel
+{
+    DBGLOG_OFF = 0,
+    DBGLOG_NORMAL,      // state changes, errors and per-operation summaries
+    DBGLOG_VERBOSE,     // per-frame and per-request tracing
+};
+
+#define DEBUG_LOG(category, level) if (!Debug.IsEnabled(category, level)) ; else Debug
+
+/*
+ * Writers only timestamp their message and append it to a queue; a background
+ * flusher thread formats the queued lines and writes them to the file in
+ * batches, so logging from the guide loop does not wait for file I/O. If the
+ * flusher falls MAX_QUEUED lines behind, new lines are dropped and counted
+ * rather than making the writer wait; the count is logged with the next batch.
+ * Flush() writes out everything queued so far on the calling thread, and
+ * FlushOnCrash() writes the queued message bytes without formatting anything
+ * or waiting for locks that a crashing thread may hold.
+ */
 class DebugLog : public wxFFile, public Logger
 {
 private:
+    struct LogRecord
+    {
+        wxLongLong timeMs;          // UTC ms
+        unsigned long threadId;
+        std::string text;           // UTF-8 message, including the newline
+    };
+
+    class FlusherThread : public wxThread
+    {
+        DebugLog *m_log;
+    public:
+        FlusherThread(DebugLog *log) : wxThread(wxTHREAD_JOINABLE), m_log(log) { }
+        ExitCode Entry(void);
+    };
+    friend class FlusherThread;
+
+    enum { MAX_QUEUED = 8192 };     // lines are dropped if the flusher falls this far behind
+
     bool m_bEnabled;
-    wxCriticalSection m_criticalSection;
-    wxDateTime m_lastWriteTime;
+    DebugLogLevel m_levels[DBGLOG_NUM_CATEGORIES];
+    wxCriticalSection m_criticalSection;    // serializes access to the file
+    wxLongLong m_lastWriteMs;
     wxString m_pPathName;
 
+    wxMutex m_queueLock;
+    wxCondition m_queueNotEmpty;
+    std::vector<LogRecord> m_queue;
+    unsigned long m_dropped;                // lines dropped since the last batch, guarded by m_queueLock
+    std::vector<LogRecord> m_batch;         // records being written, guarded by m_criticalSection
+    bool m_stopFlusher;
+    FlusherThread *m_flusher;
+
     void InitVars(void);
+    void StartFlusher(void);
+    void FlusherLoop(void);
+    void WriteBatch(void);
+    void WriteRecords(void);
 
 public:
     DebugLog(void);
@@ -55,11 +119,19 @@ public:
 
     bool Enable(bool bEnabled);
     bool IsEnabled(void);
+    bool IsEnabled(DebugLogCategory category, DebugLogLevel level) const;
+    DebugLogLevel GetLevel(DebugLogCategory category) const;
+    void SetLevel(DebugLogCategory category, DebugLogLevel level);
+    void LoadProfileSettings(void);
+    static const char *CategoryName(DebugLogCategory category);
+    static bool CategoryFromName(const wxString& name, DebugLogCategory *category);
     bool Init(const char *pName, bool bEnable, bool bForceOpen = false);
     wxString AddLine(const char *format, ...); // adds a newline
     wxString AddBytes(const wxString& str, const unsigned char *pBytes, unsigned count);
     wxString Write(const wxString& str);
     bool Flush(void);
+    void FlushOnCrash(void);
+    void Shutdown(void);
 
     bool ChangeDirLog(const wxString& newdir);
 };
@@ -74,6 +146,16 @@ inline bool DebugLog::IsEnabled(void)
     return m_bEnabled;
 }
 
+inline bool DebugLog::IsEnabled(DebugLogCategory category, DebugLogLevel level) const
+{
+    return m_bEnabled && level <= m_levels[category];
+}
+
+inline DebugLogLevel DebugLog::GetLevel(DebugLogCategory category) const
+{
+    return m_levels[category];
+}
+
 extern DebugLog Debug;
 
 #endif
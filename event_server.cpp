@@ -43,6 +43,7 @@ EventServer EvtServer;
 BEGIN_EVENT_TABLE(EventServer, wxEvtHandler)
     EVT_SOCKET(EVENT_SERVER_ID, EventServer::OnEventServerEvent)
     EVT_SOCKET(EVENT_SERVER_CLIENT_ID, EventServer::OnEventServerClientEvent)
+    EVT_THREAD(EVENT_SERVER_FLUSH_ID, EventServer::OnFlushClients)
 END_EVENT_TABLE()
 
 enum
@@ -322,10 +323,215 @@ static Ev ev_settle_done(const wxString& errorMsg)
     return ev;
 }
 
+/*
+ * Output to clients is queued per client and written by the main thread
+ * without blocking, so a client that is slow to read cannot hold up the
+ * thread raising the event. Each message is serialized once and shared by
+ * the queues of all the clients it is sent to.
+ *
+ * When a client's queue grows past CLIENT_QUEUE_COALESCE_BYTES, queued
+ * high-rate events (GuideStep, Settling, StarLost) are replaced by the
+ * latest one. A client whose queue exceeds CLIENT_QUEUE_MAX_BYTES, or that
+ * accepts no data for CLIENT_STALL_TIMEOUT_MS, is disconnected.
+ *
+ * The client set, the client queues and the message reference counts are
+ * protected by s_outputLock.
+ */
+
+enum
+{
+    CLIENT_QUEUE_COALESCE_BYTES = 64 * 1024,
+    CLIENT_QUEUE_MAX_BYTES = 1024 * 1024,
+    CLIENT_STALL_TIMEOUT_MS = 60 * 1000,
+};
+
+struct OutMsg
+{
+    int refcnt;
+    std::string data;           // message including the line terminator
+    const char *coalesceKey;    // event name for high-rate events, else NULL
+
+    OutMsg(const wxCharBuffer& buf, const char *key)
+        : refcnt(1), coalesceKey(key)
+    {
+        data.reserve(buf.length() + 2);
+        data.append(buf.data(), buf.length());
+        data.append("\r\n", 2);
+    }
+};
+
+struct ClientReadBuf
+{
+    enum { SIZE = 1024 };
+    char buf[SIZE];
+    char *dest;
+
+    ClientReadBuf() { reset(); }
+    size_t avail() const { return &buf[SIZE] - dest; }
+    void reset() { dest = &buf[0]; }
+};
+
+struct ClientData
+{
+    ClientReadBuf rdbuf;
+    std::deque<OutMsg *> outq;
+    size_t queuedBytes;         // size of the messages in outq
+    size_t frontSent;           // bytes of outq.front() already written
+    wxLongLong lastProgress;    // when data was last written or the queue became non-empty
+    unsigned int coalesced;     // events dropped by coalescing
+    unsigned int coalescedLogged;
+    bool disconnect;
+    const char *disconnectReason;
+
+    ClientData()
+        : queuedBytes(0), frontSent(0), coalesced(0), coalescedLogged(0),
+        disconnect(false), disconnectReason("")
+    {
+    }
+};
+
+static wxCriticalSection s_outputLock;
+static bool s_flushPending;
+
+inline static ClientData *client_data(wxSocketClient *cli)
+{
+    return (ClientData *) cli->GetClientData();
+}
+
+inline static ClientReadBuf *client_rdbuf(wxSocketClient *cli)
+{
+    return &client_data(cli)->rdbuf;
+}
+
+// s_outputLock must be held
+static void release_msg(OutMsg *msg)
+{
+    if (--msg->refcnt == 0)
+        delete msg;
+}
+
+// s_outputLock must be held
+static void enqueue_msg(wxSocketClient *cli, OutMsg *msg)
+{
+    ClientData *cd = client_data(cli);
+
+    if (cd->disconnect)
+        return;
+
+    if (msg->coalesceKey && cd->queuedBytes + msg->data.size() > CLIENT_QUEUE_COALESCE_BYTES)
+    {
+        // the client is not keeping up, drop the unsent copies of this event
+        std::deque<OutMsg *>::iterator it = cd->outq.begin();
+        if (it != cd->outq.end() && cd->frontSent > 0)
+            ++it;
+        while (it != cd->outq.end())
+        {
+            OutMsg *m = *it;
+            if (m->coalesceKey && strcmp(m->coalesceKey, msg->coalesceKey) == 0)
+            {
+                cd->queuedBytes -= m->data.size();
+                release_msg(m);
+                it = cd->outq.erase(it);
+                ++cd->coalesced;
+            }
+            else
+                ++it;
+        }
+    }
+
+    if (cd->queuedBytes + msg->data.size() > CLIENT_QUEUE_MAX_BYTES)
+    {
+        cd->disconnect = true;
+        cd->disconnectReason = "output queue full";
+        return;
+    }
+
+    if (cd->outq.empty())
+        cd->lastProgress = ::wxGetUTCTimeMillis();
+
+    ++msg->refcnt;
+    cd->outq.push_back(msg);
+    cd->queuedBytes += msg->data.size();
+}
+
+// s_outputLock must be held
+static void request_flush()
+{
+    if (!s_flushPending)
+    {
+        s_flushPending = true;
+        wxQueueEvent(&EvtServer, new wxThreadEvent(wxEVT_THREAD, EVENT_SERVER_FLUSH_ID));
+    }
+}
+
+// Writes as much of the client's queue as the socket will take without
+// blocking. s_outputLock must be held.
+static void flush_client(wxSocketClient *cli, const wxLongLong& now)
+{
+    ClientData *cd = client_data(cli);
+
+    while (!cd->outq.empty())
+    {
+        OutMsg *msg = cd->outq.front();
+        size_t len = msg->data.size() - cd->frontSent;
+
+        cli->Write(msg->data.data() + cd->frontSent, len);
+        size_t n = cli->LastCount();
+
+        if (n > 0)
+            cd->lastProgress = now;
+        cd->frontSent += n;
+
+        if (n < len)
+        {
+            // we get wxSOCKET_OUTPUT when the client can take more
+            if (cli->Error() && cli->LastError() != wxSOCKET_WOULDBLOCK)
+            {
+                cd->disconnect = true;
+                cd->disconnectReason = "write error";
+            }
+            break;
+        }
+
+        cd->outq.pop_front();
+        cd->queuedBytes -= msg->data.size();
+        cd->frontSent = 0;
+        release_msg(msg);
+    }
+
+    if (!cd->outq.empty() && now - cd->lastProgress > CLIENT_STALL_TIMEOUT_MS)
+    {
+        cd->disconnect = true;
+        cd->disconnectReason = "client stopped reading";
+    }
+
+    if (cd->coalesced != cd->coalescedLogged)
+    {
+        DEBUG_LOG(DBGLOG_SERVER, DBGLOG_NORMAL).AddLine("evsrv: cli %p is slow, %u events coalesced, %u bytes queued",
+            cli, cd->coalesced - cd->coalescedLogged, (unsigned int) cd->queuedBytes);
+        cd->coalescedLogged = cd->coalesced;
+    }
+}
+
+// s_outputLock must be held
+static void destroy_client(wxSocketClient *cli)
+{
+    ClientData *cd = client_data(cli);
+    cli->Destroy();
+    for (std::deque<OutMsg *>::iterator it = cd->outq.begin(); it != cd->outq.end(); ++it)
+        release_msg(*it);
+    delete cd;
+}
+
 static void send_buf(wxSocketClient *client, const wxCharBuffer& buf)
 {
-    client->Write(buf.data(), buf.length());
-    client->Write("\r\n", 2);
+    wxCriticalSectionLocker lck(s_outputLock);
+
+    OutMsg *msg = new OutMsg(buf, 0);
+    enqueue_msg(client, msg);
+    release_msg(msg);
+
+    request_flush();
 }
 
 static void do_notify1(wxSocketClient *client, const JAry& ary)
@@ -338,15 +544,23 @@ static void do_notify1(wxSocketClient *client, const JObj& j)
     send_buf(client, JObj(j).str().ToUTF8());
 }
 
-static void do_notify(const EventServer::CliSockSet& cli, const JObj& jj)
+static void do_notify(const EventServer::CliSockSet& cli, const JObj& jj, const char *coalesceKey = 0)
 {
     wxCharBuffer buf = JObj(jj).str().ToUTF8();
 
+    wxCriticalSectionLocker lck(s_outputLock);
+
+    OutMsg *msg = new OutMsg(buf, coalesceKey);
+
     for (EventServer::CliSockSet::const_iterator it = cli.begin();
         it != cli.end(); ++it)
     {
-        send_buf(*it, buf);
+        enqueue_msg(*it, msg);
     }
+
+    release_msg(msg);
+
+    request_flush();
 }
 
 inline static void simple_notify(const EventServer::CliSockSet& cli, const wxString& ev)
@@ -403,29 +617,6 @@ static void send_catchup_events(wxSocketClient *cli)
     do_notify1(cli, ev_app_state());
 }
 
-struct ClientReadBuf
-{
-    enum { SIZE = 1024 };
-    char buf[SIZE];
-    char *dest;
-
-    ClientReadBuf() { reset(); }
-    size_t avail() const { return &buf[SIZE] - dest; }
-    void reset() { dest = &buf[0]; }
-};
-
-inline static ClientReadBuf *client_rdbuf(wxSocketClient *cli)
-{
-    return (ClientReadBuf *) cli->GetClientData();
-}
-
-static void destroy_client(wxSocketClient *cli)
-{
-    ClientReadBuf *buf = client_rdbuf(cli);
-    cli->Destroy();
-    delete buf;
-}
-
 static void drain_input(wxSocketInputStream& sis)
 {
     while (sis.CanRead())
@@ -780,6 +971,121 @@ static void get_pixel_scale(JObj& response, const json_value *params)
         response << jrpc_result(scale);
 }
 
+static JObj histogram_obj(const LatencyHistogram& h)
+{
+    JAry buckets;
+    for (int i = 0; i < LatencyHistogram::NUM_BUCKETS; i++)
+    {
+        JObj b;
+        double limit = LatencyHistogram::BucketLimitMs(i);
+        if (limit > 0.0)
+            b << NV("lt_ms", limit, 0);
+        else
+            b << NV("lt_ms", NULL_VALUE);
+        b << NV("count", (int) h.buckets[i]);
+        buckets << b;
+    }
+
+    JObj obj;
+    obj << NV("count", (int) h.count)
+        << NV("mean_ms", h.MeanMs(), 3)
+        << NV("max_ms", h.maxMs, 3)
+        << NV("buckets", buckets);
+    return obj;
+}
+
+static JObj worker_latency_obj(const WorkerLatencyStats& stats)
+{
+    JObj obj;
+    for (int kind = 0; kind < WorkerLatencyStats::NUM_KINDS; kind++)
+    {
+        JObj t;
+        JObj queued = histogram_obj(stats.queued[kind]);
+        JObj service = histogram_obj(stats.service[kind]);
+        t << NV("queued", queued) << NV("service", service);
+        obj << NV(WorkerLatencyStats::KindName(kind), t);
+    }
+    return obj;
+}
+
+// {"method": "get_worker_latency", "params": [reset], "id": 1}
+static void get_worker_latency(JObj& response, const json_value *params)
+{
+    bool reset = false;
+    const json_value *p;
+
+    if (params && (p = at(params, 0)) != 0)
+    {
+        if (p->type != JSON_BOOL)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected bool param at index 0");
+            return;
+        }
+        reset = p->int_value ? true : false;
+    }
+
+    JObj rslt;
+    WorkerLatencyStats stats;
+
+    if (pFrame->GetWorkerLatencyStats(false, &stats))
+        rslt << NV("primary", NULL_VALUE);
+    else
+    {
+        JObj t = worker_latency_obj(stats);
+        rslt << NV("primary", t);
+    }
+
+    if (pFrame->GetWorkerLatencyStats(true, &stats))
+        rslt << NV("secondary", NULL_VALUE);
+    else
+    {
+        JObj t = worker_latency_obj(stats);
+        rslt << NV("secondary", t);
+    }
+
+    if (reset)
+        pFrame->ResetWorkerLatencyStats();
+
+    response << jrpc_result(rslt);
+}
+
+static void get_debug_log_levels(JObj& response, const json_value *params)
+{
+    JObj rslt;
+
+    for (int i = 0; i < DBGLOG_NUM_CATEGORIES; i++)
+    {
+        DebugLogCategory category = (DebugLogCategory) i;
+        rslt << NV(DebugLog::CategoryName(category), (int) Debug.GetLevel(category));
+    }
+
+    response << jrpc_result(rslt);
+}
+
+// {"method": "set_debug_log_level", "params": [category, level], "id": 1}
+static void set_debug_log_level(JObj& response, const json_value *params)
+{
+    const json_value *p;
+    DebugLogCategory category;
+
+    if (!params || (p = at(params, 0)) == 0 || p->type != JSON_STRING ||
+        DebugLog::CategoryFromName(p->string_value, &category))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected debug log category param");
+        return;
+    }
+
+    if ((p = at(params, 1)) == 0 || p->type != JSON_INT || p->int_value < DBGLOG_OFF || p->int_value > DBGLOG_VERBOSE)
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected debug log level param (0-2)");
+        return;
+    }
+
+    Debug.SetLevel(category, (DebugLogLevel) p->int_value);
+
+    response << jrpc_result(0);
+}
+
 static void get_app_state(JObj& response, const json_value *params)
 {
     EXPOSED_STATE st = Guider::GetExposedState();
@@ -1217,12 +1523,12 @@ static void dither(JObj& response, const json_value *params)
 
 static void dump_request(const wxSocketClient *cli, const json_value *req)
 {
-    Debug.AddLine(wxString::Format("evsrv: cli %p request: %s", cli, json_format(req)));
+    DEBUG_LOG(DBGLOG_SERVER, DBGLOG_NORMAL).AddLine(wxString::Format("evsrv: cli %p request: %s", cli, json_format(req)));
 }
 
 static void dump_response(const wxSocketClient *cli, const JRpcResponse& resp)
 {
-    Debug.AddLine(wxString::Format("evsrv: cli %p response: %s", cli, const_cast<JRpcResponse&>(resp).str()));
+    DEBUG_LOG(DBGLOG_SERVER, DBGLOG_NORMAL).AddLine(wxString::Format("evsrv: cli %p response: %s", cli, const_cast<JRpcResponse&>(resp).str()));
 }
 
 static bool handle_request(const wxSocketClient *cli, JObj& response, const json_value *req)
@@ -1267,6 +1573,9 @@ static bool handle_request(const wxSocketClient *cli, JObj& response, const json
         { "find_star", &find_star, },
         { "get_pixel_scale", &get_pixel_scale, },
         { "get_app_state", &get_app_state, },
+        { "get_worker_latency", &get_worker_latency, },
+        { "get_debug_log_levels", &get_debug_log_levels, },
+        { "set_debug_log_level", &set_debug_log_level, },
         { "flip_calibration", &flip_calibration, },
         { "get_lock_shift_enabled", &get_lock_shift_enabled, },
         { "set_lock_shift_enabled", &set_lock_shift_enabled, },
@@ -1431,12 +1740,16 @@ void EventServer::EventServerStop()
     if (!m_serverSocket)
         return;
 
-    for (CliSockSet::const_iterator it = m_eventServerClients.begin();
-         it != m_eventServerClients.end(); ++it)
     {
-        destroy_client(*it);
+        wxCriticalSectionLocker lck(s_outputLock);
+
+        for (CliSockSet::const_iterator it = m_eventServerClients.begin();
+             it != m_eventServerClients.end(); ++it)
+        {
+            destroy_client(*it);
+        }
+        m_eventServerClients.clear();
     }
-    m_eventServerClients.clear();
 
     delete m_serverSocket;
     m_serverSocket = NULL;
@@ -1459,13 +1772,14 @@ void EventServer::OnEventServerEvent(wxSocketEvent& event)
     Debug.AddLine("evsrv: cli %p connect", client);
 
     client->SetEventHandler(*this, EVENT_SERVER_CLIENT_ID);
-    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG);
+    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG | wxSOCKET_OUTPUT_FLAG);
     client->SetFlags(wxSOCKET_NOWAIT);
     client->Notify(true);
-    client->SetClientData(new ClientReadBuf());
+    client->SetClientData(new ClientData());
 
     send_catchup_events(client);
 
+    wxCriticalSectionLocker lck(s_outputLock);
     m_eventServerClients.insert(client);
 }
 
@@ -1477,6 +1791,8 @@ void EventServer::OnEventServerClientEvent(wxSocketEvent& event)
     {
         Debug.AddLine("evsrv: cli %p disconnect", cli);
 
+        wxCriticalSectionLocker lck(s_outputLock);
+
         unsigned int const n = m_eventServerClients.erase(cli);
         if (n != 1)
             Debug.AddLine("client disconnected but not present in client set!");
@@ -1487,12 +1803,53 @@ void EventServer::OnEventServerClientEvent(wxSocketEvent& event)
     {
         handle_cli_input(cli, m_parser);
     }
+    else if (event.GetSocketEvent() == wxSOCKET_OUTPUT)
+    {
+        FlushClients();
+    }
     else
     {
         Debug.AddLine("unexpected client socket event %d", event.GetSocketEvent());
     }
 }
 
+void EventServer::OnFlushClients(wxThreadEvent& evt)
+{
+    FlushClients();
+}
+
+// Writes queued output to the clients and disconnects the clients that
+// exceeded the output queue limits. Runs on the main thread.
+void EventServer::FlushClients()
+{
+    wxCriticalSectionLocker lck(s_outputLock);
+
+    s_flushPending = false;
+
+    wxLongLong now = ::wxGetUTCTimeMillis();
+    std::vector<wxSocketClient *> dropped;
+
+    for (CliSockSet::const_iterator it = m_eventServerClients.begin();
+         it != m_eventServerClients.end(); ++it)
+    {
+        wxSocketClient *cli = *it;
+        if (!client_data(cli)->disconnect)
+            flush_client(cli, now);
+        if (client_data(cli)->disconnect)
+            dropped.push_back(cli);
+    }
+
+    for (std::vector<wxSocketClient *>::const_iterator it = dropped.begin(); it != dropped.end(); ++it)
+    {
+        wxSocketClient *cli = *it;
+        ClientData *cd = client_data(cli);
+        Debug.AddLine("evsrv: cli %p disconnected: %s, %u bytes queued", cli, cd->disconnectReason,
+            (unsigned int) cd->queuedBytes);
+        m_eventServerClients.erase(cli);
+        destroy_client(cli);
+    }
+}
+
 void EventServer::NotifyStartCalibration(Mount *mount)
 {
     SIMPLE_NOTIFY_EV(ev_start_calibration(mount));
@@ -1568,7 +1925,7 @@ void EventServer::NotifyStarLost(const FrameDroppedInfo& info)
     if (!info.status.IsEmpty())
         ev << NV("Status", info.status);
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, ev, "StarLost");
 }
 
 void EventServer::NotifyStartGuiding()
@@ -1638,7 +1995,7 @@ void EventServer::NotifyGuideStep(const GuideStepInfo& step)
     if (step.decLimited)
         ev << NV("DecLimited", true);
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, ev, "GuideStep");
 }
 
 void EventServer::NotifyGuidingDithered(double dx, double dy)
@@ -1680,9 +2037,9 @@ void EventServer::NotifySettling(double distance, double time, double settleTime
 
     Ev ev(ev_settling(distance, time, settleTime));
 
-    Debug.AddLine(wxString::Format("evsrv: %s", ev.str()));
+    DEBUG_LOG(DBGLOG_SERVER, DBGLOG_NORMAL).AddLine(wxString::Format("evsrv: %s", ev.str()));
 
-    do_notify(m_eventServerClients, ev);
+    do_notify(m_eventServerClients, ev, "Settling");
 }
 
 void EventServer::NotifySettleDone(const wxString& errorMsg)
@@ -1692,7 +2049,7 @@ void EventServer::NotifySettleDone(const wxString& errorMsg)
 
     Ev ev(ev_settle_done(errorMsg));
 
-    Debug.AddLine(wxString::Format("evsrv: %s", ev.str()));
+    DEBUG_LOG(DBGLOG_SERVER, DBGLOG_NORMAL).AddLine(wxString::Format("evsrv: %s", ev.str()));
 
     do_notify(m_eventServerClients, ev);
 }
@@ -79,6 +79,8 @@ public:
 private:
     void OnEventServerEvent(wxSocketEvent& evt);
     void OnEventServerClientEvent(wxSocketEvent& evt);
+    void OnFlushClients(wxThreadEvent& evt);
+    void FlushClients();
 
     wxDECLARE_EVENT_TABLE();
 };
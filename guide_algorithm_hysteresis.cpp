@@ -87,7 +87,7 @@ double GuideAlgorithmHysteresis::result(double input)
 
     m_lastMove = dReturn;
 
-    Debug.Write(wxString::Format("GuideAlgorithmHysteresis::Result() returns %.2f from input %.2f\n", dReturn, input));
+    DEBUG_LOG(DBGLOG_ALGORITHM, DBGLOG_VERBOSE).Write(wxString::Format("GuideAlgorithmHysteresis::Result() returns %.2f from input %.2f\n", dReturn, input));
 
     return dReturn;
 }
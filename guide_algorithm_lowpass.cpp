@@ -88,7 +88,7 @@ double GuideAlgorithmLowpass::result(double input)
 
     if (fabs(dReturn) > fabs(input))
     {
-        Debug.Write(wxString::Format("GuideAlgorithmLowpass::Result() input %.2f is < calculated value %.2f, using input\n", input, dReturn));
+        DEBUG_LOG(DBGLOG_ALGORITHM, DBGLOG_VERBOSE).Write(wxString::Format("GuideAlgorithmLowpass::Result() input %.2f is < calculated value %.2f, using input\n", input, dReturn));
         dReturn = input;
     }
 
@@ -103,7 +103,7 @@ double GuideAlgorithmLowpass::result(double input)
         dReturn = 0.0;
     }
 
-    Debug.Write(wxString::Format("GuideAlgorithmLowpass::Result() returns %.2f from input %.2f\n", dReturn, input));
+    DEBUG_LOG(DBGLOG_ALGORITHM, DBGLOG_VERBOSE).Write(wxString::Format("GuideAlgorithmLowpass::Result() returns %.2f from input %.2f\n", dReturn, input));
 
     return dReturn;
 }
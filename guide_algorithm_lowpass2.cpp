@@ -96,7 +96,7 @@ double GuideAlgorithmLowpass2::result(double input)
 
     if (fabs(dReturn) > fabs(input))            // Keep guide pulses below magnitude of last deflection
     {
-        Debug.Write(wxString::Format("GuideAlgorithmLowpass2::Result() input %.2f is < calculated value %.2f, using input\n", input, dReturn));
+        DEBUG_LOG(DBGLOG_ALGORITHM, DBGLOG_VERBOSE).Write(wxString::Format("GuideAlgorithmLowpass2::Result() input %.2f is < calculated value %.2f, using input\n", input, dReturn));
         dReturn = input * attenuation;
         m_rejects++;
         if (m_rejects > 3)          // 3-in-a-row, our slope is not useful
@@ -110,7 +110,7 @@ double GuideAlgorithmLowpass2::result(double input)
     if (fabs(input) < m_minMove)
         dReturn = 0.0;
 
-    Debug.Write(wxString::Format("GuideAlgorithmLowpass2::Result() returns %.2f from input %.2f\n", dReturn, input));
+    DEBUG_LOG(DBGLOG_ALGORITHM, DBGLOG_VERBOSE).Write(wxString::Format("GuideAlgorithmLowpass2::Result() returns %.2f from input %.2f\n", dReturn, input));
     return dReturn;
 }
 
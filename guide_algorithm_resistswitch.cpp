@@ -171,7 +171,7 @@ double GuideAlgorithmResistSwitch::result(double input)
         dReturn = 0.0;
     }
 
-    Debug.Write(wxString::Format("GuideAlgorithmResistSwitch::Result() returns %.2f from input %.2f\n", dReturn, input));
+    DEBUG_LOG(DBGLOG_ALGORITHM, DBGLOG_VERBOSE).Write(wxString::Format("GuideAlgorithmResistSwitch::Result() returns %.2f from input %.2f\n", dReturn, input));
 
     return dReturn * m_aggression;
 }
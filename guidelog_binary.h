@@ -0,0 +1,523 @@
+/*
+ *  guidelog_binary.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDELOG_BINARY_H_INCLUDED
+#define GUIDELOG_BINARY_H_INCLUDED
+
+/*
+ * Binary guide log format
+ *
+ * The binary guide log holds the same information as the text guide log in a
+ * compact form: a file header followed by a sequence of records. Guide steps,
+ * dropped frames and the frequent guiding events have typed, fixed layout
+ * records; everything else (headers, settings summaries, begin/end lines) is
+ * stored as a text record holding the exact text of the text log.
+ *
+ *   file header:  "PHD2GLOG" (8 bytes), u16 format version
+ *   record:       u8 type, u32 payload length, payload
+ *
+ * Integers are little endian, doubles are stored as their IEEE 754 bit
+ * pattern (little endian), and strings are a u32 byte count followed by UTF-8
+ * text. Readers skip records of unknown type using the payload length.
+ *
+ * The Format functions produce the text guide log line for each record; the
+ * text guide log uses them too, so a converted binary log matches the text log
+ * byte for byte.
+ *
+ * This header does not depend on wxWidgets so that standalone tools can use it.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define GUIDELOG_BINARY_MAGIC "PHD2GLOG"
+
+enum
+{
+    GUIDELOG_BINARY_MAGIC_LEN = 8,
+    GUIDELOG_BINARY_VERSION = 1,
+    GUIDELOG_RECORD_HEADER_LEN = 5
+};
+
+enum GUIDELOG_RECORD_TYPE
+{
+    GLREC_TEXT = 1,
+    GLREC_GUIDE_STEP,
+    GLREC_FRAME_DROPPED,
+    GLREC_CALIBRATION_STEP,
+    GLREC_CALIBRATION_DIRECTION_COMPLETE,
+    GLREC_DITHER,
+    GLREC_SET_LOCK_POSITION,
+    GLREC_SETTLING,
+    GLREC_LOCK_SHIFT
+};
+
+struct GuideLogStepRecord
+{
+    int frameNumber;
+    double time;
+    bool ao;                    // step taken by the AO rather than the mount
+    double dx, dy;              // camera offset
+    double raRaw, decRaw;       // mount offset
+    double raGuide, decGuide;   // guide algorithm output
+    int raDuration;             // pulse ms, or signed AO steps
+    int decDuration;
+    char raDirection[4];        // direction as shown in the log, empty if no pulse
+    char decDirection[4];
+    double starMass;
+    double snr;
+    int errorCode;
+};
+
+struct GuideLogDropRecord
+{
+    int frameNumber;
+    double time;
+    double starMass;
+    double snr;
+    int errorCode;
+    std::string status;
+};
+
+struct GuideLogCalStepRecord
+{
+    std::string direction;
+    int steps;
+    double dx, dy;
+    double x, y;
+    double dist;
+};
+
+struct GuideLogCalDirectionRecord
+{
+    std::string direction;
+    double angleDegrees;
+    double rate;                // px/sec as shown in the log
+};
+
+struct GuideLogDitherRecord
+{
+    double dx, dy;
+    double lockX, lockY;
+};
+
+struct GuideLogLockPosRecord
+{
+    double lockX, lockY;
+};
+
+struct GuideLogLockShiftRecord
+{
+    bool enabled;
+    bool mountCoords;           // RA,Dec rather than X,Y
+    bool arcsec;                // rate units arc-sec rather than pixels
+    double rateX, rateY;
+    double cameraRateX, cameraRateY;   // px/hr
+};
+
+// Appends records to a byte buffer
+class GuideLogWriteBuffer
+{
+    std::vector<unsigned char> m_data;
+    size_t m_recordStart;
+
+public:
+    GuideLogWriteBuffer() : m_recordStart(0) { }
+
+    const unsigned char *Data() const { return m_data.empty() ? 0 : &m_data[0]; }
+    size_t Size() const { return m_data.size(); }
+    void Clear() { m_data.clear(); }
+
+    void PutU8(unsigned int v) { m_data.push_back((unsigned char) v); }
+    void PutU16(unsigned int v) { PutU8(v & 0xff); PutU8((v >> 8) & 0xff); }
+    void PutU32(unsigned int v) { PutU16(v & 0xffff); PutU16((v >> 16) & 0xffff); }
+    void PutI32(int v) { PutU32((unsigned int) v); }
+    void PutF64(double v)
+    {
+        unsigned char b[8];
+        memcpy(b, &v, 8);
+        unsigned int const one = 1;
+        bool const little = *(const unsigned char *) &one == 1;
+        for (int i = 0; i < 8; i++)
+            PutU8(b[little ? i : 7 - i]);
+    }
+    void PutBytes(const void *p, size_t n)
+    {
+        const unsigned char *b = (const unsigned char *) p;
+        m_data.insert(m_data.end(), b, b + n);
+    }
+    void PutStr(const std::string& s) { PutU32((unsigned int) s.size()); PutBytes(s.data(), s.size()); }
+
+    void PutFileHeader()
+    {
+        PutBytes(GUIDELOG_BINARY_MAGIC, GUIDELOG_BINARY_MAGIC_LEN);
+        PutU16(GUIDELOG_BINARY_VERSION);
+    }
+
+    void BeginRecord(GUIDELOG_RECORD_TYPE type)
+    {
+        m_recordStart = m_data.size();
+        PutU8(type);
+        PutU32(0);
+    }
+
+    void EndRecord()
+    {
+        unsigned int len = (unsigned int) (m_data.size() - m_recordStart - GUIDELOG_RECORD_HEADER_LEN);
+        for (int i = 0; i < 4; i++)
+            m_data[m_recordStart + 1 + i] = (unsigned char) ((len >> (8 * i)) & 0xff);
+    }
+};
+
+// Reads values from a record payload; reading past the end sets the error flag
+class GuideLogReadBuffer
+{
+    const unsigned char *m_p;
+    const unsigned char *m_end;
+    bool m_error;
+
+    bool Need(size_t n)
+    {
+        if (m_error || (size_t) (m_end - m_p) < n)
+        {
+            m_error = true;
+            return false;
+        }
+        return true;
+    }
+
+public:
+    GuideLogReadBuffer(const unsigned char *p, size_t n) : m_p(p), m_end(p + n), m_error(false) { }
+
+    bool Error() const { return m_error; }
+
+    unsigned int GetU8() { return Need(1) ? *m_p++ : 0; }
+    unsigned int GetU16() { unsigned int lo = GetU8(); return lo | (GetU8() << 8); }
+    unsigned int GetU32() { unsigned int lo = GetU16(); return lo | (GetU16() << 16); }
+    int GetI32() { return (int) GetU32(); }
+    double GetF64()
+    {
+        unsigned char b[8];
+        unsigned int const one = 1;
+        bool const little = *(const unsigned char *) &one == 1;
+        for (int i = 0; i < 8; i++)
+            b[little ? i : 7 - i] = (unsigned char) GetU8();
+        double v;
+        memcpy(&v, b, 8);
+        return v;
+    }
+    void GetBytes(void *p, size_t n)
+    {
+        if (Need(n))
+        {
+            memcpy(p, m_p, n);
+            m_p += n;
+        }
+        else
+            memset(p, 0, n);
+    }
+    std::string GetStr()
+    {
+        unsigned int n = GetU32();
+        if (!Need(n))
+            return std::string();
+        std::string s((const char *) m_p, n);
+        m_p += n;
+        return s;
+    }
+};
+
+// encode / decode
+
+inline void GuideLogEncode(GuideLogWriteBuffer& b, const GuideLogStepRecord& r)
+{
+    b.BeginRecord(GLREC_GUIDE_STEP);
+    b.PutI32(r.frameNumber);
+    b.PutF64(r.time);
+    b.PutU8(r.ao ? 1 : 0);
+    b.PutF64(r.dx);
+    b.PutF64(r.dy);
+    b.PutF64(r.raRaw);
+    b.PutF64(r.decRaw);
+    b.PutF64(r.raGuide);
+    b.PutF64(r.decGuide);
+    b.PutI32(r.raDuration);
+    b.PutI32(r.decDuration);
+    b.PutBytes(r.raDirection, sizeof(r.raDirection));
+    b.PutBytes(r.decDirection, sizeof(r.decDirection));
+    b.PutF64(r.starMass);
+    b.PutF64(r.snr);
+    b.PutI32(r.errorCode);
+    b.EndRecord();
+}
+
+inline bool GuideLogDecode(GuideLogReadBuffer& b, GuideLogStepRecord *r)
+{
+    r->frameNumber = b.GetI32();
+    r->time = b.GetF64();
+    r->ao = b.GetU8() != 0;
+    r->dx = b.GetF64();
+    r->dy = b.GetF64();
+    r->raRaw = b.GetF64();
+    r->decRaw = b.GetF64();
+    r->raGuide = b.GetF64();
+    r->decGuide = b.GetF64();
+    r->raDuration = b.GetI32();
+    r->decDuration = b.GetI32();
+    b.GetBytes(r->raDirection, sizeof(r->raDirection));
+    b.GetBytes(r->decDirection, sizeof(r->decDirection));
+    r->raDirection[sizeof(r->raDirection) - 1] = 0;
+    r->decDirection[sizeof(r->decDirection) - 1] = 0;
+    r->starMass = b.GetF64();
+    r->snr = b.GetF64();
+    r->errorCode = b.GetI32();
+    return !b.Error();
+}
+
+inline void GuideLogEncode(GuideLogWriteBuffer& b, const GuideLogDropRecord& r)
+{
+    b.BeginRecord(GLREC_FRAME_DROPPED);
+    b.PutI32(r.frameNumber);
+    b.PutF64(r.time);
+    b.PutF64(r.starMass);
+    b.PutF64(r.snr);
+    b.PutI32(r.errorCode);
+    b.PutStr(r.status);
+    b.EndRecord();
+}
+
+inline bool GuideLogDecode(GuideLogReadBuffer& b, GuideLogDropRecord *r)
+{
+    r->frameNumber = b.GetI32();
+    r->time = b.GetF64();
+    r->starMass = b.GetF64();
+    r->snr = b.GetF64();
+    r->errorCode = b.GetI32();
+    r->status = b.GetStr();
+    return !b.Error();
+}
+
+inline void GuideLogEncode(GuideLogWriteBuffer& b, const GuideLogCalStepRecord& r)
+{
+    b.BeginRecord(GLREC_CALIBRATION_STEP);
+    b.PutStr(r.direction);
+    b.PutI32(r.steps);
+    b.PutF64(r.dx);
+    b.PutF64(r.dy);
+    b.PutF64(r.x);
+    b.PutF64(r.y);
+    b.PutF64(r.dist);
+    b.EndRecord();
+}
+
+inline bool GuideLogDecode(GuideLogReadBuffer& b, GuideLogCalStepRecord *r)
+{
+    r->direction = b.GetStr();
+    r->steps = b.GetI32();
+    r->dx = b.GetF64();
+    r->dy = b.GetF64();
+    r->x = b.GetF64();
+    r->y = b.GetF64();
+    r->dist = b.GetF64();
+    return !b.Error();
+}
+
+inline void GuideLogEncode(GuideLogWriteBuffer& b, const GuideLogCalDirectionRecord& r)
+{
+    b.BeginRecord(GLREC_CALIBRATION_DIRECTION_COMPLETE);
+    b.PutStr(r.direction);
+    b.PutF64(r.angleDegrees);
+    b.PutF64(r.rate);
+    b.EndRecord();
+}
+
+inline bool GuideLogDecode(GuideLogReadBuffer& b, GuideLogCalDirectionRecord *r)
+{
+    r->direction = b.GetStr();
+    r->angleDegrees = b.GetF64();
+    r->rate = b.GetF64();
+    return !b.Error();
+}
+
+inline void GuideLogEncode(GuideLogWriteBuffer& b, const GuideLogDitherRecord& r)
+{
+    b.BeginRecord(GLREC_DITHER);
+    b.PutF64(r.dx);
+    b.PutF64(r.dy);
+    b.PutF64(r.lockX);
+    b.PutF64(r.lockY);
+    b.EndRecord();
+}
+
+inline bool GuideLogDecode(GuideLogReadBuffer& b, GuideLogDitherRecord *r)
+{
+    r->dx = b.GetF64();
+    r->dy = b.GetF64();
+    r->lockX = b.GetF64();
+    r->lockY = b.GetF64();
+    return !b.Error();
+}
+
+inline void GuideLogEncode(GuideLogWriteBuffer& b, const GuideLogLockPosRecord& r)
+{
+    b.BeginRecord(GLREC_SET_LOCK_POSITION);
+    b.PutF64(r.lockX);
+    b.PutF64(r.lockY);
+    b.EndRecord();
+}
+
+inline bool GuideLogDecode(GuideLogReadBuffer& b, GuideLogLockPosRecord *r)
+{
+    r->lockX = b.GetF64();
+    r->lockY = b.GetF64();
+    return !b.Error();
+}
+
+inline void GuideLogEncode(GuideLogWriteBuffer& b, const GuideLogLockShiftRecord& r)
+{
+    b.BeginRecord(GLREC_LOCK_SHIFT);
+    b.PutU8((r.enabled ? 1 : 0) | (r.mountCoords ? 2 : 0) | (r.arcsec ? 4 : 0));
+    b.PutF64(r.rateX);
+    b.PutF64(r.rateY);
+    b.PutF64(r.cameraRateX);
+    b.PutF64(r.cameraRateY);
+    b.EndRecord();
+}
+
+inline bool GuideLogDecode(GuideLogReadBuffer& b, GuideLogLockShiftRecord *r)
+{
+    unsigned int flags = b.GetU8();
+    r->enabled = (flags & 1) != 0;
+    r->mountCoords = (flags & 2) != 0;
+    r->arcsec = (flags & 4) != 0;
+    r->rateX = b.GetF64();
+    r->rateY = b.GetF64();
+    r->cameraRateX = b.GetF64();
+    r->cameraRateY = b.GetF64();
+    return !b.Error();
+}
+
+// text records (GLREC_TEXT, and GLREC_SETTLING which holds the message)
+
+inline void GuideLogEncodeText(GuideLogWriteBuffer& b, GUIDELOG_RECORD_TYPE type, const std::string& s)
+{
+    b.BeginRecord(type);
+    b.PutBytes(s.data(), s.size());
+    b.EndRecord();
+}
+
+// text log formatting
+
+inline std::string GuideLogPrintf(const char *format, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (n < 0)
+        return std::string();
+    if ((size_t) n < sizeof(buf))
+        return std::string(buf, n);
+
+    std::vector<char> big(n + 1);
+    va_start(args, format);
+    vsnprintf(&big[0], big.size(), format, args);
+    va_end(args);
+    return std::string(&big[0], n);
+}
+
+inline std::string GuideLogFormat(const GuideLogStepRecord& r)
+{
+    std::string s = GuideLogPrintf("%d,%.3f,\"%s\",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,",
+        r.frameNumber, r.time, r.ao ? "AO" : "Mount", r.dx, r.dy, r.raRaw, r.decRaw, r.raGuide, r.decGuide);
+
+    if (r.ao)
+        s += GuideLogPrintf(",,,,%d,%d,", r.raDuration, r.decDuration);
+    else
+        s += GuideLogPrintf("%d,%s,%d,%s,,,", r.raDuration, r.raDirection, r.decDuration, r.decDirection);
+
+    s += GuideLogPrintf("%.f,%.2f,%d\n", r.starMass, r.snr, r.errorCode);
+
+    return s;
+}
+
+inline std::string GuideLogFormat(const GuideLogDropRecord& r)
+{
+    return GuideLogPrintf("%d,%.3f,\"DROP\",,,,,,,,,,,,,%.f,%.2f,%d,\"", r.frameNumber, r.time, r.starMass, r.snr, r.errorCode) +
+        r.status + "\"\n";
+}
+
+inline std::string GuideLogFormat(const GuideLogCalStepRecord& r)
+{
+    // Direction,Step,dx,dy,x,y,Dist
+    return r.direction + GuideLogPrintf(",%d,%.3f,%.3f,%.3f,%.3f,%.3f\n", r.steps, r.dx, r.dy, r.x, r.y, r.dist);
+}
+
+inline std::string GuideLogFormat(const GuideLogCalDirectionRecord& r)
+{
+    return r.direction + GuideLogPrintf(" calibration complete. Angle = %.1f deg, Rate = %.3f\n", r.angleDegrees, r.rate);
+}
+
+inline std::string GuideLogFormat(const GuideLogDitherRecord& r)
+{
+    return GuideLogPrintf("INFO: DITHER by %.3f, %.3f, new lock pos = %.3f, %.3f\n", r.dx, r.dy, r.lockX, r.lockY);
+}
+
+inline std::string GuideLogFormat(const GuideLogLockPosRecord& r)
+{
+    return GuideLogPrintf("INFO: SET LOCK POSITION, new lock pos = %.3f, %.3f\n", r.lockX, r.lockY);
+}
+
+inline std::string GuideLogFormatSettling(const std::string& msg)
+{
+    return "INFO: SETTLING STATE CHANGE, " + msg + "\n";
+}
+
+inline std::string GuideLogFormat(const GuideLogLockShiftRecord& r)
+{
+    std::string details;
+    if (r.enabled)
+    {
+        details = GuideLogPrintf("%s rate (%.2f,%.2f) %s/hr (%.2f,%.2f) px/hr",
+            r.mountCoords ? "RA,Dec" : "X,Y", r.rateX, r.rateY, r.arcsec ? "arc-sec" : "pixels",
+            r.cameraRateX, r.cameraRateY);
+    }
+    return GuideLogPrintf("INFO: LOCK SHIFT, enabled = %d ", r.enabled ? 1 : 0) + details + "\n";
+}
+
+#endif // GUIDELOG_BINARY_H_INCLUDED
@@ -110,6 +110,8 @@ Guider::Guider(wxWindow *parent, int xSize, int ySize) :
     m_state = STATE_UNINITIALIZED;
     m_scaleFactor = 1.0;
     m_displayedImage = new wxImage(XWinSize,YWinSize,true);
+    m_imageGeneration = 0;
+    m_displayValid = false;
     m_paused = PAUSE_NONE;
     m_starFoundTimestamp = 0;
     m_avgDistanceNeedReset = false;
@@ -162,6 +164,8 @@ void Guider::LoadProfileSettings(void)
 
 PauseType Guider::SetPaused(PauseType pause)
 {
+    wxCriticalSectionLocker lock(m_guideLock);
+
     Debug.AddLine("Guider::SetPaused(%d)", pause);
     PauseType prev = m_paused;
     m_paused = pause;
@@ -177,6 +181,8 @@ PauseType Guider::SetPaused(PauseType pause)
 
 void Guider::ForceFullFrame(void)
 {
+    wxCriticalSectionLocker lock(m_guideLock);
+
     if (!m_forceFullFrame)
     {
         Debug.AddLine("setting force full frames = true");
@@ -370,28 +376,48 @@ bool Guider::PaintHelper(wxClientDC& dc, wxMemoryDC& memDC)
 
     try
     {
-        GUIDER_STATE state = GetState();
-        GetSize(&XWinSize, &YWinSize);
-
-        if (m_pCurrentImage->ImageData)
+        // the processing thread moves the star and the lock position while
+        // guiding; copy them rather than holding the lock while painting
+        GUIDER_STATE state;
+        PHD_Point starPos;
+        PHD_Point lockPos;
         {
-            int blevel = m_pCurrentImage->FiltMin;
-            int wlevel = m_pCurrentImage->FiltMax;
-            m_pCurrentImage->CopyToImage(&m_displayedImage, blevel, wlevel, pFrame->Stretch_gamma);
+            wxCriticalSectionLocker lock(m_guideLock);
+            state = GetState();
+            starPos = CurrentPosition();
+            lockPos = LockPosition();
         }
 
-        int imageWidth   = m_displayedImage->GetWidth();
-        int imageHeight  = m_displayedImage->GetHeight();
+        GetSize(&XWinSize, &YWinSize);
+
+        // only convert and scale the image if it or the way it is displayed
+        // changed since the last paint; overlays are always redrawn
+
+        DisplayState display;
+        display.imageGeneration = m_imageGeneration;
+        display.blevel = m_pCurrentImage->FiltMin;
+        display.wlevel = m_pCurrentImage->FiltMax;
+        display.gamma = pFrame->Stretch_gamma;
+        display.winSize = wxSize(XWinSize, YWinSize);
+        display.scaleImage = m_scaleImage;
+
+        bool rerender = !m_pCurrentImage->ImageData || !m_displayValid || !(display == m_displayState);
+
+        // work out the displayed size first, so that a large image can be
+        // downscaled and stretched in one pass over the raw data
+
+        int imageWidth   = m_pCurrentImage->ImageData ? m_pCurrentImage->Size.GetWidth() : m_displayedImage->GetWidth();
+        int imageHeight  = m_pCurrentImage->ImageData ? m_pCurrentImage->Size.GetHeight() : m_displayedImage->GetHeight();
+        int newWidth = imageWidth;
+        int newHeight = imageHeight;
 
         // scale the image if necessary
 
-        if (imageWidth != XWinSize || imageHeight != YWinSize)
+        if (rerender && (imageWidth != XWinSize || imageHeight != YWinSize))
         {
             // The image is not the exact right size -- figure out what to do.
             double xScaleFactor = imageWidth / (double)XWinSize;
             double yScaleFactor = imageHeight / (double)YWinSize;
-            int newWidth = imageWidth;
-            int newHeight = imageHeight;
 
             double newScaleFactor = (xScaleFactor > yScaleFactor) ?
                                     xScaleFactor :
@@ -419,9 +445,10 @@ bool Guider::PaintHelper(wxClientDC& dc, wxMemoryDC& memDC)
 
                 Debug.AddLine("Resizing image to %d,%d", newWidth, newHeight);
 
-                if (newWidth > 0 && newHeight > 0)
+                if (newWidth <= 0 || newHeight <= 0)
                 {
-                    m_displayedImage->Rescale(newWidth, newHeight, wxIMAGE_QUALITY_HIGH);
+                    newWidth = imageWidth;
+                    newHeight = imageHeight;
                 }
             }
             else
@@ -430,13 +457,75 @@ bool Guider::PaintHelper(wxClientDC& dc, wxMemoryDC& memDC)
             }
         }
 
-        // important to provide explicit color for r,g,b, optional args to Size().
-        // If default args are provided wxWidgets performs some expensive histogram
-        // operations.
-        wxBitmap DisplayedBitmap(m_displayedImage->Size(wxSize(XWinSize, YWinSize), wxPoint(0, 0), 0, 0, 0));
-        memDC.SelectObject(DisplayedBitmap);
+        if (rerender)
+        {
+            bool resize = newWidth != imageWidth || newHeight != imageHeight;
+            wxRect dirty;
+
+            if (display.winSize == m_displayState.winSize && display.scaleImage == m_displayState.scaleImage &&
+                CanUpdateDisplayIncrementally(m_pCurrentImage, &dirty))
+            {
+                // only the rows covering the old and new subframes change;
+                // render those and patch them into the backbuffer
+                wxRect rect = DisplayedRect(dirty);
+
+                if (m_displayedImage->GetSize() == m_pCurrentImage->Size)
+                {
+                    m_pCurrentImage->CopyToImage(&m_displayedImage, display.blevel, display.wlevel, display.gamma,
+                        &m_stretchLUT, rect.GetTop(), rect.GetBottom() + 1);
+                }
+                else
+                {
+                    m_pCurrentImage->CopyToScaledImage(&m_displayedImage, m_displayedImage->GetSize(),
+                        display.blevel, display.wlevel, display.gamma, &m_stretchLUT, rect.GetTop(), rect.GetBottom() + 1);
+                }
 
-        dc.Blit(0, 0, DisplayedBitmap.GetWidth(), DisplayedBitmap.GetHeight(), &memDC, 0, 0, wxCOPY, false);
+                wxBitmap patch(m_displayedImage->GetSubImage(rect));
+                wxMemoryDC bufDC(m_displayBitmap);
+                bufDC.DrawBitmap(patch, rect.GetLeft(), rect.GetTop(), false);
+            }
+            else
+            {
+                if (m_pCurrentImage->ImageData && resize && newWidth <= imageWidth && newHeight <= imageHeight)
+                {
+                    m_pCurrentImage->CopyToScaledImage(&m_displayedImage, wxSize(newWidth, newHeight),
+                        display.blevel, display.wlevel, display.gamma, &m_stretchLUT);
+                }
+                else
+                {
+                    // small images are enlarged after stretching
+                    if (m_pCurrentImage->ImageData)
+                        m_pCurrentImage->CopyToImage(&m_displayedImage, display.blevel, display.wlevel, display.gamma, &m_stretchLUT);
+                    if (resize)
+                        m_displayedImage->Rescale(newWidth, newHeight, wxIMAGE_QUALITY_HIGH);
+                }
+
+                // important to provide explicit color for r,g,b, optional args to Size().
+                // If default args are provided wxWidgets performs some expensive histogram
+                // operations.
+                m_displayBitmap = wxBitmap(m_displayedImage->Size(wxSize(XWinSize, YWinSize), wxPoint(0, 0), 0, 0, 0));
+            }
+
+            m_displayState = display;
+            m_displayValid = m_pCurrentImage->ImageData != NULL;
+            m_displayedImageSize = wxSize(imageWidth, imageHeight);
+            m_displayedSubframe = m_pCurrentImage->ImageData ? m_pCurrentImage->Subframe : wxRect();
+        }
+
+        // repaint only the invalidated part of the window; the rest of it
+        // still shows the backbuffer and the same overlays
+
+        wxRect updateBox = GetUpdateRegion().GetBox();
+        if (updateBox.IsEmpty())
+            updateBox = wxRect(0, 0, XWinSize, YWinSize);
+        dc.SetClippingRegion(updateBox);
+
+        memDC.SelectObject(m_displayBitmap);
+
+        dc.Blit(updateBox.GetLeft(), updateBox.GetTop(), updateBox.GetWidth(), updateBox.GetHeight(),
+            &memDC, updateBox.GetLeft(), updateBox.GetTop(), wxCOPY, false);
+
+        m_overlayState = CurrentOverlayState();
 
         int XImgSize = m_displayedImage->GetWidth();
         int YImgSize = m_displayedImage->GetHeight();
@@ -480,8 +569,8 @@ bool Guider::PaintHelper(wxClientDC& dc, wxMemoryDC& memDC)
                         double xAngle = pMount->IsCalibrated() ? pMount->xAngle() : 0.0;
                         double cos_angle = cos(xAngle);
                         double sin_angle = sin(xAngle);
-                        double StarX = CurrentPosition().X;
-                        double StarY = CurrentPosition().Y;
+                        double StarX = starPos.X;
+                        double StarY = starPos.Y;
 
                         dc.SetPen(wxPen(pFrame->pGraphLog->GetRaOrDxColor(),2,wxPENSTYLE_DOT));
                         r=15.0;
@@ -566,8 +655,8 @@ bool Guider::PaintHelper(wxClientDC& dc, wxMemoryDC& memDC)
         // draw the lockpoint of there is one
         if (state > STATE_SELECTED)
         {
-            double LockX = LockPosition().X;
-            double LockY = LockPosition().Y;
+            double LockX = lockPos.X;
+            double LockY = lockPos.Y;
 
             switch (state)
             {
@@ -610,6 +699,69 @@ bool Guider::PaintHelper(wxClientDC& dc, wxMemoryDC& memDC)
     return bError;
 }
 
+// A subframed image can be displayed by re-rendering only the union of its
+// subframe and the subframe of the image currently displayed: outside the
+// subframes both images are zero, which any stretch maps to black. Enlarged
+// images are always rescaled as a whole.
+bool Guider::CanUpdateDisplayIncrementally(const usImage *pImage, wxRect *dirty)
+{
+    if (!m_displayValid || !m_displayBitmap.IsOk() || !pImage->ImageData)
+        return false;
+
+    if (pImage->Subframe.IsEmpty() || m_displayedSubframe.IsEmpty() || pImage->Size != m_displayedImageSize)
+        return false;
+
+    if (m_displayedImage->GetWidth() > pImage->Size.GetWidth() || m_displayedImage->GetHeight() > pImage->Size.GetHeight())
+        return false;
+
+    *dirty = pImage->Subframe;
+    dirty->Union(m_displayedSubframe);
+    dirty->Intersect(wxRect(pImage->Size));
+
+    return !dirty->IsEmpty();
+}
+
+// Maps a rectangle of the displayed image's source to display coordinates,
+// with a pixel to spare for rounding and block averaging at the edges
+wxRect Guider::DisplayedRect(const wxRect& imageRect) const
+{
+    int const srcW = m_displayedImageSize.GetWidth();
+    int const srcH = m_displayedImageSize.GetHeight();
+    int const dstW = m_displayedImage->GetWidth();
+    int const dstH = m_displayedImage->GetHeight();
+
+    int x0 = (int)((long long) imageRect.GetLeft() * dstW / srcW) - 1;
+    int y0 = (int)((long long) imageRect.GetTop() * dstH / srcH) - 1;
+    int x1 = (int)(((long long) (imageRect.GetRight() + 1) * dstW + srcW - 1) / srcW) + 1;
+    int y1 = (int)(((long long) (imageRect.GetBottom() + 1) * dstH + srcH - 1) / srcH) + 1;
+
+    wxRect rect(wxPoint(wxMax(x0, 0), wxMax(y0, 0)), wxPoint(wxMin(x1, dstW) - 1, wxMin(y1, dstH) - 1));
+    return rect;
+}
+
+Guider::OverlayState Guider::CurrentOverlayState(void)
+{
+    wxCriticalSectionLocker lock(m_guideLock);
+
+    OverlayState overlay;
+    const PHD_Point& lockPos = LockPosition();
+
+    overlay.state = GetState();
+    overlay.overlayMode = m_overlayMode;
+    overlay.lockValid = lockPos.IsValid();
+    overlay.lockX = overlay.lockValid ? lockPos.X : 0.0;
+    overlay.lockY = overlay.lockValid ? lockPos.Y : 0.0;
+    overlay.showBookmarks = m_showBookmarks;
+    overlay.bookmarkCount = m_bookmarks.size();
+    overlay.defectMap = m_defectMapPreview;
+    overlay.polarAlignRadius = m_polarAlignCircleRadius;
+    overlay.polarAlignCorrection = m_polarAlignCircleCorrection;
+    overlay.polarAlignX = m_polarAlignCircleCenter.X;
+    overlay.polarAlignY = m_polarAlignCircleCenter.Y;
+
+    return overlay;
+}
+
 void Guider::UpdateImageDisplay(usImage *pImage)
 {
     if (!pImage)
@@ -620,7 +772,25 @@ void Guider::UpdateImageDisplay(usImage *pImage)
     Debug.AddLine("UpdateImageDisplay: Size=(%d,%d) min=%d, max=%d, FiltMin=%d, FiltMax=%d",
         pImage->Size.x, pImage->Size.y, pImage->Min, pImage->Max, pImage->FiltMin, pImage->FiltMax);
 
-    Refresh();
+    // when only the subframe moved and the overlays are unchanged, invalidate
+    // just the window area covering the old and new subframes (the star box
+    // lies inside the subframe). The RA/Dec overlay follows the star, so it
+    // always needs a full repaint.
+
+    wxRect dirty;
+    wxSize winSize = GetSize();
+
+    if (pImage == m_pCurrentImage && m_overlayMode != OVERLAY_RADEC &&
+        winSize == m_displayState.winSize && m_scaleImage == m_displayState.scaleImage &&
+        CanUpdateDisplayIncrementally(pImage, &dirty) && CurrentOverlayState() == m_overlayState)
+    {
+        RefreshRect(DisplayedRect(dirty).Inflate(2), false);
+    }
+    else
+    {
+        Refresh();
+    }
+
     Update();
 }
 
@@ -645,6 +815,7 @@ void Guider::InvalidateLockPosition(void)
 
 bool Guider::SetLockPosition(const PHD_Point& position)
 {
+    wxCriticalSectionLocker lock(m_guideLock);
     bool bError = false;
 
     try
@@ -701,6 +872,7 @@ bool Guider::SetLockPosToStarAtPosition(const PHD_Point& starPosHint)
 
 MOVE_LOCK_RESULT Guider::MoveLockPosition(const PHD_Point& mountDelta)
 {
+    wxCriticalSectionLocker lock(m_guideLock);
     MOVE_LOCK_RESULT result = MOVE_LOCK_OK;
 
     try
@@ -757,6 +929,8 @@ MOVE_LOCK_RESULT Guider::MoveLockPosition(const PHD_Point& mountDelta)
 
 void Guider::SetState(GUIDER_STATE newState)
 {
+    wxCriticalSectionLocker lock(m_guideLock);
+
     try
     {
         Debug.Write(wxString::Format("Changing from state %d to %d\n", m_state, newState));
@@ -880,6 +1054,11 @@ void Guider::SetState(GUIDER_STATE newState)
 
         if (newState >= requestedState)
         {
+            if (newState != m_state)
+            {
+                // an overlapped exposure still in flight was taken for the old state
+                pFrame->DiscardPipelinedExposure();
+            }
             m_state = newState;
         }
         else
@@ -987,6 +1166,8 @@ void Guider::StopGuiding(void)
 
 void Guider::Reset(bool fullReset)
 {
+    wxCriticalSectionLocker lock(m_guideLock);
+
     SetState(STATE_UNINITIALIZED);
     if (fullReset)
     {
@@ -996,25 +1177,269 @@ void Guider::Reset(bool fullReset)
 
 /*************  A new image is ready ************************/
 
-void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
+// With overlapped exposures the correction for the previous frame goes out
+// while this frame is exposing, so only the part of the exposure taken after
+// that move finished shows its full effect. Guiding on the rest would correct
+// the same error twice. Returns the part of the exposure taken after the last
+// move of the mount, from 0 (all of it overlapped a move) to 1.
+static double PartAfterLastMove(const usImage *pImage)
+{
+    if (!pMount || pImage->ImgStartMs == 0 || pImage->ImgEndMs <= pImage->ImgStartMs)
+        return 1.0;
+
+    wxLongLong moveStart, moveEnd;
+    pMount->GetLastMoveTimes(&moveStart, &moveEnd);
+
+    if (moveStart > moveEnd)
+    {
+        // a move is running; it started either after the exposure, or during
+        // it and has not finished yet
+        return moveStart >= pImage->ImgEndMs ? 1.0 : 0.0;
+    }
+
+    if (moveEnd <= pImage->ImgStartMs)
+        return 1.0;
+    if (moveEnd >= pImage->ImgEndMs)
+        return 0.0;
+
+    return (pImage->ImgEndMs - moveEnd).ToDouble() / (pImage->ImgEndMs - pImage->ImgStartMs).ToDouble();
+}
+
+// the guide correction for a frame while guiding; called with m_guideLock held
+void Guider::ScheduleGuideMove(usImage *pImage)
+{
+    if (m_ditherRecenterRemaining.IsValid())
+    {
+        // fast recenter after dither taking large steps and bypassing
+        // guide algorithms (normalMove=false)
+
+        PHD_Point step(wxMin(m_ditherRecenterRemaining.X, m_ditherRecenterStep.X),
+                       wxMin(m_ditherRecenterRemaining.Y, m_ditherRecenterStep.Y));
+
+        Debug.AddLine(wxString::Format("dither recenter: remaining=(%.1f,%.1f) step=(%.1f,%.1f)",
+            m_ditherRecenterRemaining.X * m_ditherRecenterDir.x,
+            m_ditherRecenterRemaining.Y * m_ditherRecenterDir.y,
+            step.X * m_ditherRecenterDir.x, step.Y * m_ditherRecenterDir.y));
+
+        m_ditherRecenterRemaining -= step;
+        if (m_ditherRecenterRemaining.X < 0.5 && m_ditherRecenterRemaining.Y < 0.5)
+        {
+            // fast recenter is done
+            m_ditherRecenterRemaining.Invalidate();
+            // reset distance tracker
+            m_avgDistanceNeedReset = true;
+        }
+
+        PHD_Point mountCoords(step.X * m_ditherRecenterDir.x, step.Y * m_ditherRecenterDir.y);
+        PHD_Point cameraCoords;
+        pMount->TransformMountCoordinatesToCameraCoordinates(mountCoords, cameraCoords);
+        pFrame->SchedulePrimaryMove(pMount, cameraCoords, false, pImage->ImgEndMs);
+    }
+    else
+    {
+        // ordinary guide step
+        s_deflectionLogger.Log(CurrentPosition());
+
+        PHD_Point offset(CurrentPosition() - LockPosition());
+
+        // the serial capture loop starts each exposure after the previous
+        // correction, and a manual pulse sent while exposing is not something
+        // to make up for, so only overlapped exposures are checked. A frame
+        // that overlapped the last move is skipped rather than having its
+        // error scaled down: the guide algorithms keep history (hysteresis,
+        // lowpass, resist switch), and a scaled error would be recorded there
+        // as a measurement that was never made.
+        if (pFrame->IsExposurePipelined())
+        {
+            double part = PartAfterLastMove(pImage);
+            if (part < 1.0)
+            {
+                Debug.AddLine("frame exposed %.0f%% before the last move completed, no correction", (1.0 - part) * 100.0);
+                return;
+            }
+        }
+
+        pFrame->SchedulePrimaryMove(pMount, offset, true, pImage->ImgEndMs);
+    }
+}
+
+// the main thread side of UpdateCurrentPosition
+void Guider::ShowStarUpdate(usImage *pImage, const GuideStepResult& step)
+{
+    if (step.starLost)
+    {
+        if (step.resetAutoExposure)
+            pFrame->ResetAutoExposure(); // use max exposure duration
+    }
+    else
+    {
+        pFrame->pProfile->UpdateData(pImage, step.starPos.X, step.starPos.Y);
+        pFrame->AdjustAutoExposure(step.starSNR);
+    }
+}
+
+void Guider::NotifyGuidingFrameDropped(const FrameDroppedInfo& info)
+{
+    GuideLog.FrameDropped(info);
+    EvtServer.NotifyStarLost(info);
+    GuidingAssistant::NotifyFrameDropped(info);
+    pFrame->pGraphLog->AppendData(info);
+
+    wxColor prevColor = GetBackgroundColour();
+    SetBackgroundColour(wxColour(64,0,0));
+    ClearBackground();
+    wxBell();
+    wxMilliSleep(100);
+    SetBackgroundColour(prevColor);
+}
+
+/*
+ * Called on the processing thread for every frame captured without error,
+ * before the frame is posted to the main thread. It counts the frame and,
+ * while guiding, runs the guide step: lock position shift, star position
+ * and mass checks, and the guide correction, which goes straight to a worker
+ * thread. This way the correction does not wait for the main thread.
+ *
+ * Returns true if the frame was handled here; the main thread must then pass
+ * the result to ShowGuideStep instead of calling UpdateGuideState. Any other
+ * state, including a pause, is left to UpdateGuideState: those frames either
+ * drive the GUI (selection, calibration) or do not move the mount.
+ */
+bool Guider::GuideStep(usImage *pImage, const StarMeasurement *measurement, GuideStepResult *result)
+{
+    wxCriticalSectionLocker lock(m_guideLock);
+
+    result->done = false;
+
+    if (m_paused == PAUSE_FULL)
+        return false;
+
+    unsigned int frameNumber = pFrame->IncrementFrameCounter();
+
+    if (m_state != STATE_GUIDING || m_paused != PAUSE_NONE)
+        return false;
+
+    result->done = true;
+    result->starLost = false;
+    result->lockShifted = false;
+    result->lockShiftDisabled = false;
+
+    if (LockPosShiftEnabled())
+    {
+        result->lockShifted = true;
+        if (ShiftLockPosition())
+        {
+            // the main thread shows the alert and sends the notifications
+            m_lockPosShift.shiftEnabled = false;
+            result->lockShiftDisabled = true;
+        }
+    }
+
+    result->starLost = UpdateCurrentPosition(pImage, result, measurement);
+
+    result->info.frameNumber = frameNumber;
+    result->info.time = pFrame->TimeSinceGuidingStarted();
+    result->info.avgDist = CurrentError();
+    result->starPos = CurrentPosition();
+    result->lockPos = LockPosition();
+
+    // the next frame is measured at the position found in this one
+    pFrame->PublishStarSeed();
+
+    if (result->starLost)
+    {
+        Debug.AddLine(wxString::Format("GuideStep: frame %u dropped: ", frameNumber) + result->info.status);
+        return true;
+    }
+
+    // we have a star selected, so re-enable subframes
+    if (m_forceFullFrame)
+    {
+        Debug.AddLine("setting force full frames = false");
+        m_forceFullFrame = false;
+    }
+
+    ScheduleGuideMove(pImage);
+
+    return true;
+}
+
+// the main thread part of a frame handled by GuideStep
+void Guider::ShowGuideStep(usImage *pImage, const GuideStepResult& step)
+{
+    Debug.AddLine("ShowGuideStep: frame %d starLost=%d", step.info.frameNumber, step.starLost);
+
+    {
+        wxCriticalSectionLocker lock(m_guideLock);
+
+        usImage *pPrevImage = m_pCurrentImage;
+        m_pCurrentImage = pImage;
+        ++m_imageGeneration;
+        pFrame->m_imagePool.Release(pPrevImage);
+    }
+
+    if (step.lockShiftDisabled)
+    {
+        pFrame->Alert(_("Shifted lock position outside allowable area. Lock Position Shift disabled."));
+        wxCriticalSectionLocker lock(m_guideLock);
+        LockPosShiftChanged();
+    }
+    if (step.lockShifted)
+    {
+        NudgeLockTool::UpdateNudgeLockControls();
+    }
+
+    ShowStarUpdate(pImage, step);
+
+    if (step.starLost)
+    {
+        NotifyGuidingFrameDropped(step.info);
+    }
+
+    pFrame->SetStatusText(step.info.status);
+    pFrame->UpdateButtonsStatus();
+
+    // only the copy is made here; the image logger thread writes the file
+    if (pFrame->IsImageLoggingEnabled() && (unsigned int) step.info.frameNumber != pFrame->m_loggedImageFrame)
+    {
+        // only log each image frame once
+        pFrame->m_loggedImageFrame = step.info.frameNumber;
+        pFrame->LogStarImage(*pImage, step.starPos, step.lockPos);
+    }
+
+    UpdateImageDisplay(pImage);
+}
+
+void Guider::UpdateGuideState(usImage *pImage, bool bStopping, const StarMeasurement *measurement)
 {
     wxString statusMessage;
 
+    // The processing thread runs GuideStep, which changes the guide state, so
+    // m_guideLock is held while this reads or changes that state, but not
+    // across alerts, notifications or calibration steps. The processing thread
+    // only moves the star while guiding; in the other states the current
+    // position can be read here without the lock.
+
     try
     {
         Debug.Write(wxString::Format("UpdateGuideState(): m_state=%d\n", m_state));
 
-        if (pImage)
         {
-            // switch in the new image
+            wxCriticalSectionLocker lock(m_guideLock);
 
-            usImage *pPrevImage = m_pCurrentImage;
-            m_pCurrentImage = pImage;
-            delete pPrevImage;
-        }
-        else
-        {
-            pImage = m_pCurrentImage;
+            if (pImage)
+            {
+                // switch in the new image
+
+                usImage *pPrevImage = m_pCurrentImage;
+                m_pCurrentImage = pImage;
+                ++m_imageGeneration;
+                pFrame->m_imagePool.Release(pPrevImage);
+            }
+            else
+            {
+                pImage = m_pCurrentImage;
+            }
         }
 
         if (bStopping)
@@ -1024,12 +1449,22 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             throw THROW_INFO("Stopped Guiding");
         }
 
-        assert(!pMount || !pMount->IsBusy());
+        assert(!pMount || !pMount->IsBusy() || pFrame->GetPipelinedCapture());
 
         // shift lock position
-        if (LockPosShiftEnabled() && IsGuiding())
+        bool lockShifted = false;
+        bool lockShiftFailed = false;
+        {
+            wxCriticalSectionLocker lock(m_guideLock);
+            if (LockPosShiftEnabled() && IsGuiding())
+            {
+                lockShifted = true;
+                lockShiftFailed = ShiftLockPosition();
+            }
+        }
+        if (lockShifted)
         {
-            if (ShiftLockPosition())
+            if (lockShiftFailed)
             {
                 pFrame->Alert(_("Shifted lock position outside allowable area. Lock Position Shift disabled."));
                 EnableLockPosShift(false);
@@ -1037,19 +1472,26 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             NudgeLockTool::UpdateNudgeLockControls();
         }
 
-        FrameDroppedInfo info;
+        GuideStepResult step;
 
-        if (UpdateCurrentPosition(pImage, &info))
         {
-            info.frameNumber = pFrame->m_frameCounter;
-            info.time = pFrame->TimeSinceGuidingStarted();
-            info.avgDist = CurrentError();
+            wxCriticalSectionLocker lock(m_guideLock);
+            step.starLost = UpdateCurrentPosition(pImage, &step, measurement);
+            step.info.frameNumber = pFrame->FrameCounter();
+            step.info.time = pFrame->TimeSinceGuidingStarted();
+            step.info.avgDist = CurrentError();
+        }
+        ShowStarUpdate(pImage, step);
+
+        if (step.starLost)
+        {
+            FrameDroppedInfo& info = step.info;
 
             switch (m_state)
             {
                 case STATE_UNINITIALIZED:
                 case STATE_SELECTING:
-                    EvtServer.NotifyLooping(pFrame->m_frameCounter);
+                    EvtServer.NotifyLooping(info.frameNumber);
                     break;
                 case STATE_SELECTED:
                     // we had a current position and lost it
@@ -1063,20 +1505,8 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
                     pFrame->SetStatusText(_("star lost"), 1);
                     break;
                 case STATE_GUIDING:
-                {
-                    GuideLog.FrameDropped(info);
-                    EvtServer.NotifyStarLost(info);
-                    GuidingAssistant::NotifyFrameDropped(info);
-                    pFrame->pGraphLog->AppendData(info);
-
-                    wxColor prevColor = GetBackgroundColour();
-                    SetBackgroundColour(wxColour(64,0,0));
-                    ClearBackground();
-                    wxBell();
-                    wxMilliSleep(100);
-                    SetBackgroundColour(prevColor);
+                    NotifyGuidingFrameDropped(info);
                     break;
-                }
 
                 case STATE_CALIBRATED:
                 case STATE_STOP:
@@ -1086,13 +1516,17 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             statusMessage = info.status;
             throw THROW_INFO("unable to update current position");
         }
-        statusMessage = info.status;
+        statusMessage = step.info.status;
 
-        // we have a star selected, so re-enable subframes
-        if (m_forceFullFrame)
         {
-            Debug.AddLine("setting force full frames = false");
-            m_forceFullFrame = false;
+            wxCriticalSectionLocker lock(m_guideLock);
+
+            // we have a star selected, so re-enable subframes
+            if (m_forceFullFrame)
+            {
+                Debug.AddLine("setting force full frames = false");
+                m_forceFullFrame = false;
+            }
         }
 
         switch (m_state)
@@ -1100,7 +1534,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             case STATE_UNINITIALIZED:
             case STATE_SELECTING:
             case STATE_SELECTED:
-                EvtServer.NotifyLooping(pFrame->m_frameCounter);
+                EvtServer.NotifyLooping(step.info.frameNumber);
                 break;
             case STATE_CALIBRATING_PRIMARY:
             case STATE_CALIBRATING_SECONDARY:
@@ -1179,59 +1613,37 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
                 }
                 assert(!pSecondaryMount || !pSecondaryMount->IsConnected() || pSecondaryMount->IsCalibrated());
 
-                // camera angle is now known, so ok to calculate shift rate camera coords
-                UpdateLockPosShiftCameraCoords();
-                if (LockPosShiftEnabled())
                 {
-                    GuideLog.NotifyLockShiftParams(m_lockPosShift, m_lockPosition.ShiftRate());
+                    // camera angle is now known, so ok to calculate shift rate camera coords
+                    wxCriticalSectionLocker lock(m_guideLock);
+                    UpdateLockPosShiftCameraCoords();
+                    if (LockPosShiftEnabled())
+                    {
+                        GuideLog.NotifyLockShiftParams(m_lockPosShift, m_lockPosition.ShiftRate());
+                    }
                 }
 
                 SetState(STATE_CALIBRATED);
                 // fall through
             case STATE_CALIBRATED:
                 assert(m_state == STATE_CALIBRATED);
-                SetState(STATE_GUIDING);
+                {
+                    // GuideStep reads the start time and the frame counter
+                    wxCriticalSectionLocker lock(m_guideLock);
+                    SetState(STATE_GUIDING);
+                    pFrame->m_guidingStarted = wxDateTime::UNow();
+                    pFrame->ResetFrameCounter();
+                }
                 pFrame->SetStatusText(_("Guiding..."), 1);
-                pFrame->m_guidingStarted = wxDateTime::UNow();
-                pFrame->m_frameCounter = 0;
                 GuideLog.StartGuiding();
                 EvtServer.NotifyStartGuiding();
                 break;
             case STATE_GUIDING:
-                if (m_ditherRecenterRemaining.IsValid())
-                {
-                    // fast recenter after dither taking large steps and bypassing
-                    // guide algorithms (normalMove=false)
-
-                    PHD_Point step(wxMin(m_ditherRecenterRemaining.X, m_ditherRecenterStep.X),
-                                   wxMin(m_ditherRecenterRemaining.Y, m_ditherRecenterStep.Y));
-
-                    Debug.AddLine(wxString::Format("dither recenter: remaining=(%.1f,%.1f) step=(%.1f,%.1f)",
-                        m_ditherRecenterRemaining.X * m_ditherRecenterDir.x,
-                        m_ditherRecenterRemaining.Y * m_ditherRecenterDir.y,
-                        step.X * m_ditherRecenterDir.x, step.Y * m_ditherRecenterDir.y));
-
-                    m_ditherRecenterRemaining -= step;
-                    if (m_ditherRecenterRemaining.X < 0.5 && m_ditherRecenterRemaining.Y < 0.5)
-                    {
-                        // fast recenter is done
-                        m_ditherRecenterRemaining.Invalidate();
-                        // reset distance tracker
-                        m_avgDistanceNeedReset = true;
-                    }
-
-                    PHD_Point mountCoords(step.X * m_ditherRecenterDir.x, step.Y * m_ditherRecenterDir.y);
-                    PHD_Point cameraCoords;
-                    pMount->TransformMountCoordinatesToCameraCoordinates(mountCoords, cameraCoords);
-                    pFrame->SchedulePrimaryMove(pMount, cameraCoords, false);
-                }
-                else
-                {
-                    // ordinary guide step
-                    s_deflectionLogger.Log(CurrentPosition());
-                    pFrame->SchedulePrimaryMove(pMount, CurrentPosition() - LockPosition());
-                }
+            {
+                wxCriticalSectionLocker lock(m_guideLock);
+                ScheduleGuideMove(pImage);
                 break;
+            }
 
             case STATE_UNINITIALIZED:
             case STATE_STOP:
@@ -1251,6 +1663,23 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
     pFrame->UpdateButtonsStatus();
 
+    // only the copy is made here; the image logger thread writes the file
+    unsigned int frameNumber = pFrame->FrameCounter();
+    if (m_state >= STATE_SELECTED && pFrame->IsImageLoggingEnabled() && frameNumber != pFrame->m_loggedImageFrame)
+    {
+        PHD_Point starPos;
+        PHD_Point lockPos;
+        {
+            wxCriticalSectionLocker lock(m_guideLock);
+            starPos = CurrentPosition();
+            lockPos = LockPosition();
+        }
+
+        // only log each image frame once
+        pFrame->m_loggedImageFrame = frameNumber;
+        pFrame->LogStarImage(*pImage, starPos, lockPos);
+    }
+
     UpdateImageDisplay(pImage);
 
     Debug.AddLine("UpdateGuideState exits: " + statusMessage);
@@ -1270,6 +1699,8 @@ void Guider::SetLockPosShiftRate(const PHD_Point& rate, GRAPH_UNITS units, bool
     Debug.AddLine("SetLockPosShiftRate: rate = %.2f,%.2f units = %d isMountCoords = %d",
                   rate.X, rate.Y, units, isMountCoords);
 
+    wxCriticalSectionLocker lock(m_guideLock);
+
     m_lockPosShift.shiftRate = rate;
     m_lockPosShift.shiftUnits = units;
     m_lockPosShift.shiftIsMountCoords = isMountCoords;
@@ -1288,6 +1719,8 @@ void Guider::SetLockPosShiftRate(const PHD_Point& rate, GRAPH_UNITS units, bool
 
 void Guider::EnableLockPosShift(bool enable)
 {
+    wxCriticalSectionLocker lock(m_guideLock);
+
     if (enable != m_lockPosShift.shiftEnabled)
     {
         Debug.AddLine("EnableLockPosShift: enable = %d", enable);
@@ -1296,13 +1729,20 @@ void Guider::EnableLockPosShift(bool enable)
         {
             m_lockPosition.BeginShift();
         }
-        if (m_state == STATE_CALIBRATED || m_state == STATE_GUIDING)
-        {
-            GuideLog.NotifyLockShiftParams(m_lockPosShift, m_lockPosition.ShiftRate());
-        }
+        LockPosShiftChanged();
+    }
+}
 
-        CometTool::UpdateCometToolControls();
+// tell the guide log and the comet tool that lock position shifting was
+// turned on or off
+void Guider::LockPosShiftChanged(void)
+{
+    if (m_state == STATE_CALIBRATED || m_state == STATE_GUIDING)
+    {
+        GuideLog.NotifyLockShiftParams(m_lockPosShift, m_lockPosition.ShiftRate());
     }
+
+    CometTool::UpdateCometToolControls();
 }
 
 void Guider::UpdateLockPosShiftCameraCoords(void)
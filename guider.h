@@ -121,6 +121,52 @@ struct LockPosShiftParams
 
 class DefectMap;
 
+/*
+ * Where to look for the guide star in the next frame. The main thread
+ * publishes the seed (MyFrame::PublishStarSeed) so the processing thread can
+ * measure the star without touching guider state.
+ */
+struct StarSeed
+{
+    bool valid;
+    double X;
+    double Y;
+    int searchRegion;
+    Star::FindMode findMode;
+
+    bool SameAs(const StarSeed& other) const
+    {
+        return valid && other.valid && X == other.X && Y == other.Y &&
+            searchRegion == other.searchRegion && findMode == other.findMode;
+    }
+};
+
+// result of a Star::Find made on the processing thread from a seed
+struct StarMeasurement
+{
+    StarSeed seed;
+    Star star;
+    bool found;
+};
+
+/*
+ * What a guide step leaves for the main thread: the processing thread runs
+ * Guider::GuideStep, and Guider::ShowGuideStep then updates the display, the
+ * status bar and the GUI side notifications from this.
+ */
+struct GuideStepResult
+{
+    bool done;                  // GuideStep handled the frame
+    bool starLost;              // the star was not found, info says why
+    bool resetAutoExposure;     // go back to the longest auto exposure duration
+    bool lockShifted;           // the lock position was shifted
+    bool lockShiftDisabled;     // the shifted lock position left the frame
+    FrameDroppedInfo info;      // info.status is the status bar message
+    PHD_Point starPos;          // star and lock position after the step
+    PHD_Point lockPos;
+    double starSNR;
+};
+
 /*
  * The Guider class is responsible for running the state machine
  * associated with the GUIDER_STATES enumerated type.
@@ -134,7 +180,60 @@ class Guider : public wxWindow
 {
     // Private member data.
 
+    // the inputs m_displayedImage was rendered from; a repaint with the same
+    // inputs reuses it
+    struct DisplayState
+    {
+        unsigned int imageGeneration;
+        int blevel;
+        int wlevel;
+        double gamma;
+        wxSize winSize;
+        bool scaleImage;
+
+        bool operator==(const DisplayState& rhs) const
+        {
+            return imageGeneration == rhs.imageGeneration && blevel == rhs.blevel && wlevel == rhs.wlevel &&
+                gamma == rhs.gamma && winSize == rhs.winSize && scaleImage == rhs.scaleImage;
+        }
+    };
+
+    // the overlays drawn by a paint; while they stay the same, a new subframe
+    // only needs the window area around it repainted
+    struct OverlayState
+    {
+        GUIDER_STATE state;
+        OVERLAY_MODE overlayMode;
+        bool lockValid;
+        double lockX;
+        double lockY;
+        bool showBookmarks;
+        size_t bookmarkCount;
+        const DefectMap *defectMap;
+        double polarAlignRadius;
+        double polarAlignCorrection;
+        double polarAlignX;
+        double polarAlignY;
+
+        bool operator==(const OverlayState& rhs) const
+        {
+            return state == rhs.state && overlayMode == rhs.overlayMode && lockValid == rhs.lockValid &&
+                lockX == rhs.lockX && lockY == rhs.lockY && showBookmarks == rhs.showBookmarks &&
+                bookmarkCount == rhs.bookmarkCount && defectMap == rhs.defectMap &&
+                polarAlignRadius == rhs.polarAlignRadius && polarAlignCorrection == rhs.polarAlignCorrection &&
+                polarAlignX == rhs.polarAlignX && polarAlignY == rhs.polarAlignY;
+        }
+    };
+
     wxImage *m_displayedImage;
+    StretchLUT m_stretchLUT;
+    unsigned int m_imageGeneration;     // incremented when m_pCurrentImage is replaced
+    DisplayState m_displayState;
+    bool m_displayValid;
+    wxBitmap m_displayBitmap;           // backbuffer holding m_displayedImage at window size
+    wxSize m_displayedImageSize;        // full size of the image m_displayedImage was rendered from
+    wxRect m_displayedSubframe;         // and its subframe, empty for a full frame
+    OverlayState m_overlayState;        // overlays drawn by the last paint
     OVERLAY_MODE m_overlayMode;
     OverlaySlitCoords m_overlaySlitCoords;
     const DefectMap *m_defectMapPreview;
@@ -157,6 +256,11 @@ class Guider : public wxWindow
     LockPosShiftParams m_lockPosShift;
 
 protected:
+    // Held while the guide state (state, pause, lock position and shift, dither
+    // recenter, the current star and image) is changed, and by the main thread
+    // when it reads more than one of them. The processing thread takes it for
+    // GuideStep, so the main thread must not hold it across anything slow.
+    wxCriticalSection m_guideLock;
     bool m_forceFullFrame;
     double m_scaleFactor;
     bool m_showBookmarks;
@@ -188,8 +292,15 @@ protected:
     virtual ~Guider(void);
 
     bool PaintHelper(wxClientDC &dc, wxMemoryDC &memDC);
+    bool CanUpdateDisplayIncrementally(const usImage *pImage, wxRect *dirty);
+    wxRect DisplayedRect(const wxRect& imageRect) const;
+    OverlayState CurrentOverlayState(void);
     void SetState(GUIDER_STATE newState);
     void UpdateCurrentDistance(double distance);
+    void ScheduleGuideMove(usImage *pImage);
+    void ShowStarUpdate(usImage *pImage, const GuideStepResult& step);
+    void NotifyGuidingFrameDropped(const FrameDroppedInfo& info);
+    void LockPosShiftChanged(void);
 
     void ToggleBookmark(const wxRealPoint& pt);
 
@@ -229,7 +340,9 @@ public:
 
     void StartGuiding(void);
     void StopGuiding(void);
-    void UpdateGuideState(usImage *pImage, bool bStopping=false);
+    void UpdateGuideState(usImage *pImage, bool bStopping=false, const StarMeasurement *measurement=NULL);
+    bool GuideStep(usImage *pImage, const StarMeasurement *measurement, GuideStepResult *result);
+    void ShowGuideStep(usImage *pImage, const GuideStepResult& step);
 
     bool SetScaleImage(bool newScaleValue);
     bool GetScaleImage(void);
@@ -258,7 +371,7 @@ public:
     virtual bool IsValidLockPosition(const PHD_Point& pt) = 0;
 private:
     virtual void InvalidateCurrentPosition(bool fullReset = false) = 0;
-    virtual bool UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *errorInfo) = 0;
+    virtual bool UpdateCurrentPosition(usImage *pImage, GuideStepResult *result, const StarMeasurement *measurement) = 0;
     virtual bool SetCurrentPosition(usImage *pImage, const PHD_Point& position) = 0;
 
 public:
@@ -268,6 +381,7 @@ public:
     virtual bool AutoSelect(void) = 0;
 
     virtual const PHD_Point& CurrentPosition(void) = 0;
+    virtual StarSeed GetStarSeed(void) = 0;
     virtual wxRect GetBoundingBox(void) = 0;
     virtual int GetMaxMovePixels(void) = 0;
     virtual double StarMass(void) = 0;
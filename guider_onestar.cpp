@@ -426,6 +426,20 @@ const PHD_Point& GuiderOneStar::CurrentPosition(void)
     return m_star;
 }
 
+StarSeed GuiderOneStar::GetStarSeed(void)
+{
+    wxCriticalSectionLocker lock(m_guideLock);
+
+    StarSeed seed;
+    // same test UpdateCurrentPosition uses for "no star selected"
+    seed.valid = m_star.IsValid() || m_star.X != 0.0 || m_star.Y != 0.0;
+    seed.X = m_star.X;
+    seed.Y = m_star.Y;
+    seed.searchRegion = m_searchRegion;
+    seed.findMode = pFrame->GetStarFindMode();
+    return seed;
+}
+
 inline static wxRect SubframeRect(const PHD_Point& pos, int halfwidth)
 {
     return wxRect(ROUND(pos.X - halfwidth),
@@ -438,6 +452,8 @@ wxRect GuiderOneStar::GetBoundingBox(void)
 {
     enum { SUBFRAME_BOUNDARY_PX = 0 };
 
+    wxCriticalSectionLocker lock(m_guideLock);
+
     GUIDER_STATE state = GetState();
 
     bool subframe;
@@ -527,8 +543,13 @@ static wxString StarStatusStr(const Star& star)
     }
 }
 
-bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *errorInfo)
+bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, GuideStepResult *result, const StarMeasurement *measurement)
 {
+    FrameDroppedInfo *errorInfo = &result->info;
+
+    result->resetAutoExposure = false;
+    result->starSNR = 0.0;
+
     if (!m_star.IsValid() && m_star.X == 0.0 && m_star.Y == 0.0)
     {
         Debug.AddLine("UpdateCurrentPosition: no star selected");
@@ -544,8 +565,24 @@ bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *err
     try
     {
         Star newStar(m_star);
+        bool found;
 
-        if (!newStar.Find(pImage, m_searchRegion, pFrame->GetStarFindMode()))
+        // use the processing thread's measurement if it was seeded from the
+        // star we are tracking now; otherwise the selection or settings changed
+        // while the frame was in flight and we have to measure it again here
+        if (measurement && measurement->seed.SameAs(GetStarSeed()))
+        {
+            newStar = measurement->star;
+            found = measurement->found;
+        }
+        else
+        {
+            if (measurement && measurement->seed.valid)
+                Debug.AddLine("UpdateCurrentPosition: star seed changed, re-measuring");
+            found = newStar.Find(pImage, m_searchRegion, pFrame->GetStarFindMode());
+        }
+
+        if (!found)
         {
             errorInfo->starError = newStar.GetError();
             errorInfo->starMass = 0.0;
@@ -585,9 +622,9 @@ bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *err
             UpdateCurrentDistance(distance);
         }
 
-        pFrame->pProfile->UpdateData(pImage, m_star.X, m_star.Y);
-
-        pFrame->AdjustAutoExposure(m_star.SNR);
+        // the profile and auto exposure are updated by the main thread
+        result->starPos = CurrentPosition();
+        result->starSNR = m_star.SNR;
 
         errorInfo->status.Printf(_T("m=%.0f SNR=%.1f"), m_star.Mass, m_star.SNR);
     }
@@ -595,7 +632,7 @@ bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *err
     {
         POSSIBLY_UNUSED(Msg);
         bError = true;
-        pFrame->ResetAutoExposure(); // use max exposure duration
+        result->resetAutoExposure = true; // use max exposure duration
     }
 
     return bError;
@@ -702,6 +739,18 @@ void GuiderOneStar::OnPaint(wxPaintEvent& event)
     wxClientDC dc(this);
     wxMemoryDC memDC;
 
+    // the processing thread moves the star while guiding; take a copy so the
+    // guide step does not wait for the repaint
+    GUIDER_STATE state;
+    Star star;
+    int searchRegion;
+    {
+        wxCriticalSectionLocker lock(m_guideLock);
+        state = GetState();
+        star = m_star;
+        searchRegion = m_searchRegion;
+    }
+
     try
     {
         if (PaintHelper(dc, memDC))
@@ -727,8 +776,7 @@ void GuiderOneStar::OnPaint(wxPaintEvent& event)
             }
         }
 
-        GUIDER_STATE state = GetState();
-        bool FoundStar = m_star.WasFound();
+        bool FoundStar = star.WasFound();
 
         if (state == STATE_SELECTED)
         {
@@ -736,13 +784,13 @@ void GuiderOneStar::OnPaint(wxPaintEvent& event)
                 dc.SetPen(wxPen(wxColour(100,255,90), 1, wxSOLID));  // Draw the box around the star
             else
                 dc.SetPen(wxPen(wxColour(230,130,30), 1, wxDOT));
-            DrawBox(dc, m_star, m_searchRegion, m_scaleFactor);
+            DrawBox(dc, star, searchRegion, m_scaleFactor);
         }
         else if (state == STATE_CALIBRATING_PRIMARY || state == STATE_CALIBRATING_SECONDARY)
         {
             // in the calibration process
             dc.SetPen(wxPen(wxColour(32,196,32), 1, wxSOLID));  // Draw the box around the star
-            DrawBox(dc, m_star, m_searchRegion, m_scaleFactor);
+            DrawBox(dc, star, searchRegion, m_scaleFactor);
         }
         else if (state == STATE_CALIBRATED || state == STATE_GUIDING)
         {
@@ -751,48 +799,7 @@ void GuiderOneStar::OnPaint(wxPaintEvent& event)
                 dc.SetPen(wxPen(wxColour(32,196,32), 1, wxSOLID));  // Draw the box around the star
             else
                 dc.SetPen(wxPen(wxColour(230,130,30), 1, wxDOT));
-            DrawBox(dc, m_star, m_searchRegion, m_scaleFactor);
-        }
-
-        // Image logging
-        if (state >= STATE_SELECTED && pFrame->IsImageLoggingEnabled() && pFrame->m_frameCounter != pFrame->m_loggedImageFrame)
-        {
-            // only log each image frame once
-            pFrame->m_loggedImageFrame = pFrame->m_frameCounter;
-
-            if (pFrame->GetLoggedImageFormat() == LIF_RAW_FITS) // Save star image as a FITS
-            {
-                SaveStarFITS();
-            }
-            else  // Save star image as a JPEG
-            {
-                double LockX = LockPosition().X;
-                double LockY = LockPosition().Y;
-
-                wxBitmap SubBmp(60,60,-1);
-                wxMemoryDC tmpMdc;
-                tmpMdc.SelectObject(SubBmp);
-                memDC.SetPen(wxPen(wxColor(0,255,0),1,wxDOT));
-                memDC.DrawLine(0, LockY * m_scaleFactor, XWinSize, LockY * m_scaleFactor);
-                memDC.DrawLine(LockX*m_scaleFactor, 0, LockX*m_scaleFactor, YWinSize);
-    #ifdef __APPLEX__
-                tmpMdc.Blit(0,0,60,60,&memDC,ROUND(m_star.X*m_scaleFactor)-30,Displayed_Image->GetHeight() - ROUND(m_star.Y*m_scaleFactor)-30,wxCOPY,false);
-    #else
-                tmpMdc.Blit(0,0,60,60,&memDC,ROUND(m_star.X*m_scaleFactor)-30,ROUND(m_star.Y*m_scaleFactor)-30,wxCOPY,false);
-    #endif
-                //          tmpMdc.Blit(0,0,200,200,&Cdc,0,0,wxCOPY);
-
-                wxString fname = Debug.GetLogDir() + PATHSEPSTR + "PHD_GuideStar" + wxDateTime::Now().Format(_T("_%j_%H%M%S")) + ".jpg";
-                wxImage subImg = SubBmp.ConvertToImage();
-                // subImg.Rescale(120, 120);  zoom up (not now)
-                if (pFrame->GetLoggedImageFormat() == LIF_HI_Q_JPEG)
-                {
-                    // set high(ish) JPEG quality
-                    subImg.SetOption(wxIMAGE_OPTION_QUALITY, 100);
-                }
-                subImg.SaveFile(fname, wxBITMAP_TYPE_JPEG);
-                tmpMdc.SelectObject(wxNullBitmap);
-            }
+            DrawBox(dc, star, searchRegion, m_scaleFactor);
         }
     }
     catch (wxString Msg)
@@ -801,88 +808,6 @@ void GuiderOneStar::OnPaint(wxPaintEvent& event)
     }
 }
 
-void GuiderOneStar::SaveStarFITS()
-{
-    double StarX = m_star.X;
-    double StarY = m_star.Y;
-    usImage *pImage = CurrentImage();
-    usImage tmpimg;
-
-    tmpimg.Init(60,60);
-    int start_x = ROUND(StarX)-30;
-    int start_y = ROUND(StarY)-30;
-    if ((start_x + 60) > pImage->Size.GetWidth())
-        start_x = pImage->Size.GetWidth() - 60;
-    if ((start_y + 60) > pImage->Size.GetHeight())
-        start_y = pImage->Size.GetHeight() - 60;
-    int x,y, width;
-    width = pImage->Size.GetWidth();
-    unsigned short *usptr = tmpimg.ImageData;
-    for (y=0; y<60; y++)
-        for (x=0; x<60; x++, usptr++)
-            *usptr = *(pImage->ImageData + (y+start_y)*width + (x+start_x));
-
-    wxString fname = Debug.GetLogDir() + PATHSEPSTR + "PHD_GuideStar" + wxDateTime::Now().Format(_T("_%j_%H%M%S")) + ".fit";
-
-    fitsfile *fptr;  // FITS file pointer
-    int status = 0;  // CFITSIO status value MUST be initialized to zero!
-    long fpixel[3] = {1,1,1};
-    long fsize[3];
-    char keyname[9]; // was 9
-    char keycomment[100];
-    char keystring[100];
-    int output_format=USHORT_IMG;
-
-    fsize[0] = 60;
-    fsize[1] = 60;
-    fsize[2] = 0;
-    PHD_fits_create_file(&fptr, fname, false, &status);
-    if (!status)
-    {
-        fits_create_img(fptr,output_format, 2, fsize, &status);
-
-        time_t now;
-        struct tm *timestruct;
-        time(&now);
-        timestruct=gmtime(&now);
-        sprintf(keyname,"DATE");
-        sprintf(keycomment,"UTC date that FITS file was created");
-        sprintf(keystring,"%.4d-%.2d-%.2d %.2d:%.2d:%.2d",timestruct->tm_year+1900,timestruct->tm_mon+1,timestruct->tm_mday,timestruct->tm_hour,timestruct->tm_min,timestruct->tm_sec);
-        if (!status) fits_write_key(fptr, TSTRING, keyname, keystring, keycomment, &status);
-
-        sprintf(keyname,"DATE-OBS");
-        sprintf(keycomment,"YYYY-MM-DDThh:mm:ss observation start, UT");
-        sprintf(keystring,"%s", (const char *) pImage->GetImgStartTime().c_str());
-        if (!status) fits_write_key(fptr, TSTRING, keyname, keystring, keycomment, &status);
-
-        sprintf(keyname,"EXPOSURE");
-        sprintf(keycomment,"Exposure time [s]");
-        float dur = (float) pImage->ImgExpDur / 1000.0;
-        if (!status) fits_write_key(fptr, TFLOAT, keyname, &dur, keycomment, &status);
-
-        unsigned int tmp = 1;
-        sprintf(keyname,"XBINNING");
-        sprintf(keycomment,"Camera binning mode");
-        fits_write_key(fptr, TUINT, keyname, &tmp, keycomment, &status);
-        sprintf(keyname,"YBINNING");
-        sprintf(keycomment,"Camera binning mode");
-        fits_write_key(fptr, TUINT, keyname, &tmp, keycomment, &status);
-
-        sprintf(keyname,"XORGSUB");
-        sprintf(keycomment,"Subframe x position in binned pixels");
-        tmp = start_x;
-        fits_write_key(fptr, TINT, keyname, &tmp, keycomment, &status);
-        sprintf(keyname,"YORGSUB");
-        sprintf(keycomment,"Subframe y position in binned pixels");
-        tmp = start_y;
-        fits_write_key(fptr, TINT, keyname, &tmp, keycomment, &status);
-
-        if (!status) fits_write_pix(fptr,TUSHORT,fpixel,tmpimg.NPixels,tmpimg.ImageData,&status);
-
-    }
-    PHD_fits_close_file(fptr);
-}
-
 wxString GuiderOneStar::GetSettingsSummary()
 {
     // return a loggable summary of guider configs
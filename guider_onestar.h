@@ -89,6 +89,7 @@ public:
     virtual bool IsLocked(void);
     virtual bool AutoSelect(void);
     virtual const PHD_Point& CurrentPosition(void);
+    virtual StarSeed GetStarSeed(void);
     virtual wxRect GetBoundingBox(void);
     virtual int GetMaxMovePixels(void);
     virtual double StarMass(void);
@@ -103,13 +104,11 @@ public:
 private:
     virtual bool IsValidLockPosition(const PHD_Point& pt);
     virtual void InvalidateCurrentPosition(bool fullReset = false);
-    virtual bool UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *errorInfo);
+    virtual bool UpdateCurrentPosition(usImage *pImage, GuideStepResult *result, const StarMeasurement *measurement);
     virtual bool SetCurrentPosition(usImage *pImage, const PHD_Point& position);
 
     void OnLClick(wxMouseEvent& evt);
 
-    void SaveStarFITS();
-
     DECLARE_EVENT_TABLE()
 };
 
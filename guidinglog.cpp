@@ -37,10 +37,24 @@
 
 #define GUIDELOG_VERSION _T("2.5")
 
+static const bool DefaultBinaryFormat = false;
+
+class GuideLogFlushTimer : public wxTimer
+{
+public:
+    void Notify()
+    {
+        GuideLog.TimedFlush();
+    }
+};
+
 GuidingLog::GuidingLog(void)
     : m_enabled(false),
     m_keepFile(false),
-    m_isGuiding(false)
+    m_isGuiding(false),
+    m_binary(false),
+    m_lastFlushMs(0),
+    m_flushTimer(0)
 {
 }
 
@@ -48,6 +62,89 @@ GuidingLog::~GuidingLog(void)
 {
 }
 
+void GuidingLog::SetBinaryFormat(bool binary)
+{
+    pConfig->Global.SetBoolean("/GuideLogBinary", binary);
+}
+
+bool GuidingLog::GetBinaryFormat(void) const
+{
+    return pConfig->Global.GetBoolean("/GuideLogBinary", DefaultBinaryFormat);
+}
+
+void GuidingLog::Write(const wxString& str)
+{
+    WriteUTF8(std::string(str.mb_str(wxConvUTF8)));
+}
+
+void GuidingLog::WriteUTF8(const std::string& str)
+{
+    wxCriticalSectionLocker lock(m_lock);
+
+    if (m_binary)
+        GuideLogEncodeText(m_buffer, GLREC_TEXT, str);
+    else
+        m_file.Write(str.data(), str.size());
+}
+
+template<typename T>
+void GuidingLog::WriteRecord(const T& rec)
+{
+    if (m_binary)
+    {
+        wxCriticalSectionLocker lock(m_lock);
+        GuideLogEncode(m_buffer, rec);
+    }
+    else
+        WriteUTF8(GuideLogFormat(rec));
+}
+
+// Flush per-frame records. The text log is flushed every time, the binary
+// log only when enough has been buffered or FLUSH_INTERVAL_MS has elapsed.
+void GuidingLog::FlushIfDue(void)
+{
+    wxCriticalSectionLocker lock(m_lock);
+
+    if (m_binary && m_buffer.Size() < FLUSH_BUFFER_SIZE &&
+        wxGetUTCTimeMillis() - m_lastFlushMs < FLUSH_INTERVAL_MS)
+    {
+        return;
+    }
+
+    Flush();
+}
+
+// called by m_flushTimer on the main thread
+void GuidingLog::TimedFlush(void)
+{
+    wxCriticalSectionLocker lock(m_lock);
+
+    if (m_enabled && m_buffer.Size() &&
+        wxGetUTCTimeMillis() - m_lastFlushMs >= FLUSH_INTERVAL_MS)
+    {
+        Flush();
+    }
+}
+
+void GuidingLog::StartFlushTimer(void)
+{
+    if (!m_binary)
+        return;
+
+    if (!m_flushTimer)
+        m_flushTimer = new GuideLogFlushTimer();
+
+    // poll several times per interval so a pending record is never held
+    // much longer than FLUSH_INTERVAL_MS
+    m_flushTimer->Start(FLUSH_INTERVAL_MS / 4);
+}
+
+void GuidingLog::StopFlushTimer(void)
+{
+    delete m_flushTimer;
+    m_flushTimer = 0;
+}
+
 bool GuidingLog::EnableLogging(void)
 {
     if (m_enabled)
@@ -60,23 +157,30 @@ bool GuidingLog::EnableLogging(void)
         wxDateTime now = wxDateTime::Now();
         if (!m_file.IsOpened())
         {
+            m_binary = GetBinaryFormat();
+
             m_fileName = GetLogDir() + PATHSEPSTR + "PHD2_GuideLog" + now.Format(_T("_%Y-%m-%d")) +
-                now.Format(_T("_%H%M%S")) + ".txt";
+                now.Format(_T("_%H%M%S")) + (m_binary ? ".bin" : ".txt");
 
-            if (!m_file.Open(m_fileName, "w"))
+            if (!m_file.Open(m_fileName, m_binary ? "wb" : "w"))
             {
                 throw ERROR_INFO("unable to open file");
             }
             m_keepFile = false;             // Don't keep it until something meaningful is logged
+
+            m_buffer.Clear();
+            if (m_binary)
+                m_buffer.PutFileHeader();
         }
 
         assert(m_file.IsOpened());
 
-        m_file.Write(_T("PHD2 version ") FULLVER _T(", Log version ") GUIDELOG_VERSION _T(". Log enabled at ") +
+        Write(_T("PHD2 version ") FULLVER _T(", Log version ") GUIDELOG_VERSION _T(". Log enabled at ") +
             now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
         Flush();
 
         m_enabled = true;
+        StartFlushTimer();
 
         // persist state
         pConfig->Global.SetBoolean("/LoggingMode", m_enabled);
@@ -111,8 +215,9 @@ void GuidingLog::DisableLogging(void)
     assert(m_file.IsOpened());
     wxDateTime now = wxDateTime::Now();
 
-    m_file.Write("\n");
-    m_file.Write("Log disabled at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    Write("\n");
+    Write("Log disabled at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    StopFlushTimer();
     Flush();
     m_enabled = false;
 
@@ -147,12 +252,26 @@ bool GuidingLog::Flush(void)
     if (!m_enabled)
         return false;
 
+    wxCriticalSectionLocker lock(m_lock);
     bool bError = false;
 
     try
     {
         assert(m_file.IsOpened());
 
+        if (m_buffer.Size())
+        {
+            size_t size = m_buffer.Size();
+            size_t written = m_file.Write(m_buffer.Data(), size);
+            m_buffer.Clear();
+            if (written != size)
+            {
+                throw ERROR_INFO("unable to write file");
+            }
+        }
+
+        m_lastFlushMs = wxGetUTCTimeMillis();
+
         if (!m_file.Flush())
         {
             throw ERROR_INFO("unable to flush file");
@@ -175,8 +294,11 @@ void GuidingLog::Close(void)
     assert(m_file.IsOpened());
     wxDateTime now = wxDateTime::Now();
 
-    m_file.Write("\n");
-    m_file.Write("Log closed at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    Write("\n");
+    Write("Log closed at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    StopFlushTimer();
+
+    wxCriticalSectionLocker lock(m_lock);
     Flush();
     m_file.Close();
     m_enabled = false;
@@ -237,34 +359,34 @@ void GuidingLog::StartCalibration(Mount *pCalibrationMount)
     assert(m_file.IsOpened());
     wxDateTime now = wxDateTime::Now();
 
-    m_file.Write("\n");
-    m_file.Write("Calibration Begins at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
-    m_file.Write("Equipment Profile = " + pConfig->GetCurrentProfile() + "\n");
+    Write("\n");
+    Write("Calibration Begins at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    Write("Equipment Profile = " + pConfig->GetCurrentProfile() + "\n");
 
     assert(pCalibrationMount && pCalibrationMount->IsConnected());
 
     if (pCamera)
     {
         // phdlab v0.5.3 expects camera name on a line by itself
-        m_file.Write(wxString::Format("Camera = %s\nExposure = %s\n",
+        Write(wxString::Format("Camera = %s\nExposure = %s\n",
             pCamera->Name, pFrame->ExposureDurationSummary()));
     }
-    m_file.Write(pFrame->PixelScaleSummary() + "\n");
+    Write(pFrame->PixelScaleSummary() + "\n");
 
-    m_file.Write("Mount = " + pCalibrationMount->Name());
+    Write("Mount = " + pCalibrationMount->Name());
     wxString calSettings = pCalibrationMount->CalibrationSettingsSummary();
     if (!calSettings.IsEmpty())
-        m_file.Write(", " + calSettings);
-    m_file.Write("\n");
+        Write(", " + calSettings);
+    Write("\n");
 
-    m_file.Write(wxString::Format("%s\n", PointingInfo()));
+    Write(wxString::Format("%s\n", PointingInfo()));
 
-    m_file.Write(wxString::Format("Lock position = %.3f, %.3f, Star position = %.3f, %.3f\n",
+    Write(wxString::Format("Lock position = %.3f, %.3f, Star position = %.3f, %.3f\n",
                 pFrame->pGuider->LockPosition().X,
                 pFrame->pGuider->LockPosition().Y,
                 pFrame->pGuider->CurrentPosition().X,
                 pFrame->pGuider->CurrentPosition().Y));
-    m_file.Write("Direction,Step,dx,dy,x,y,Dist\n");
+    Write("Direction,Step,dx,dy,x,y,Dist\n");
     Flush();
 
     m_keepFile = true;
@@ -278,7 +400,7 @@ void GuidingLog::CalibrationFailed(Mount *pCalibrationMount, const wxString& msg
         return;
 
     assert(m_file.IsOpened());
-    m_file.Write(msg); m_file.Write("\n");
+    Write(msg); Write("\n");
     Flush();
 }
 
@@ -289,14 +411,16 @@ void GuidingLog::CalibrationStep(Mount *pCalibrationMount, const wxString& direc
         return;
 
     assert(m_file.IsOpened());
-    // Direction,Step,dx,dy,x,y,Dist
-    m_file.Write(wxString::Format("%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n",
-        direction,
-        steps,
-        dx, dy,
-        xy.X, xy.Y,
-        dist));
-    Flush();
+    GuideLogCalStepRecord rec;
+    rec.direction = std::string(direction.mb_str(wxConvUTF8));
+    rec.steps = steps;
+    rec.dx = dx;
+    rec.dy = dy;
+    rec.x = xy.X;
+    rec.y = xy.Y;
+    rec.dist = dist;
+    WriteRecord(rec);
+    FlushIfDue();
 }
 
 void GuidingLog::CalibrationDirectComplete(Mount *pCalibrationMount, const wxString& direction, double angle, double rate)
@@ -305,8 +429,11 @@ void GuidingLog::CalibrationDirectComplete(Mount *pCalibrationMount, const wxStr
         return;
 
     assert(m_file.IsOpened());
-    m_file.Write(wxString::Format("%s calibration complete. Angle = %.1f deg, Rate = %.3f\n",
-        direction, degrees(angle), rate * 1000.0));
+    GuideLogCalDirectionRecord rec;
+    rec.direction = std::string(direction.mb_str(wxConvUTF8));
+    rec.angleDegrees = degrees(angle);
+    rec.rate = rate * 1000.0;
+    WriteRecord(rec);
     Flush();
 }
 
@@ -318,7 +445,7 @@ void GuidingLog::CalibrationComplete(Mount *pCalibrationMount)
         return;
 
     assert(m_file.IsOpened());
-    m_file.Write(wxString::Format("Calibration complete, mount = %s.\n", pCalibrationMount->Name()));
+    Write(wxString::Format("Calibration complete, mount = %s.\n", pCalibrationMount->Name()));
     Flush();
 }
 
@@ -331,8 +458,8 @@ void GuidingLog::StartGuiding()
 
     assert(m_file.IsOpened());
 
-    m_file.Write("\n");
-    m_file.Write("Guiding Begins at " + pFrame->m_guidingStarted.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    Write("\n");
+    Write("Guiding Begins at " + pFrame->m_guidingStarted.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
     m_keepFile = true;
 
     // add common guiding header
@@ -347,38 +474,39 @@ void GuidingLog::StopGuiding(void)
         return;
 
     assert(m_file.IsOpened());
-    m_file.Write("Guiding Ends at " + wxDateTime::Now().Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    Write("Guiding Ends at " + wxDateTime::Now().Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    Flush();
 }
 
 void GuidingLog::GuidingHeader(void)
     // output guiding header to log file
 {
-    m_file.Write(pFrame->GetSettingsSummary());
-    m_file.Write(pFrame->pGuider->GetSettingsSummary());
+    Write(pFrame->GetSettingsSummary());
+    Write(pFrame->pGuider->GetSettingsSummary());
 
-    m_file.Write("Equipment Profile = " + pConfig->GetCurrentProfile() + "\n");
+    Write("Equipment Profile = " + pConfig->GetCurrentProfile() + "\n");
 
     if (pCamera)
     {
-        m_file.Write(pCamera->GetSettingsSummary());
-        m_file.Write("Exposure = " + pFrame->ExposureDurationSummary() + "\n");
+        Write(pCamera->GetSettingsSummary());
+        Write("Exposure = " + pFrame->ExposureDurationSummary() + "\n");
     }
 
     if (pMount)
-        m_file.Write(pMount->GetSettingsSummary());
+        Write(pMount->GetSettingsSummary());
 
     if (pSecondaryMount)
-        m_file.Write(pSecondaryMount->GetSettingsSummary());
+        Write(pSecondaryMount->GetSettingsSummary());
 
-    m_file.Write(wxString::Format("%s\n", PointingInfo()));
+    Write(wxString::Format("%s\n", PointingInfo()));
 
-    m_file.Write(wxString::Format("Lock position = %.3f, %.3f, Star position = %.3f, %.3f\n",
+    Write(wxString::Format("Lock position = %.3f, %.3f, Star position = %.3f, %.3f\n",
                 pFrame->pGuider->LockPosition().X,
                 pFrame->pGuider->LockPosition().Y,
                 pFrame->pGuider->CurrentPosition().X,
                 pFrame->pGuider->CurrentPosition().Y));
 
-    m_file.Write("Frame,Time,mount,dx,dy,RARawDistance,DECRawDistance,RAGuideDistance,DECGuideDistance,RADuration,RADirection,DECDuration,DECDirection,XStep,YStep,StarMass,SNR,ErrorCode\n");
+    Write("Frame,Time,mount,dx,dy,RARawDistance,DECRawDistance,RAGuideDistance,DECGuideDistance,RADuration,RADirection,DECDuration,DECDirection,XStep,YStep,StarMass,SNR,ErrorCode\n");
 
     Flush();
 }
@@ -390,30 +518,40 @@ void GuidingLog::GuideStep(const GuideStepInfo& step)
 
     assert(m_file.IsOpened());
 
-    m_file.Write(wxString::Format("%d,%.3f,\"%s\",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,",
-        step.frameNumber, step.time,
-        step.mount->IsStepGuider() ? "AO" : "Mount",
-        step.cameraOffset->X, step.cameraOffset->Y,
-        step.mountOffset->X, step.mountOffset->Y,
-        step.guideDistanceRA, step.guideDistanceDec));
-
-    if (step.mount->IsStepGuider())
+    GuideLogStepRecord rec;
+    rec.frameNumber = step.frameNumber;
+    rec.time = step.time;
+    rec.ao = step.mount->IsStepGuider();
+    rec.dx = step.cameraOffset->X;
+    rec.dy = step.cameraOffset->Y;
+    rec.raRaw = step.mountOffset->X;
+    rec.decRaw = step.mountOffset->Y;
+    rec.raGuide = step.guideDistanceRA;
+    rec.decGuide = step.guideDistanceDec;
+    memset(rec.raDirection, 0, sizeof(rec.raDirection));
+    memset(rec.decDirection, 0, sizeof(rec.decDirection));
+
+    if (rec.ao)
     {
-        int xSteps = step.directionRA == LEFT ? -step.durationRA : step.durationRA;
-        int ySteps = step.directionDec == DOWN ? -step.durationDec : step.durationDec;
-        m_file.Write(wxString::Format(",,,,%d,%d,", xSteps, ySteps));
+        rec.raDuration = step.directionRA == LEFT ? -step.durationRA : step.durationRA;
+        rec.decDuration = step.directionDec == DOWN ? -step.durationDec : step.durationDec;
     }
     else
     {
-        m_file.Write(wxString::Format("%d,%s,%d,%s,,,",
-            step.durationRA, step.durationRA > 0 ? step.mount->DirectionChar((GUIDE_DIRECTION)step.directionRA) : "",
-            step.durationDec, step.durationDec > 0 ? step.mount->DirectionChar((GUIDE_DIRECTION)step.directionDec): ""));
+        rec.raDuration = step.durationRA;
+        rec.decDuration = step.durationDec;
+        if (step.durationRA > 0)
+            strncpy(rec.raDirection, step.mount->DirectionChar((GUIDE_DIRECTION)step.directionRA), sizeof(rec.raDirection) - 1);
+        if (step.durationDec > 0)
+            strncpy(rec.decDirection, step.mount->DirectionChar((GUIDE_DIRECTION)step.directionDec), sizeof(rec.decDirection) - 1);
     }
 
-    m_file.Write(wxString::Format("%.f,%.2f,%d\n",
-            step.starMass, step.starSNR, step.starError));
+    rec.starMass = step.starMass;
+    rec.snr = step.starSNR;
+    rec.errorCode = step.starError;
 
-    Flush();
+    WriteRecord(rec);
+    FlushIfDue();
 }
 
 void GuidingLog::FrameDropped(const FrameDroppedInfo& info)
@@ -423,10 +561,15 @@ void GuidingLog::FrameDropped(const FrameDroppedInfo& info)
 
     assert(m_file.IsOpened());
 
-    m_file.Write(wxString::Format("%d,%.3f,\"DROP\",,,,,,,,,,,,,%.f,%.2f,%d,\"%s\"\n",
-        info.frameNumber, info.time, info.starMass, info.starSNR, info.starError, info.status));
-
-    Flush();
+    GuideLogDropRecord rec;
+    rec.frameNumber = info.frameNumber;
+    rec.time = info.time;
+    rec.starMass = info.starMass;
+    rec.snr = info.starSNR;
+    rec.errorCode = info.starError;
+    rec.status = std::string(info.status.mb_str(wxConvUTF8));
+    WriteRecord(rec);
+    FlushIfDue();
 }
 
 void GuidingLog::NotifyGuidingDithered(Guider *guider, double dx, double dy)
@@ -434,15 +577,29 @@ void GuidingLog::NotifyGuidingDithered(Guider *guider, double dx, double dy)
     if (!m_enabled || !m_isGuiding)
         return;
 
-    m_file.Write(wxString::Format("INFO: DITHER by %.3f, %.3f, new lock pos = %.3f, %.3f\n",
-        dx, dy, guider->LockPosition().X, guider->LockPosition().Y));
-    Flush();
+    GuideLogDitherRecord rec;
+    rec.dx = dx;
+    rec.dy = dy;
+    rec.lockX = guider->LockPosition().X;
+    rec.lockY = guider->LockPosition().Y;
+    WriteRecord(rec);
+    FlushIfDue();
 }
 
 void GuidingLog::NotifySettlingStateChange(const wxString& msg)
 {
-    m_file.Write(wxString::Format("INFO: SETTLING STATE CHANGE, %s\n", msg));
-    Flush();
+    if (!m_enabled)
+        return;
+
+    std::string str(msg.mb_str(wxConvUTF8));
+    if (m_binary)
+    {
+        wxCriticalSectionLocker lock(m_lock);
+        GuideLogEncodeText(m_buffer, GLREC_SETTLING, str);
+    }
+    else
+        WriteUTF8(GuideLogFormatSettling(str));
+    FlushIfDue();
 }
 
 void GuidingLog::NotifySetLockPosition(Guider *guider)
@@ -450,10 +607,12 @@ void GuidingLog::NotifySetLockPosition(Guider *guider)
     if (!m_enabled || !m_isGuiding)
         return;
 
-    m_file.Write(wxString::Format("INFO: SET LOCK POSITION, new lock pos = %.3f, %.3f\n",
-        guider->LockPosition().X, guider->LockPosition().Y));
+    GuideLogLockPosRecord rec;
+    rec.lockX = guider->LockPosition().X;
+    rec.lockY = guider->LockPosition().Y;
+    WriteRecord(rec);
     m_keepFile = true;
-    Flush();
+    FlushIfDue();
 }
 
 void GuidingLog::NotifyLockShiftParams(const LockPosShiftParams& shiftParams, const PHD_Point& cameraRate)
@@ -461,20 +620,17 @@ void GuidingLog::NotifyLockShiftParams(const LockPosShiftParams& shiftParams, co
     if (!m_enabled || !m_isGuiding)
         return;
 
-    wxString details;
-    if (shiftParams.shiftEnabled)
-    {
-        details = wxString::Format("%s rate (%.2f,%.2f) %s/hr (%.2f,%.2f) px/hr",
-                                    shiftParams.shiftIsMountCoords ? "RA,Dec" : "X,Y",
-                                    shiftParams.shiftRate.IsValid() ? shiftParams.shiftRate.X : 0.0,
-                                    shiftParams.shiftRate.IsValid() ? shiftParams.shiftRate.Y : 0.0,
-                                    shiftParams.shiftUnits == UNIT_ARCSEC ? "arc-sec" : "pixels",
-                                    cameraRate.IsValid() ? cameraRate.X * 3600.0 : 0.0,
-                                    cameraRate.IsValid() ? cameraRate.Y * 3600.0 : 0.0);
-    }
-    m_file.Write(wxString::Format("INFO: LOCK SHIFT, enabled = %d %s\n", shiftParams.shiftEnabled, details));
+    GuideLogLockShiftRecord rec;
+    rec.enabled = shiftParams.shiftEnabled;
+    rec.mountCoords = shiftParams.shiftIsMountCoords;
+    rec.arcsec = shiftParams.shiftUnits == UNIT_ARCSEC;
+    rec.rateX = shiftParams.shiftRate.IsValid() ? shiftParams.shiftRate.X : 0.0;
+    rec.rateY = shiftParams.shiftRate.IsValid() ? shiftParams.shiftRate.Y : 0.0;
+    rec.cameraRateX = cameraRate.IsValid() ? cameraRate.X * 3600.0 : 0.0;
+    rec.cameraRateY = cameraRate.IsValid() ? cameraRate.Y * 3600.0 : 0.0;
+    WriteRecord(rec);
     m_keepFile = true;
-    Flush();
+    FlushIfDue();
 }
 
 void GuidingLog::ServerCommand(Guider *guider, const wxString& cmd)
@@ -482,7 +638,7 @@ void GuidingLog::ServerCommand(Guider *guider, const wxString& cmd)
     if (!m_enabled || !m_isGuiding)
         return;
 
-    m_file.Write(wxString::Format("INFO: Server received %s\n", cmd));
+    Write(wxString::Format("INFO: Server received %s\n", cmd));
     m_keepFile = true;
     Flush();
 }
@@ -492,7 +648,7 @@ void GuidingLog::SetGuidingParam(const wxString& name, double val)
     if (!m_enabled || !m_isGuiding)
         return;
 
-    m_file.Write(wxString::Format("INFO: Guiding parameter change, %s = %.2f\n", name, val));
+    Write(wxString::Format("INFO: Guiding parameter change, %s = %.2f\n", name, val));
     m_keepFile = true;
     Flush();
 }
@@ -502,7 +658,7 @@ void GuidingLog::SetGuidingParam(const wxString& name, int val)
     if (!m_enabled || !m_isGuiding)
         return;
 
-    m_file.Write(wxString::Format("INFO: Guiding parameter change, %s = %d\n", name, val));
+    Write(wxString::Format("INFO: Guiding parameter change, %s = %d\n", name, val));
     m_keepFile = true;
     Flush();
 }
@@ -512,7 +668,7 @@ void GuidingLog::SetGuidingParam(const wxString& name, const wxString& val)
     if (!m_enabled || !m_isGuiding)
         return;
 
-    m_file.Write(wxString::Format("INFO: Guiding parameter change, %s = %s\n", name, val));
+    Write(wxString::Format("INFO: Guiding parameter change, %s = %s\n", name, val));
     m_keepFile = true;
     Flush();
 }
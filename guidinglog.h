@@ -41,6 +41,7 @@
 class Mount;
 class Guider;
 struct LockPosShiftParams;
+class GuideLogFlushTimer;
 
 struct GuideStepInfo
 {
@@ -85,6 +86,28 @@ class GuidingLog : public Logger
     bool m_keepFile;
     bool m_isGuiding;
 
+    // binary format: records are collected in m_buffer and written to the
+    // file when the buffer fills or FLUSH_INTERVAL_MS has passed. The time
+    // based flush is driven by m_flushTimer so that a quiet period (e.g.
+    // guiding stopped by a star loss) does not leave records unwritten.
+    enum { FLUSH_INTERVAL_MS = 2000, FLUSH_BUFFER_SIZE = 32 * 1024 };
+
+    bool m_binary;
+    GuideLogWriteBuffer m_buffer;
+    wxLongLong m_lastFlushMs;
+    GuideLogFlushTimer *m_flushTimer;
+    wxCriticalSection m_lock;       // protects m_buffer and m_file
+
+    void Write(const wxString& str);
+    void WriteUTF8(const std::string& str);
+    template<typename T> void WriteRecord(const T& rec);
+    void FlushIfDue(void);
+    void StartFlushTimer(void);
+    void StopFlushTimer(void);
+
+    friend class GuideLogFlushTimer;
+    void TimedFlush(void);
+
 protected:
     void GuidingHeader(void);
 
@@ -121,6 +144,10 @@ public:
     void SetGuidingParam(const wxString& name, const wxString& val);
 
     bool ChangeDirLog(const wxString& newdir);
+
+    // binary format setting, takes effect when the next log file is opened
+    void SetBinaryFormat(bool binary);
+    bool GetBinaryFormat(void) const;
 };
 
 inline bool GuidingLog::IsEnabled(void) const
@@ -0,0 +1,274 @@
+/*
+ *  image_logger.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+ImageLogger::ImageLogger(void)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_cond(m_lock),
+      m_terminate(false),
+      m_pool(MAX_PENDING + 1)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+ImageLogger::~ImageLogger(void)
+{
+    for (std::deque<LOG_REQUEST>::iterator it = m_pending.begin(); it != m_pending.end(); ++it)
+        m_pool.Release(it->pImage);
+}
+
+void ImageLogger::LogImage(const usImage& img, const PHD_Point& star, const PHD_Point& lockPos,
+                           LOGGED_IMAGE_FORMAT format, bool fullFrame)
+{
+    if (!img.ImageData)
+        return;
+
+    int const width = img.Size.GetWidth();
+    int const height = img.Size.GetHeight();
+
+    LOG_REQUEST req;
+
+    if (fullFrame)
+    {
+        req.region = wxRect(img.Size);
+    }
+    else
+    {
+        int cx = star.IsValid() ? ROUND(star.X) : width / 2;
+        int cy = star.IsValid() ? ROUND(star.Y) : height / 2;
+        int w = wxMin((int) ROI_SIZE, width);
+        int h = wxMin((int) ROI_SIZE, height);
+        int x = wxMax(0, wxMin(cx - ROI_SIZE / 2, width - w));
+        int y = wxMax(0, wxMin(cy - ROI_SIZE / 2, height - h));
+        req.region = wxRect(x, y, w, h);
+    }
+
+    // the copy is the only work done on the caller's thread
+
+    usImage *copy = m_pool.Acquire(req.region.GetSize());
+    for (int y = 0; y < req.region.GetHeight(); y++)
+    {
+        memcpy(copy->ImageData + y * req.region.GetWidth(),
+               img.ImageData + (req.region.GetTop() + y) * width + req.region.GetLeft(),
+               req.region.GetWidth() * sizeof(unsigned short));
+    }
+    copy->ImgStartTime = img.ImgStartTime;
+    copy->ImgExpDur = img.ImgExpDur;
+    copy->FiltMin = img.FiltMin;
+    copy->FiltMax = img.FiltMax;
+
+    req.pImage = copy;
+    req.format = format;
+    req.gamma = pFrame->Stretch_gamma;
+    if (lockPos.IsValid())
+        req.lockPos.SetXY(lockPos.X - req.region.GetLeft(), lockPos.Y - req.region.GetTop());
+    req.dateObs = img.GetImgStartTime();
+    req.fname = Debug.GetLogDir() + PATHSEPSTR + "PHD_GuideStar" + wxDateTime::Now().Format(_T("_%j_%H%M%S")) +
+        (format == LIF_RAW_FITS ? ".fit" : ".jpg");
+
+    usImage *dropped = NULL;
+
+    { // lock scope
+        wxMutexLocker lock(m_lock);
+
+        if (m_pending.size() >= MAX_PENDING)
+        {
+            // the writer is behind: keep the newest frames
+            dropped = m_pending.front().pImage;
+            m_pending.pop_front();
+            ++m_stats.dropped;
+        }
+
+        m_pending.push_back(req);
+        ++m_stats.queued;
+        m_cond.Signal();
+    }
+
+    if (dropped)
+    {
+        Debug.AddLine("ImageLogger: writer behind, dropped a queued frame");
+        m_pool.Release(dropped);
+    }
+}
+
+void ImageLogger::EnqueueTerminateRequest(void)
+{
+    wxMutexLocker lock(m_lock);
+    m_terminate = true;
+    m_cond.Signal();
+}
+
+ImageLoggerStats ImageLogger::GetStats(void)
+{
+    wxMutexLocker lock(m_lock);
+    return m_stats;
+}
+
+bool ImageLogger::WriteFITS(const LOG_REQUEST& req)
+{
+    const usImage *img = req.pImage;
+
+    fitsfile *fptr;  // FITS file pointer
+    int status = 0;  // CFITSIO status value MUST be initialized to zero!
+    long fpixel[3] = {1,1,1};
+    long fsize[3];
+    char keyname[9]; // was 9
+    char keycomment[100];
+    char keystring[100];
+    int output_format=USHORT_IMG;
+
+    fsize[0] = img->Size.GetWidth();
+    fsize[1] = img->Size.GetHeight();
+    fsize[2] = 0;
+    PHD_fits_create_file(&fptr, req.fname, false, &status);
+    if (!status)
+    {
+        fits_create_img(fptr,output_format, 2, fsize, &status);
+
+        sprintf(keyname,"DATE");
+        sprintf(keycomment,"UTC date that FITS file was created");
+        sprintf(keystring,"%s", (const char *) wxDateTime::Now().Format("%Y-%m-%d %H:%M:%S", wxDateTime::UTC).c_str());
+        if (!status) fits_write_key(fptr, TSTRING, keyname, keystring, keycomment, &status);
+
+        sprintf(keyname,"DATE-OBS");
+        sprintf(keycomment,"YYYY-MM-DDThh:mm:ss observation start, UT");
+        sprintf(keystring,"%s", (const char *) req.dateObs.c_str());
+        if (!status) fits_write_key(fptr, TSTRING, keyname, keystring, keycomment, &status);
+
+        sprintf(keyname,"EXPOSURE");
+        sprintf(keycomment,"Exposure time [s]");
+        float dur = (float) img->ImgExpDur / 1000.0;
+        if (!status) fits_write_key(fptr, TFLOAT, keyname, &dur, keycomment, &status);
+
+        unsigned int tmp = 1;
+        sprintf(keyname,"XBINNING");
+        sprintf(keycomment,"Camera binning mode");
+        fits_write_key(fptr, TUINT, keyname, &tmp, keycomment, &status);
+        sprintf(keyname,"YBINNING");
+        sprintf(keycomment,"Camera binning mode");
+        fits_write_key(fptr, TUINT, keyname, &tmp, keycomment, &status);
+
+        int org;
+        sprintf(keyname,"XORGSUB");
+        sprintf(keycomment,"Subframe x position in binned pixels");
+        org = req.region.GetLeft();
+        fits_write_key(fptr, TINT, keyname, &org, keycomment, &status);
+        sprintf(keyname,"YORGSUB");
+        sprintf(keycomment,"Subframe y position in binned pixels");
+        org = req.region.GetTop();
+        fits_write_key(fptr, TINT, keyname, &org, keycomment, &status);
+
+        if (!status) fits_write_pix(fptr,TUSHORT,fpixel,img->NPixels,img->ImageData,&status);
+
+    }
+    PHD_fits_close_file(fptr);
+
+    return status != 0;
+}
+
+bool ImageLogger::WriteJPEG(const LOG_REQUEST& req)
+{
+    wxImage *img = NULL;
+    req.pImage->CopyToImage(&img, req.pImage->FiltMin, req.pImage->FiltMax, req.gamma, &m_stretchLUT);
+
+    // dotted green lock position lines
+    if (req.lockPos.IsValid())
+    {
+        int lx = ROUND(req.lockPos.X);
+        int ly = ROUND(req.lockPos.Y);
+        if (ly >= 0 && ly < img->GetHeight())
+            for (int x = 0; x < img->GetWidth(); x += 2)
+                img->SetRGB(x, ly, 0, 255, 0);
+        if (lx >= 0 && lx < img->GetWidth())
+            for (int y = 0; y < img->GetHeight(); y += 2)
+                img->SetRGB(lx, y, 0, 255, 0);
+    }
+
+    if (req.format == LIF_HI_Q_JPEG)
+    {
+        // set high(ish) JPEG quality
+        img->SetOption(wxIMAGE_OPTION_QUALITY, 100);
+    }
+
+    bool err = !img->SaveFile(req.fname, wxBITMAP_TYPE_JPEG);
+    delete img;
+
+    return err;
+}
+
+/*
+ * entry point for the image logger thread
+ */
+wxThread::ExitCode ImageLogger::Entry()
+{
+    Debug.AddLine("ImageLogger::Entry() begins");
+
+    while (true)
+    {
+        LOG_REQUEST req;
+
+        { // lock scope
+            wxMutexLocker lock(m_lock);
+
+            while (m_pending.empty() && !m_terminate)
+                m_cond.Wait();
+
+            // write out anything still queued before exiting
+            if (m_pending.empty())
+                break;
+
+            req = m_pending.front();
+            m_pending.pop_front();
+        }
+
+        bool err = req.format == LIF_RAW_FITS ? WriteFITS(req) : WriteJPEG(req);
+        if (err)
+            Debug.AddLine("ImageLogger: could not write " + req.fname);
+
+        m_pool.Release(req.pImage);
+
+        wxMutexLocker lock(m_lock);
+        if (err)
+            ++m_stats.failed;
+        else
+            ++m_stats.written;
+    }
+
+    ImageLoggerStats stats = GetStats();
+    Debug.AddLine("ImageLogger::Entry() ends: queued %u written %u dropped %u failed %u",
+        stats.queued, stats.written, stats.dropped, stats.failed);
+
+    return (wxThread::ExitCode) 0;
+}
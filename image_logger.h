@@ -0,0 +1,101 @@
+/*
+ *  image_logger.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef IMAGE_LOGGER_H_INCLUDED
+#define IMAGE_LOGGER_H_INCLUDED
+
+struct ImageLoggerStats
+{
+    unsigned int queued;        // frames accepted for logging
+    unsigned int written;       // image files written
+    unsigned int dropped;       // frames discarded because the writer fell behind
+    unsigned int failed;        // image files that could not be written
+};
+
+/*
+ * The image logger saves the logged guide star images (Tools > Enable Star Image
+ * Logging) on its own thread. The main thread only copies the star region, or the
+ * whole frame in full frame mode, into a pooled buffer and queues it; stretching,
+ * JPEG encoding and FITS writing all happen here, so logging does not hold up
+ * painting or guiding.
+ *
+ * At most MAX_PENDING frames are queued. When the writer falls behind, the oldest
+ * queued frame is dropped in favor of the newest one and counted in the stats.
+ */
+class ImageLogger : public wxThread
+{
+public:
+    enum { ROI_SIZE = 60, MAX_PENDING = 4 };
+
+private:
+    struct LOG_REQUEST
+    {
+        usImage *pImage;            // copy of the logged region, owned by the request
+        wxRect region;              // position of the copy in the frame
+        LOGGED_IMAGE_FORMAT format;
+        double gamma;               // display stretch for JPEG images
+        PHD_Point lockPos;          // relative to the copy
+        wxString dateObs;
+        wxString fname;
+    };
+
+    wxMutex m_lock;
+    wxCondition m_cond;
+    std::deque<LOG_REQUEST> m_pending;
+    bool m_terminate;
+    ImageLoggerStats m_stats;
+    ImagePool m_pool;
+    StretchLUT m_stretchLUT;        // only used by the logger thread
+
+    ImageLogger(const ImageLogger&); // not implemented
+    ImageLogger& operator=(const ImageLogger&); // not implemented
+
+public:
+    ImageLogger(void);
+    ~ImageLogger(void);
+
+    // queue the star image centered on star (the whole frame if fullFrame is set)
+    void LogImage(const usImage& img, const PHD_Point& star, const PHD_Point& lockPos,
+                  LOGGED_IMAGE_FORMAT format, bool fullFrame);
+    void EnqueueTerminateRequest(void);
+
+    ImageLoggerStats GetStats(void);
+
+private:
+    wxThread::ExitCode Entry();
+    bool WriteFITS(const LOG_REQUEST& req);
+    bool WriteJPEG(const LOG_REQUEST& req);
+};
+
+#endif /* IMAGE_LOGGER_H_INCLUDED */
@@ -79,8 +79,8 @@ double CalcSlope(const ArrayOfDbl& y)
 bool QuickLRecon(usImage& img)
 {
     // Does a simple debayer of luminance data only -- sliding 2x2 window
-    usImage tmp;
-    if (tmp.Init(img.Size))
+    PooledImage tmp(pFrame->m_imagePool, img.Size);
+    if (tmp->Init(img.Size))
     {
         pFrame->Alert(_("Memory allocation error"));
         return true;
@@ -100,7 +100,7 @@ bool QuickLRecon(usImage& img)
         RY = img.Subframe.GetY();
         RW = img.Subframe.GetWidth();
         RH = img.Subframe.GetHeight();
-        tmp.Clear();
+        tmp->Clear();
     }
 
 #define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
@@ -110,7 +110,7 @@ bool QuickLRecon(usImage& img)
 
     for (int y = 0; y <= RH - 2; y++)
     {
-        d = &tmp.ImageData[IX(0, y)];
+        d = &tmp->ImageData[IX(0, y)];
 
         for (int x = 0; x <= RW - 2; x++)
         {
@@ -129,7 +129,7 @@ bool QuickLRecon(usImage& img)
 
     // last row
 
-    d = &tmp.ImageData[IX(0, RH - 1)];
+    d = &tmp->ImageData[IX(0, RH - 1)];
 
     for (int x = 0; x <= RW - 2; x++)
     {
@@ -143,28 +143,29 @@ bool QuickLRecon(usImage& img)
 
 #undef IX
 
-    img.SwapImageData(tmp);
+    img.SwapImageData(*tmp);
     return false;
 }
 
 bool Median3(usImage& img)
 {
-    usImage tmp;
-    tmp.Init(img.Size);
+    PooledImage tmp(pFrame->m_imagePool, img.Size);
+    if (tmp->Init(img.Size))
+        return true;
 
     bool err;
 
     if (img.Subframe.IsEmpty())
     {
-        err = Median3(tmp.ImageData, img.ImageData, img.Size, wxRect(img.Size));
+        err = Median3(tmp->ImageData, img.ImageData, img.Size, wxRect(img.Size));
     }
     else
     {
-        tmp.Clear();
-        err = Median3(tmp.ImageData, img.ImageData, img.Size, img.Subframe);
+        tmp->Clear();
+        err = Median3(tmp->ImageData, img.ImageData, img.Size, img.Subframe);
     }
 
-    img.SwapImageData(tmp);
+    img.SwapImageData(*tmp);
     return err;
 }
 
@@ -316,7 +317,13 @@ inline static unsigned short median3(const unsigned short l[3])
     return l0;
 }
 
-bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect)
+// Walks the 3x3 median filter over rows [y0, y1) of rect, passing the filtered pixel values to
+// the sink in raster order. For each row the sink receives BeginRow(y), then the values either
+// one at a time via Put(value) or in runs: Reserve(buf, n) returns where to write the next n
+// values (buf if the sink has nowhere better) and Commit(p, n) hands them over. EndRow(y) ends the
+// row. The interior of each row is computed by the SIMD row kernel.
+template <class Sink>
+static void Median3Walk(Sink& sink, const unsigned short *src, const wxSize& size, const wxRect& rect, int y0, int y1)
 {
     int const W = size.GetWidth();
     int const RX = rect.GetX();
@@ -324,43 +331,52 @@ bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size,
     int const RW = rect.GetWidth();
     int const RH = rect.GetHeight();
 
+    const ImageKernels& kernels = GetImageKernels();
+
+    enum { CHUNK = 1024 };
+    unsigned short buf[CHUNK];
+
     unsigned short a[9];
-    unsigned short *d;
 
 #define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
 
-    // top row
-    d = &dst[IX(0, 0)];
+    if (y0 == 0)
+    {
+        // top row
+        sink.BeginRow(0);
 
-    // top-left corner
-    a[0] = src[IX(0, 0)];
-    a[1] = src[IX(1, 0)];
-    a[2] = src[IX(0, 1)];
-    a[3] = src[IX(1, 1)];
-    *d++ = median4(a);
+        // top-left corner
+        a[0] = src[IX(0, 0)];
+        a[1] = src[IX(1, 0)];
+        a[2] = src[IX(0, 1)];
+        a[3] = src[IX(1, 1)];
+        sink.Put(median4(a));
 
-    // top row middle pixels
-    for (int x = 1; x <= RW - 2; x++)
-    {
-        a[0] = src[IX(x - 1, 0)];
-        a[1] = src[IX(x,     0)];
-        a[2] = src[IX(x + 1, 0)];
-        a[3] = src[IX(x - 1, 1)];
-        a[4] = src[IX(x,     1)];
-        a[5] = src[IX(x + 1, 1)];
-        *d++ = median6(a);
-    }
+        // top row middle pixels
+        for (int x = 1; x <= RW - 2; x++)
+        {
+            a[0] = src[IX(x - 1, 0)];
+            a[1] = src[IX(x,     0)];
+            a[2] = src[IX(x + 1, 0)];
+            a[3] = src[IX(x - 1, 1)];
+            a[4] = src[IX(x,     1)];
+            a[5] = src[IX(x + 1, 1)];
+            sink.Put(median6(a));
+        }
 
-    // top-right corner
-    a[0] = src[IX(RW - 2, 0)];
-    a[1] = src[IX(RW - 1, 0)];
-    a[2] = src[IX(RW - 2, 1)];
-    a[3] = src[IX(RW - 1, 1)];
-    *d = median4(a);
+        // top-right corner
+        a[0] = src[IX(RW - 2, 0)];
+        a[1] = src[IX(RW - 1, 0)];
+        a[2] = src[IX(RW - 2, 1)];
+        a[3] = src[IX(RW - 1, 1)];
+        sink.Put(median4(a));
+        sink.EndRow(0);
+    }
 
-    for (int y = 1; y <= RH - 2; y++)
+    int const yEnd = std::min(y1, RH - 1);
+    for (int y = std::max(y0, 1); y < yEnd; y++)
     {
-        d = &dst[IX(0, y)];
+        sink.BeginRow(y);
 
         // leftmost pixel
         a[0] = src[IX(0, y - 1)];
@@ -369,20 +385,19 @@ bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size,
         a[3] = src[IX(1, y    )];
         a[4] = src[IX(0, y + 1)];
         a[5] = src[IX(1, y + 1)];
-        *d++ = median6(a);
+        sink.Put(median6(a));
 
-        for (int x = 1; x <= RW - 2; x++)
+        // interior pixels
+        const unsigned short *r0 = &src[IX(0, y - 1)];
+        const unsigned short *r1 = &src[IX(0, y    )];
+        const unsigned short *r2 = &src[IX(0, y + 1)];
+        for (int x = 0; x < RW - 2; )
         {
-            a[0] = src[IX(x - 1, y - 1)];
-            a[1] = src[IX(x    , y - 1)];
-            a[2] = src[IX(x + 1, y - 1)];
-            a[3] = src[IX(x - 1, y    )];
-            a[4] = src[IX(x    , y    )];
-            a[5] = src[IX(x + 1, y    )];
-            a[6] = src[IX(x - 1, y + 1)];
-            a[7] = src[IX(x    , y + 1)];
-            a[8] = src[IX(x + 1, y + 1)];
-            *d++ = median9(a);
+            int const n = std::min((int) CHUNK, RW - 2 - x);
+            unsigned short *p = sink.Reserve(buf, n);
+            kernels.median3x3(p, r0 + x, r1 + x, r2 + x, n);
+            sink.Commit(p, n);
+            x += n;
         }
 
         // rightmost pixel
@@ -392,44 +407,305 @@ bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size,
         a[3] = src[IX(RW - 1, y    )];
         a[4] = src[IX(RW - 2, y + 1)];
         a[5] = src[IX(RW - 1, y + 1)];
-        *d++ = median6(a);
+        sink.Put(median6(a));
+        sink.EndRow(y);
     }
 
-    // bottom row
-    d = &dst[IX(0, RH - 1)];
+    if (y1 == RH)
+    {
+        // bottom row
+        sink.BeginRow(RH - 1);
+
+        // bottom-left corner
+        a[0] = src[IX(0, RH - 2)];
+        a[1] = src[IX(1, RH - 2)];
+        a[2] = src[IX(0, RH - 1)];
+        a[3] = src[IX(1, RH - 1)];
+        sink.Put(median4(a));
+
+        // bottom row middle pixels
+        for (int x = 1; x <= RW - 2; x++)
+        {
+            a[0] = src[IX(x - 1, RH - 2)];
+            a[1] = src[IX(x    , RH - 2)];
+            a[2] = src[IX(x + 1, RH - 2)];
+            a[3] = src[IX(x - 1, RH - 1)];
+            a[4] = src[IX(x    , RH - 1)];
+            a[5] = src[IX(x + 1, RH - 1)];
+            sink.Put(median6(a));
+        }
+
+        // bottom-right corner
+        a[0] = src[IX(RW - 2, RH - 2)];
+        a[1] = src[IX(RW - 1, RH - 2)];
+        a[2] = src[IX(RW - 2, RH - 1)];
+        a[3] = src[IX(RW - 1, RH - 1)];
+        sink.Put(median4(a));
+        sink.EndRow(RH - 1);
+    }
+
+#undef IX
+}
+
+struct Median3ImageSink
+{
+    unsigned short *m_dst;
+    int m_stride;
+    int m_rx, m_ry;
+    unsigned short *m_d;
+
+    Median3ImageSink(unsigned short *dst, const wxSize& size, const wxRect& rect)
+        : m_dst(dst), m_stride(size.GetWidth()), m_rx(rect.GetX()), m_ry(rect.GetY()), m_d(0) { }
+    void BeginRow(int y) { m_d = &m_dst[(m_ry + y) * m_stride + m_rx]; }
+    void Put(unsigned short val) { *m_d++ = val; }
+    unsigned short *Reserve(unsigned short *buf, int n) { return m_d; }
+    void Commit(const unsigned short *p, int n) { m_d += n; }
+    void EndRow(int y) { }
+};
 
-    // bottom-left corner
-    a[0] = src[IX(0, RH - 2)];
-    a[1] = src[IX(1, RH - 2)];
-    a[2] = src[IX(0, RH - 1)];
-    a[3] = src[IX(1, RH - 1)];
-    *d++ = median4(a);
+// frames smaller than this are not worth the cost of starting threads
+static const int MIN_THREADED_PIXELS = 1000000;
+static const int MAX_BAND_THREADS = 4;
 
-    // bottom row middle pixels
-    for (int x = 1; x <= RW - 2; x++)
+// A band worker waits for a band to run, runs it and posts the shared done
+// semaphore. The workers are started on first use and kept until
+// StopRowBandThreads, so splitting a frame into bands does not start threads.
+class RowBandThread : public wxThread
+{
+    wxSemaphore m_start;
+    wxSemaphore& m_done;
+    RowBandTask *m_task;
+    int m_y0, m_y1;
+    bool m_quit;
+
+public:
+    RowBandThread(wxSemaphore& done)
+        : wxThread(wxTHREAD_JOINABLE), m_done(done), m_task(0), m_y0(0), m_y1(0), m_quit(false) { }
+
+    void Start(RowBandTask *task, int y0, int y1)
     {
-        a[0] = src[IX(x - 1, RH - 2)];
-        a[1] = src[IX(x    , RH - 2)];
-        a[2] = src[IX(x + 1, RH - 2)];
-        a[3] = src[IX(x - 1, RH - 1)];
-        a[4] = src[IX(x    , RH - 1)];
-        a[5] = src[IX(x + 1, RH - 1)];
-        *d++ = median6(a);
+        m_task = task;
+        m_y0 = y0;
+        m_y1 = y1;
+        m_start.Post();
     }
 
-    // bottom-right corner
-    a[0] = src[IX(RW - 2, RH - 2)];
-    a[1] = src[IX(RW - 1, RH - 2)];
-    a[2] = src[IX(RW - 2, RH - 1)];
-    a[3] = src[IX(RW - 1, RH - 1)];
-    *d = median4(a);
+    void Quit()
+    {
+        m_quit = true;
+        m_start.Post();
+    }
 
-#undef IX
+    ExitCode Entry()
+    {
+        while (true)
+        {
+            m_start.Wait();
+            if (m_quit)
+                break;
+            m_task->Run(m_y0, m_y1);
+            m_done.Post();
+        }
+        return 0;
+    }
+};
+
+// the pool serves one RunRowBands call at a time; a concurrent call (e.g. the
+// display stretch while the processing thread filters a frame) runs its bands
+// on its own thread instead of waiting
+static wxCriticalSection s_bandPoolLock;
+static std::vector<RowBandThread *> s_bandThreads;
+static wxSemaphore s_bandDone;
+
+// makes sure there are at least count workers, returns the number available.
+// Called with s_bandPoolLock held.
+static unsigned int StartRowBandThreads(unsigned int count)
+{
+    while (s_bandThreads.size() < count)
+    {
+        RowBandThread *thread = new RowBandThread(s_bandDone);
+        if (thread->Run() != wxTHREAD_NO_ERROR)
+        {
+            delete thread;
+            break;
+        }
+        s_bandThreads.push_back(thread);
+    }
+    return s_bandThreads.size();
+}
+
+void StopRowBandThreads(void)
+{
+    wxCriticalSectionLocker lock(s_bandPoolLock);
+
+    for (unsigned int i = 0; i < s_bandThreads.size(); i++)
+    {
+        s_bandThreads[i]->Quit();
+        s_bandThreads[i]->Wait();
+        delete s_bandThreads[i];
+    }
+    s_bandThreads.clear();
+}
+
+int BandThreadCount(int pixels)
+{
+    if (pixels < MIN_THREADED_PIXELS)
+        return 1;
+    return std::max(1, std::min(wxThread::GetCPUCount(), (int) MAX_BAND_THREADS));
+}
+
+void RunRowBands(RowBandTask& task, int height, int nbands)
+{
+    int const band = (height + std::max(nbands, 1) - 1) / std::max(nbands, 1);
+
+    if (band >= height || !s_bandPoolLock.TryEnter())
+    {
+        task.Run(0, height);
+        return;
+    }
+
+    unsigned int const workers = StartRowBandThreads(std::min(nbands, (int) MAX_BAND_THREADS) - 1);
+    unsigned int started = 0;
+
+    for (int y0 = band; y0 < height; y0 += band)
+    {
+        int const y1 = std::min(y0 + band, height);
+        if (started < workers)
+            s_bandThreads[started++]->Start(&task, y0, y1);
+        else
+            task.Run(y0, y1);   // could not start a worker, do the band here
+    }
+
+    task.Run(0, band);
+
+    for (unsigned int i = 0; i < started; i++)
+        s_bandDone.Wait();
+
+    s_bandPoolLock.Leave();
+}
+
+struct Median3Task : public RowBandTask
+{
+    unsigned short *m_dst;
+    const unsigned short *m_src;
+    const wxSize& m_size;
+    const wxRect& m_rect;
+
+    Median3Task(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect)
+        : m_dst(dst), m_src(src), m_size(size), m_rect(rect) { }
+
+    void Run(int y0, int y1)
+    {
+        Median3ImageSink sink(m_dst, m_size, m_rect);
+        Median3Walk(sink, m_src, m_size, m_rect, y0, y1);
+    }
+};
 
+bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect)
+{
+    // the bands read each other's edge rows but write disjoint rows
+    Median3Task task(dst, src, size, rect);
+    RunRowBands(task, rect.GetHeight(), BandThreadCount(rect.GetWidth() * rect.GetHeight()));
     return false;
 }
 
-static unsigned short MedianBorderingPixels(const usImage& img, int x, int y)
+// Accumulates the image statistics while the median filter walks the image. The raw pixel
+// min/max are taken a row at a time as each row of filtered values is completed, so the source
+// row is still in cache.
+struct Median3StatsSink
+{
+    const unsigned short *m_src;
+    int m_stride;
+    int m_rx, m_ry, m_rw;
+    int m_min, m_max;
+    int m_filtMin, m_filtMax;
+
+    Median3StatsSink(const usImage& img, const wxRect& rect)
+        : m_src(img.ImageData), m_stride(img.Size.GetWidth()), m_rx(rect.GetX()), m_ry(rect.GetY()),
+        m_rw(rect.GetWidth()), m_min(65535), m_max(0), m_filtMin(65535), m_filtMax(0)
+    { }
+
+    void BeginRow(int y) { }
+
+    void Put(unsigned short val)
+    {
+        if (val < m_filtMin) m_filtMin = val;
+        if (val > m_filtMax) m_filtMax = val;
+    }
+
+    unsigned short *Reserve(unsigned short *buf, int n) { return buf; }
+
+    void Commit(const unsigned short *p, int n)
+    {
+        int mn = m_filtMin, mx = m_filtMax;
+        for (int i = 0; i < n; i++)
+        {
+            int const d = (int) p[i];
+            if (d < mn) mn = d;
+            if (d > mx) mx = d;
+        }
+        m_filtMin = mn;
+        m_filtMax = mx;
+    }
+
+    void EndRow(int y)
+    {
+        const unsigned short *p = &m_src[(m_ry + y) * m_stride + m_rx];
+        const unsigned short *const end = p + m_rw;
+        int mn = m_min, mx = m_max;
+        for (const unsigned short *q = p; q < end; q++)
+        {
+            int const d = (int) *q;
+            if (d < mn) mn = d;
+            if (d > mx) mx = d;
+        }
+        m_min = mn;
+        m_max = mx;
+    }
+};
+
+void CalcImageStats(const usImage& img, const wxRect& rect, int *min, int *max, int *filtMin, int *filtMax)
+{
+    Median3StatsSink sink(img, rect);
+
+    if (rect.GetWidth() >= 2 && rect.GetHeight() >= 2)
+    {
+        Median3Walk(sink, img.ImageData, img.Size, rect, 0, rect.GetHeight());
+    }
+    else
+    {
+        // too small to filter, use the raw values
+        for (int y = 0; y < rect.GetHeight(); y++)
+            sink.EndRow(y);
+        sink.m_filtMin = sink.m_min;
+        sink.m_filtMax = sink.m_max;
+    }
+
+    *min = sink.m_min;
+    *max = sink.m_max;
+    *filtMin = sink.m_filtMin;
+    *filtMax = sink.m_filtMax;
+}
+
+// offsets of the 8 neighbors of an interior pixel, for a given image width
+struct NeighborOffsets
+{
+    int ofs[8];
+
+    NeighborOffsets(int xsize)
+    {
+        ofs[0] = -xsize - 1;
+        ofs[1] = -xsize;
+        ofs[2] = -xsize + 1;
+        ofs[3] = -1;
+        ofs[4] = +1;
+        ofs[5] = xsize - 1;
+        ofs[6] = xsize;
+        ofs[7] = xsize + 1;
+    }
+};
+
+static unsigned short MedianBorderingPixels(const usImage& img, int x, int y, const NeighborOffsets& nbr)
 {
     unsigned short array[8];
     int const xsize = img.Size.GetWidth();
@@ -437,14 +713,9 @@ static unsigned short MedianBorderingPixels(const usImage& img, int x, int y)
 
     if (x > 0 && y > 0 && x < xsize - 1 && y < ysize - 1)
     {
-        array[0] = img.ImageData[(x-1) + (y-1) * xsize];
-        array[1] = img.ImageData[(x)   + (y-1) * xsize];
-        array[2] = img.ImageData[(x+1) + (y-1) * xsize];
-        array[3] = img.ImageData[(x-1) + (y)   * xsize];
-        array[4] = img.ImageData[(x+1) + (y)   * xsize];
-        array[5] = img.ImageData[(x-1) + (y+1) * xsize];
-        array[6] = img.ImageData[(x)   + (y+1) * xsize];
-        array[7] = img.ImageData[(x+1) + (y+1) * xsize];
+        const unsigned short *p = &img.ImageData[x + y * xsize];
+        for (int i = 0; i < 8; i++)
+            array[i] = p[nbr.ofs[i]];
         return median8(array);
     }
 
@@ -592,139 +863,253 @@ bool Subtract(usImage& light, const usImage& dark)
         height = light.Size.GetHeight();
     }
 
-    int mindiff = 65535;
+    // The result is light - dark + offset, where the offset is just large enough to keep every
+    // pixel non-negative (the largest amount by which the dark exceeds the light). The first
+    // pass only reads the two frames to find that offset, the second subtracts with it.
 
-    unsigned short *pl0 = &light.Pixel(left, top);
-    const unsigned short *pd0 = &dark.Pixel(left, top);
-    for (unsigned int r = 0; r < height;
-         r++, pl0 += light.Size.GetWidth(), pd0 += light.Size.GetWidth())
+    const ImageKernels& k = GetImageKernels();
+    unsigned int const stride = light.Size.GetWidth();
+
+    unsigned short *const pl0 = &light.Pixel(left, top);
+    const unsigned short *const pd0 = &dark.Pixel(left, top);
+
+    unsigned short offset = 0;
+    for (unsigned int r = 0; r < height; r++)
     {
-        unsigned short *const endl = pl0 + width;
-        unsigned short *pl;
-        const unsigned short *pd;
-        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
+        unsigned short const d = k.darkDeficit(pl0 + r * stride, pd0 + r * stride, width);
+        if (d > offset)
+            offset = d;
+    }
+
+    for (unsigned int r = 0; r < height; r++)
+        k.darkSubtract(pl0 + r * stride, pd0 + r * stride, width, offset);
+
+    return false;
+}
+
+// Sliding window median over a two-level histogram (256 coarse bins of 256 fine bins). The
+// median is tracked incrementally: m_lt is the number of values in the window less than m_med,
+// and Median() walks m_med from its previous position, skipping whole coarse bins where it can.
+// The window only changes by one row or column between calls, so the median moves a short way.
+class SlidingMedian
+{
+    // fine bin counts fit in 16 bits for windows up to 255x255, and the smaller table stays in cache
+    std::vector<unsigned short> m_fine;
+    unsigned int m_coarse[256];
+    unsigned int m_n;
+    unsigned int m_med;
+    unsigned int m_lt;
+
+public:
+    SlidingMedian() : m_fine(65536, 0), m_n(0), m_med(0), m_lt(0)
+    {
+        memset(&m_coarse[0], 0, sizeof(m_coarse));
+    }
+
+    // returns the value of rank n/2 in the window
+    unsigned short Median()
+    {
+        unsigned int const k = m_n / 2;
+        unsigned int med = m_med;
+        unsigned int lt = m_lt;
+
+        while (lt > k)
         {
-            int diff = (int) *pl - (int) *pd;
-            if (diff < mindiff)
-                mindiff = diff;
+            if ((med & 0xff) == 0 && lt - m_coarse[(med >> 8) - 1] > k)
+            {
+                med -= 256;
+                lt -= m_coarse[med >> 8];
+            }
+            else
+            {
+                --med;
+                lt -= m_fine[med];
+            }
         }
+
+        while (lt + m_fine[med] <= k)
+        {
+            if ((med & 0xff) == 0 && lt + m_coarse[med >> 8] <= k)
+            {
+                lt += m_coarse[med >> 8];
+                med += 256;
+            }
+            else
+            {
+                lt += m_fine[med];
+                ++med;
+            }
+        }
+
+        m_med = med;
+        m_lt = lt;
+        return (unsigned short) med;
     }
 
-    int offset = 0;
-    if (mindiff < 0) // dark was lighter than light
-        offset = -mindiff;
+    // the window is updated a row or column at a time; these are the hot loops of the filter so
+    // m_lt is updated without a branch
 
-    pl0 = &light.Pixel(left, top);
-    pd0 = &dark.Pixel(left, top);
-    for (unsigned int r = 0; r < height;
-         r++, pl0 += light.Size.GetWidth(), pd0 += light.Size.GetWidth())
+    void AddRow(const unsigned short *p, int n)
     {
-        unsigned short *const endl = pl0 + width;
-        unsigned short *pl;
-        const unsigned short *pd;
-        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
+        unsigned int const med = m_med;
+        unsigned int lt = m_lt;
+        for (int i = 0; i < n; i++)
         {
-            int newval = (int) *pl - (int) *pd + offset;
-            if (newval < 0) newval = 0; // shouldn't hit this...
-            else if (newval > 65535) newval = 65535;
-            *pl = (unsigned short) newval;
+            unsigned short const v = p[i];
+            ++m_fine[v];
+            ++m_coarse[v >> 8];
+            lt += v < med;
         }
+        m_lt = lt;
+        m_n += n;
     }
 
-    return false;
-}
+    void RemoveRow(const unsigned short *p, int n)
+    {
+        unsigned int const med = m_med;
+        unsigned int lt = m_lt;
+        for (int i = 0; i < n; i++)
+        {
+            unsigned short const v = p[i];
+            --m_fine[v];
+            --m_coarse[v >> 8];
+            lt -= v < med;
+        }
+        m_lt = lt;
+        m_n -= n;
+    }
 
-inline static unsigned short histo_median(unsigned short histo1[256], unsigned short histo2[65536], int n)
-{
-    n /= 2;
-    unsigned int i;
-    for (i = 0; i < 256; i++)
+    void AddColumn(const unsigned short *p, int n, int stride)
     {
-        if (histo1[i] > n)
-            break;
-        n -= histo1[i];
+        unsigned int const med = m_med;
+        unsigned int lt = m_lt;
+        for (int i = 0; i < n; i++, p += stride)
+        {
+            unsigned short const v = *p;
+            ++m_fine[v];
+            ++m_coarse[v >> 8];
+            lt += v < med;
+        }
+        m_lt = lt;
+        m_n += n;
     }
-    for (i <<= 8; i < 65536; i++)
+
+    void RemoveColumn(const unsigned short *p, int n, int stride)
     {
-        if (histo2[i] > n)
-            break;
-        n -= histo2[i];
+        unsigned int const med = m_med;
+        unsigned int lt = m_lt;
+        for (int i = 0; i < n; i++, p += stride)
+        {
+            unsigned short const v = *p;
+            --m_fine[v];
+            --m_coarse[v >> 8];
+            lt -= v < med;
+        }
+        m_lt = lt;
+        m_n -= n;
     }
-    return i;
-}
+};
 
-static void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
+// Median filter over a (2 * halfWidth + 1) square window, clipped at the image edges. Each band
+// of rows is traversed in serpentine order (left to right, down one row, right to left, ...) so
+// the window histogram is built once per band and only updated incrementally after that.
+struct MedianFilterTask : public RowBandTask
 {
-    dst.Init(src.Size);
-    unsigned short *d = &dst.ImageData[0];
+    usImage& m_dst;
+    const usImage& m_src;
+    int m_halfWidth;
 
-    int const width = src.Size.GetWidth();
-    int const height = src.Size.GetHeight();
+    MedianFilterTask(usImage& dst, const usImage& src, int halfWidth)
+        : m_dst(dst), m_src(src), m_halfWidth(halfWidth) { }
 
-    for (int y = 0; y < height; y++)
+    void Run(int y0, int y1)
     {
-        int top = std::max(0, y - halfWidth);
-        int bot = std::min(y + halfWidth, height - 1);
-        int left = 0;
-        int right = halfWidth;
+        int const width = m_src.Size.GetWidth();
+        int const height = m_src.Size.GetHeight();
+        int const r = m_halfWidth;
+        const unsigned short *const src = m_src.ImageData;
 
-        // TODO: we initialize the histogram at the start of each row, but we could make this faster
-        // if we scan left to right, move down, scan right to left, move down so we never need to
-        // reinitialize the histogram
+        SlidingMedian h;
 
-        // initialize 2-level histogram
-        unsigned short histo1[256];
-        unsigned short histo2[65536];
-        memset(&histo1[0], 0, sizeof(histo1));
-        memset(&histo2[0], 0, sizeof(histo2));
+        int top = std::max(0, y0 - r);
+        int bot = std::min(y0 + r, height - 1);
+        int left = 0;
+        int right = std::min(r, width - 1);
 
         for (int j = top; j <= bot; j++)
+            h.AddRow(&src[j * width + left], right - left + 1);
+
+        for (int y = y0; y < y1; y++)
         {
-            const unsigned short *p = &src.Pixel(left, j);
-            for (int i = left; i <= right; i++, p++)
+            if (y > y0)
             {
-                ++histo1[*p >> 8];
-                ++histo2[*p];
+                // move the window down one row
+                if (y - r - 1 >= 0)
+                {
+                    h.RemoveRow(&src[(y - r - 1) * width + left], right - left + 1);
+                    top = y - r;
+                }
+                if (y + r < height)
+                {
+                    h.AddRow(&src[(y + r) * width + left], right - left + 1);
+                    bot = y + r;
+                }
             }
-        }
-        unsigned int n = (right - left + 1) * (bot - top + 1);
 
-        // read off first value for this row
-        *d++ = histo_median(histo1, histo2, n);
+            unsigned short *d = &m_dst.ImageData[y * width];
 
-        // loop across remaining columns for this row
-        for (int i = 1; i < width; i++)
-        {
-            left = std::max(0, i - halfWidth);
-            right = std::min(i + halfWidth, width - 1);
-
-            // remove leftmost column
-            if (left > 0)
+            if (((y - y0) & 1) == 0)
             {
-                const unsigned short *p = &src.Pixel(left - 1, top);
-                for (int j = top; j <= bot; j++, p += width)
+                // left to right
+                for (int x = 0; ; )
                 {
-                    --histo1[*p >> 8];
-                    --histo2[*p];
+                    d[x] = h.Median();
+                    if (++x == width)
+                        break;
+                    if (x - r - 1 >= 0)
+                    {
+                        h.RemoveColumn(&src[top * width + x - r - 1], bot - top + 1, width);
+                        left = x - r;
+                    }
+                    if (x + r < width)
+                    {
+                        h.AddColumn(&src[top * width + x + r], bot - top + 1, width);
+                        right = x + r;
+                    }
                 }
-                n -= (bot - top + 1);
             }
-
-            // add new column on right
-            if (i + halfWidth <= width - 1)
+            else
             {
-                const unsigned short *p = &src.Pixel(right, top);
-                for (int j = top; j <= bot; j++, p += width)
+                // right to left
+                for (int x = width - 1; ; )
                 {
-                    ++histo1[*p >> 8];
-                    ++histo2[*p];
+                    d[x] = h.Median();
+                    if (x-- == 0)
+                        break;
+                    if (x + r + 1 < width)
+                    {
+                        h.RemoveColumn(&src[top * width + x + r + 1], bot - top + 1, width);
+                        right = x + r;
+                    }
+                    if (x - r >= 0)
+                    {
+                        h.AddColumn(&src[top * width + x - r], bot - top + 1, width);
+                        left = x - r;
+                    }
                 }
-                n += (bot - top + 1);
             }
-
-            *d++ = histo_median(histo1, histo2, n);
         }
     }
+};
+
+static void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
+{
+    assert(halfWidth <= 127);
+
+    dst.Init(src.Size);
+
+    MedianFilterTask task(dst, src, halfWidth);
+    RunRowBands(task, src.Size.GetHeight(), BandThreadCount(src.NPixels));
 }
 
 struct ImageStatsWork
@@ -1023,6 +1408,7 @@ void DefectMapBuilder::BuildDefectMap(DefectMap& defectMap, bool verbose) const
     defectMap.clear();
     unsigned int nr_cold = emit_defects(defectMap, m_impl->coldPxThresh, m_impl->coldPx.end(), stats.stdev, -1, verbose);
     unsigned int nr_hot = emit_defects(defectMap, m_impl->hotPxThresh, m_impl->hotPx.end(), stats.stdev, +1, verbose);
+    defectMap.BuildIndex();
 
     if (verbose) Debug.AddLine("New defect map created, count=%d (cold=%d, hot=%d)", defectMap.size(), nr_cold, nr_hot);
 }
@@ -1038,7 +1424,32 @@ bool RemoveDefects(usImage& light, const DefectMap& defectMap)
     if (!light.ImageData)
         return true;
 
-    if (!light.Subframe.IsEmpty())
+    NeighborOffsets const nbr(light.Size.GetWidth());
+
+    if (!light.Subframe.IsEmpty() && defectMap.IsIndexed())
+    {
+        // Only visit the defects inside the subframe, walking the row index in place. The
+        // defects are corrected in (y, x) order rather than defect list order; the order only
+        // matters for adjacent defects, where a corrected defect contributes to the median of
+        // the next one.
+        int const top = std::max(light.Subframe.GetTop(), 0);
+        int const bottom = std::min(light.Subframe.GetBottom(), defectMap.IndexedRows() - 1);
+        int const right = light.Subframe.GetRight();
+
+        for (int y = top; y <= bottom; y++)
+        {
+            const DefectMap::DefectRow& row = defectMap.Row(y);
+            for (DefectMap::DefectRow::const_iterator it = defectMap.RowLowerBound(y, light.Subframe.GetLeft());
+                 it != row.end(); ++it)
+            {
+                int const x = defectMap[*it].x;
+                if (x > right)
+                    break;
+                light.Pixel(x, y) = MedianBorderingPixels(light, x, y, nbr);
+            }
+        }
+    }
+    else if (!light.Subframe.IsEmpty())
     {
         // Step over each defect and replace the light value
         // with the median of the surrounding pixels
@@ -1048,7 +1459,7 @@ bool RemoveDefects(usImage& light, const DefectMap& defectMap)
             // Check to see if we are within the subframe before correcting the defect
             if (light.Subframe.Contains(pt))
             {
-                light.Pixel(pt.x, pt.y) = MedianBorderingPixels(light, pt.x, pt.y);
+                light.Pixel(pt.x, pt.y) = MedianBorderingPixels(light, pt.x, pt.y, nbr);
             }
         }
     }
@@ -1063,7 +1474,7 @@ bool RemoveDefects(usImage& light, const DefectMap& defectMap)
 
             if (x >= 0 && x < light.Size.GetWidth() && y >= 0 && y < light.Size.GetHeight())
             {
-                light.Pixel(x, y) = MedianBorderingPixels(light, x, y);
+                light.Pixel(x, y) = MedianBorderingPixels(light, x, y, nbr);
             }
         }
     }
@@ -1175,24 +1586,88 @@ void DefectMap::Save(const wxArrayString& info) const
 }
 
 DefectMap::DefectMap()
-    : m_profileId(pConfig->GetCurrentProfileId())
+    : m_profileId(pConfig->GetCurrentProfileId()),
+    m_indexValid(true)
 {
 }
 
 DefectMap::DefectMap(int profileId)
-    : m_profileId(profileId)
+    : m_profileId(profileId),
+    m_indexValid(true)
+{
+}
+
+// orders the defect indexes within a row by x
+struct DefectRowXLess
+{
+    const DefectMap& m_map;
+    DefectRowXLess(const DefectMap& map) : m_map(map) { }
+    bool operator()(unsigned int a, unsigned int b) const { return m_map[a].x < m_map[b].x; }
+    bool operator()(unsigned int idx, int x) const { return m_map[idx].x < x; }
+    bool operator()(int x, unsigned int idx) const { return x < m_map[idx].x; }
+};
+
+void DefectMap::BuildIndex()
+{
+    m_rows.clear();
+
+    int maxY = -1;
+    for (const_iterator it = begin(); it != end(); ++it)
+        if (it->y > maxY)
+            maxY = it->y;
+
+    m_rows.resize(maxY + 1);
+
+    // defects with negative y are off the sensor and never corrected
+    for (unsigned int i = 0; i < size(); i++)
+    {
+        const wxPoint& pt = (*this)[i];
+        if (pt.y >= 0)
+            m_rows[pt.y].push_back(i);
+    }
+
+    // stable so duplicates stay in defect list order
+    for (std::vector<DefectRow>::iterator row = m_rows.begin(); row != m_rows.end(); ++row)
+        std::stable_sort(row->begin(), row->end(), DefectRowXLess(*this));
+
+    m_indexValid = true;
+}
+
+DefectMap::DefectRow::const_iterator DefectMap::RowLowerBound(int y, int x) const
 {
+    const DefectRow& row = m_rows[y];
+    return std::lower_bound(row.begin(), row.end(), x, DefectRowXLess(*this));
 }
 
 bool DefectMap::FindDefect(const wxPoint& pt) const
 {
-    return std::find(begin(), end(), pt) != end();
+    // defects with negative y are not indexed
+    if (!IsIndexed() || pt.y < 0)
+        return std::find(begin(), end(), pt) != end();
+
+    if (pt.y >= IndexedRows())
+        return false;
+
+    DefectRow::const_iterator it = RowLowerBound(pt.y, pt.x);
+    return it != m_rows[pt.y].end() && (*this)[*it].x == pt.x;
 }
 
 void DefectMap::AddDefect(const wxPoint& pt)
 {
     // first add the point
-    push_back(pt);
+    m_defects.push_back(pt);
+
+    if (!IsIndexed())
+        BuildIndex();
+    else if (pt.y >= 0)
+    {
+        // insert into the row after any existing defects with the same x
+        unsigned int const idx = size() - 1;
+        if (pt.y >= IndexedRows())
+            m_rows.resize(pt.y + 1);
+        DefectRow& row = m_rows[pt.y];
+        row.insert(std::upper_bound(row.begin(), row.end(), pt.x, DefectRowXLess(*this)), idx);
+    }
 
     wxString filename = DefectMapFileName(m_profileId);
     wxFile file(filename, wxFile::write_append);
@@ -1259,6 +1734,8 @@ DefectMap *DefectMap::LoadDefectMap(int profileId)
         }
     }
 
+    defectMap->BuildIndex();
+
     Debug.AddLine(wxString::Format("Loaded %d defects", defectMap->size()));
     return defectMap;
 }
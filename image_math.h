@@ -36,9 +36,23 @@
 #ifndef IMAGE_MATH_INCLUDED
 #define IMAGE_MATH_INCLUDED
 
-class DefectMap : public std::vector<wxPoint>
+class DefectMap
 {
     int m_profileId;
+    std::vector<wxPoint> m_defects;
+
+public:
+    typedef std::vector<unsigned int> DefectRow;
+    typedef std::vector<wxPoint>::const_iterator const_iterator;
+
+private:
+    // Spatial index so that subframe defect correction only visits the defects inside the
+    // subframe. m_rows[y] holds the indexes into the defect list of the defects in row y,
+    // ordered by x. AddDefect keeps the index up to date; push_back and clear mark it stale,
+    // and a stale index is not used until BuildIndex is called.
+    std::vector<DefectRow> m_rows;
+    bool m_indexValid;
+
     DefectMap(int profileId);
 public:
     static void DeleteDefectMap(int profileId);
@@ -51,11 +65,44 @@ public:
     bool FindDefect(const wxPoint& pt) const;
     void AddDefect(const wxPoint& pt);
 
+    const_iterator begin() const { return m_defects.begin(); }
+    const_iterator end() const { return m_defects.end(); }
+    size_t size() const { return m_defects.size(); }
+    bool empty() const { return m_defects.empty(); }
+    const wxPoint& operator[](size_t i) const { return m_defects[i]; }
+    // add a defect in memory only, without updating the index
+    void push_back(const wxPoint& pt) { m_defects.push_back(pt); m_indexValid = false; }
+    void clear() { m_defects.clear(); m_rows.clear(); m_indexValid = false; }
+
+    void BuildIndex();
+    bool IsIndexed() const { return m_indexValid; }
+    // number of indexed rows; defects with y < 0 or y >= IndexedRows() are not in the index
+    int IndexedRows() const { return (int) m_rows.size(); }
+    const DefectRow& Row(int y) const { return m_rows[y]; }
+    // first entry in row y with x >= x
+    DefectRow::const_iterator RowLowerBound(int y, int x) const;
 };
 
+// a computation that can be done independently on horizontal bands of rows
+class RowBandTask
+{
+public:
+    virtual ~RowBandTask() { }
+    virtual void Run(int y0, int y1) = 0;
+};
+
+// number of bands to split an image of the given size into (1 for small images)
+extern int BandThreadCount(int pixels);
+// run task over rows [0, height) split into nbands bands, the first band on the calling thread
+extern void RunRowBands(RowBandTask& task, int height, int nbands);
+// stop the band worker threads; called when the app exits
+extern void StopRowBandThreads(void);
+
 extern bool QuickLRecon(usImage& img);
 extern bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect);
 extern bool Median3(usImage& img);
+// single pass, allocation-free computation of the raw and 3x3-median-filtered min and max over rect
+extern void CalcImageStats(const usImage& img, const wxRect& rect, int *min, int *max, int *filtMin, int *filtMax);
 extern bool SquarePixels(usImage& img, float xsize, float ysize);
 extern int dbl_sort_func(double *first, double *second);
 extern bool Subtract(usImage& light, const usImage& dark);
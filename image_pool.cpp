@@ -0,0 +1,144 @@
+/*
+ *  image_pool.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+ImagePool::ImagePool(unsigned int maxFree)
+    : m_maxFree(maxFree)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+ImagePool::~ImagePool()
+{
+    Trim();
+}
+
+usImage *ImagePool::Acquire(const wxSize& size)
+{
+    int const npixels = size.GetWidth() * size.GetHeight();
+    usImage *img = 0;
+
+    { // lock scope
+        wxCriticalSectionLocker lck(m_lock);
+
+        if (!m_free.empty())
+        {
+            // prefer an idle image whose buffer already matches the requested size
+            std::vector<usImage *>::iterator pos = m_free.end() - 1;
+            if (npixels)
+            {
+                for (std::vector<usImage *>::iterator it = m_free.begin(); it != m_free.end(); ++it)
+                {
+                    if ((*it)->NPixels == npixels)
+                    {
+                        pos = it;
+                        break;
+                    }
+                }
+            }
+            img = *pos;
+            m_free.erase(pos);
+        }
+
+        if (img && (!npixels || img->NPixels == npixels))
+            ++m_stats.hits;
+        else
+            ++m_stats.misses;
+
+        ++m_stats.outstanding;
+        unsigned int const total = m_stats.outstanding + m_free.size();
+        if (total > m_stats.peakBuffers)
+            m_stats.peakBuffers = total;
+    } // lock scope
+
+    // do the (possibly slow) allocation outside the lock
+
+    if (img)
+        img->ResetMetadata();
+    else
+        img = new usImage();
+
+    if (npixels)
+        img->Init(size);
+
+    return img;
+}
+
+void ImagePool::Release(usImage *img)
+{
+    if (!img)
+        return;
+
+    { // lock scope
+        wxCriticalSectionLocker lck(m_lock);
+
+        if (m_stats.outstanding > 0)
+            --m_stats.outstanding;
+
+        if (img->ImageData && m_free.size() < m_maxFree)
+        {
+            m_free.push_back(img);
+            return;
+        }
+    } // lock scope
+
+    delete img;
+}
+
+void ImagePool::Trim()
+{
+    std::vector<usImage *> tmp;
+
+    { // lock scope
+        wxCriticalSectionLocker lck(m_lock);
+        tmp.swap(m_free);
+    } // lock scope
+
+    for (std::vector<usImage *>::iterator it = tmp.begin(); it != tmp.end(); ++it)
+        delete *it;
+}
+
+ImagePoolStats ImagePool::GetStats()
+{
+    wxCriticalSectionLocker lck(m_lock);
+    return m_stats;
+}
+
+void ImagePool::LogStats(const wxString& context)
+{
+    ImagePoolStats const stats = GetStats();
+    Debug.AddLine(wxString::Format("ImagePool %s: hits=%u misses=%u outstanding=%u peak=%u", context,
+        stats.hits, stats.misses, stats.outstanding, stats.peakBuffers));
+}
@@ -0,0 +1,98 @@
+/*
+ *  image_pool.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef IMAGE_POOL_INCLUDED
+#define IMAGE_POOL_INCLUDED
+
+struct ImagePoolStats
+{
+    unsigned int hits;          // acquired a recycled image with a buffer of the right size
+    unsigned int misses;        // had to allocate (or re-allocate) an image buffer
+    unsigned int outstanding;   // images currently handed out
+    unsigned int peakBuffers;   // high-water mark of outstanding + free images
+};
+
+/*
+ * ImagePool hands out usImage objects with pre-allocated image buffers and takes them back
+ * when they are no longer needed, so the per-frame exposure loop does not have to allocate
+ * and first-touch a multi-megabyte buffer for every frame.
+ *
+ * The pool is shared by the main thread (guider, OnExposeComplete) and the worker threads
+ * (capture, noise reduction, dark subtraction), so all access is serialized by a critical
+ * section. At most maxFree idle images are retained; any more are freed on release.
+ */
+class ImagePool
+{
+    wxCriticalSection m_lock;
+    std::vector<usImage *> m_free;
+    unsigned int m_maxFree;
+    ImagePoolStats m_stats;
+
+    ImagePool(const ImagePool&); // not implemented
+    ImagePool& operator=(const ImagePool&); // not implemented
+
+public:
+
+    ImagePool(unsigned int maxFree);
+    ~ImagePool();
+
+    // get an image; if size is non-empty the image buffer is sized for it
+    usImage *Acquire(const wxSize& size = wxSize(0, 0));
+    // return an image to the pool. The pool takes ownership.
+    void Release(usImage *img);
+    // free all idle images
+    void Trim();
+
+    ImagePoolStats GetStats();
+    void LogStats(const wxString& context);
+};
+
+// Scoped temporary image borrowed from a pool
+class PooledImage
+{
+    ImagePool& m_pool;
+    usImage *m_img;
+
+    PooledImage(const PooledImage&); // not implemented
+    PooledImage& operator=(const PooledImage&); // not implemented
+
+public:
+    PooledImage(ImagePool& pool, const wxSize& size) : m_pool(pool), m_img(pool.Acquire(size)) { }
+    ~PooledImage() { m_pool.Release(m_img); }
+    usImage& operator*() const { return *m_img; }
+    usImage *operator->() const { return m_img; }
+    usImage *get() const { return m_img; }
+};
+
+#endif // IMAGE_POOL_INCLUDED
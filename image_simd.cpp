@@ -0,0 +1,621 @@
+/*
+ *  image_simd.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// This file does not depend on wxWidgets or the rest of PHD2 so that it can also
+// be built into the standalone kernel benchmark, tools/image_bench.cpp
+#include "image_simd.h"
+
+#include <algorithm>
+#include <stddef.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+# define PHD_SIMD_X86 1
+#endif
+
+#if defined(PHD_SIMD_X86)
+# if defined(_MSC_VER)
+#  include <intrin.h>
+#  define TARGET_SSE2
+#  define TARGET_AVX2
+# else
+#  include <cpuid.h>
+#  define TARGET_SSE2 __attribute__((target("sse2")))
+#  define TARGET_AVX2 __attribute__((target("avx2")))
+# endif
+# include <immintrin.h>
+#endif
+
+// ----- scalar kernels -----
+
+static unsigned short DarkDeficit_Scalar(const unsigned short *l, const unsigned short *d, int n)
+{
+    unsigned int m = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (d[i] > l[i])
+        {
+            unsigned int const v = (unsigned int) d[i] - (unsigned int) l[i];
+            if (v > m)
+                m = v;
+        }
+    }
+    return (unsigned short) m;
+}
+
+static void DarkSubtract_Scalar(unsigned short *l, const unsigned short *d, int n, unsigned short offset)
+{
+    for (int i = 0; i < n; i++)
+    {
+        int v = (int) l[i] - (int) d[i] + (int) offset;
+        if (v > 65535) v = 65535;
+        l[i] = (unsigned short) v;
+    }
+}
+
+// The 3x3 median is computed by sorting each column of three, then taking the median of the
+// largest of the column minimums, the median of the column medians, and the smallest of the
+// column maximums. This is exact and uses only min and max, so it maps directly onto SIMD.
+
+inline static void sort2(unsigned int& a, unsigned int& b)
+{
+    unsigned int const t = std::min(a, b);
+    b = std::max(a, b);
+    a = t;
+}
+
+inline static unsigned int med3(unsigned int a, unsigned int b, unsigned int c)
+{
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+static void Median3x3_Scalar(unsigned short *dst, const unsigned short *r0, const unsigned short *r1, const unsigned short *r2, int n)
+{
+    unsigned int lo[3], mid[3], hi[3];
+
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            unsigned int a = r0[i + j], b = r1[i + j], c = r2[i + j];
+            sort2(a, b);
+            sort2(b, c);
+            sort2(a, b);
+            lo[j] = a; mid[j] = b; hi[j] = c;
+        }
+        unsigned int const maxlo = std::max(std::max(lo[0], lo[1]), lo[2]);
+        unsigned int const minhi = std::min(std::min(hi[0], hi[1]), hi[2]);
+        dst[i] = (unsigned short) med3(maxlo, med3(mid[0], mid[1], mid[2]), minhi);
+    }
+}
+
+// The threshold masks compare in integers: for a 16-bit pixel p, p > t exactly when p >= the
+// value returned here (65536 when no pixel can be above t)
+
+static unsigned int LowestAbove(double t)
+{
+    if (t < 0.0)
+        return 0;
+    if (!(t < 65535.0))
+        return 65536;
+    return (unsigned int) t + 1;
+}
+
+// clears the count * words mask words and converts the thresholds
+static void ThresholdMaskSetup(unsigned int *bits, int words, const double *thresh, int count, unsigned int *lo)
+{
+    // unused thresholds match no pixels
+    for (int k = 0; k < 4; k++)
+        lo[k] = k < count ? LowestAbove(thresh[k]) : 65536;
+    for (int w = 0; w < count * words; w++)
+        bits[w] = 0;
+}
+
+static void ThresholdMaskRange(unsigned int *bits, int words, const unsigned short *src, int start, int n,
+                               const unsigned int *lo, int count)
+{
+    // one word of each mask at a time, so that the bits are collected in registers
+    for (int j = start; j < n; )
+    {
+        int const w = j >> 5;
+        int const end = std::min(n, (w + 1) * 32);
+        unsigned int m0 = 0, m1 = 0, m2 = 0, m3 = 0;
+        for (; j < end; j++)
+        {
+            unsigned int const p = src[j];
+            int const s = j & 31;
+            m0 |= (unsigned int) (p >= lo[0]) << s;
+            m1 |= (unsigned int) (p >= lo[1]) << s;
+            m2 |= (unsigned int) (p >= lo[2]) << s;
+            m3 |= (unsigned int) (p >= lo[3]) << s;
+        }
+        unsigned int const m[4] = { m0, m1, m2, m3 };
+        for (int k = 0; k < count; k++)
+            bits[k * words + w] |= m[k];
+    }
+}
+
+static void ThresholdMask_Scalar(unsigned int *bits, const unsigned short *src, int n, const double *thresh, int count)
+{
+    int const words = (n + 31) / 32;
+    unsigned int lo[4];
+    ThresholdMaskSetup(bits, words, thresh, count, lo);
+    ThresholdMaskRange(bits, words, src, 0, n, lo, count);
+}
+
+// The float kernels do a separate multiply and add (no FMA) so that all implementations round
+// the same way.
+
+static void FloatMulAdd_Scalar(float *d, const float *v, float w, int n)
+{
+    for (int i = 0; i < n; i++)
+        d[i] += w * v[i];
+}
+
+static void FloatMirrorMulAdd_Scalar(float *d, const float *v, int k, float w, int n)
+{
+    for (int i = 0; i < n; i++)
+        d[i] += w * (v[i - k] + v[i + k]);
+}
+
+static void StretchToRGB_Scalar(unsigned char *rgb, const unsigned short *src, const unsigned char *lut, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        unsigned char const v = lut[src[i]];
+        *rgb++ = v;
+        *rgb++ = v;
+        *rgb++ = v;
+    }
+}
+
+#if defined(PHD_SIMD_X86)
+
+// ----- SSE2 kernels -----
+
+TARGET_SSE2
+static unsigned short DarkDeficit_SSE2(const unsigned short *l, const unsigned short *d, int n)
+{
+    // SSE2 has no unsigned 16-bit max, so bias the values into signed range
+    __m128i const bias = _mm_set1_epi16((short) 0x8000);
+    __m128i acc = bias;
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i const vl = _mm_loadu_si128((const __m128i *)(l + i));
+        __m128i const vd = _mm_loadu_si128((const __m128i *)(d + i));
+        acc = _mm_max_epi16(acc, _mm_xor_si128(_mm_subs_epu16(vd, vl), bias));
+    }
+    unsigned short tmp[8];
+    _mm_storeu_si128((__m128i *) tmp, _mm_xor_si128(acc, bias));
+    unsigned short m = DarkDeficit_Scalar(l + i, d + i, n - i);
+    for (int j = 0; j < 8; j++)
+        if (tmp[j] > m)
+            m = tmp[j];
+    return m;
+}
+
+TARGET_SSE2
+static void DarkSubtract_SSE2(unsigned short *l, const unsigned short *d, int n, unsigned short offset)
+{
+    // since offset >= d - l for every pixel, l - d + offset can be computed exactly with
+    // saturating arithmetic: at most one of sat(l - d) and sat(d - l) is non-zero, so
+    // result = sat(sat(l - d) + offset) - sat(d - l)
+    __m128i const off = _mm_set1_epi16((short) offset);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i const vl = _mm_loadu_si128((const __m128i *)(l + i));
+        __m128i const vd = _mm_loadu_si128((const __m128i *)(d + i));
+        __m128i const v = _mm_subs_epu16(_mm_adds_epu16(_mm_subs_epu16(vl, vd), off), _mm_subs_epu16(vd, vl));
+        _mm_storeu_si128((__m128i *)(l + i), v);
+    }
+    DarkSubtract_Scalar(l + i, d + i, n - i, offset);
+}
+
+TARGET_SSE2
+static void ThresholdMask_SSE2(unsigned int *bits, const unsigned short *src, int n, const double *thresh, int count)
+{
+    int const words = (n + 31) / 32;
+    unsigned int lo[4];
+    ThresholdMaskSetup(bits, words, thresh, count, lo);
+
+    // p >= lo exactly when sat(lo - p) == 0; a threshold with lo == 65536 sets no bits
+    __m128i const zero = _mm_setzero_si128();
+    __m128i lov[4];
+    for (int k = 0; k < count; k++)
+        lov[k] = _mm_set1_epi16((short) lo[k]);
+
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i const a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i const b = _mm_loadu_si128((const __m128i *)(src + i + 8));
+        for (int k = 0; k < count; k++)
+        {
+            if (lo[k] > 65535)
+                continue;
+            __m128i const ma = _mm_cmpeq_epi16(_mm_subs_epu16(lov[k], a), zero);
+            __m128i const mb = _mm_cmpeq_epi16(_mm_subs_epu16(lov[k], b), zero);
+            unsigned int const m = (unsigned int) _mm_movemask_epi8(_mm_packs_epi16(ma, mb));
+            bits[k * words + (i >> 5)] |= m << (i & 31);
+        }
+    }
+    ThresholdMaskRange(bits, words, src, i, n, lo, count);
+}
+
+// SSE2 only has signed 16-bit min/max, so the median is computed on values biased by 0x8000
+#define SSE2_SORT2(a, b) { __m128i const t_ = _mm_min_epi16(a, b); b = _mm_max_epi16(a, b); a = t_; }
+#define SSE2_MED3(a, b, c) _mm_max_epi16(_mm_min_epi16(a, b), _mm_min_epi16(_mm_max_epi16(a, b), c))
+
+TARGET_SSE2
+static void Median3x3_SSE2(unsigned short *dst, const unsigned short *r0, const unsigned short *r1, const unsigned short *r2, int n)
+{
+    __m128i const bias = _mm_set1_epi16((short) 0x8000);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i lo[3], mid[3], hi[3];
+        for (int j = 0; j < 3; j++)
+        {
+            __m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(r0 + i + j)), bias);
+            __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(r1 + i + j)), bias);
+            __m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(r2 + i + j)), bias);
+            SSE2_SORT2(a, b);
+            SSE2_SORT2(b, c);
+            SSE2_SORT2(a, b);
+            lo[j] = a; mid[j] = b; hi[j] = c;
+        }
+        __m128i const maxlo = _mm_max_epi16(_mm_max_epi16(lo[0], lo[1]), lo[2]);
+        __m128i const minhi = _mm_min_epi16(_mm_min_epi16(hi[0], hi[1]), hi[2]);
+        __m128i const medmid = SSE2_MED3(mid[0], mid[1], mid[2]);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(SSE2_MED3(maxlo, medmid, minhi), bias));
+    }
+    Median3x3_Scalar(dst + i, r0 + i, r1 + i, r2 + i, n - i);
+}
+
+#undef SSE2_SORT2
+#undef SSE2_MED3
+
+TARGET_SSE2
+static void FloatMulAdd_SSE2(float *d, const float *v, float w, int n)
+{
+    __m128 const wv = _mm_set1_ps(w);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(d + i, _mm_add_ps(_mm_loadu_ps(d + i), _mm_mul_ps(wv, _mm_loadu_ps(v + i))));
+    FloatMulAdd_Scalar(d + i, v + i, w, n - i);
+}
+
+TARGET_SSE2
+static void FloatMirrorMulAdd_SSE2(float *d, const float *v, int k, float w, int n)
+{
+    __m128 const wv = _mm_set1_ps(w);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 const s = _mm_add_ps(_mm_loadu_ps(v + i - k), _mm_loadu_ps(v + i + k));
+        _mm_storeu_ps(d + i, _mm_add_ps(_mm_loadu_ps(d + i), _mm_mul_ps(wv, s)));
+    }
+    FloatMirrorMulAdd_Scalar(d + i, v + i, k, w, n - i);
+}
+
+// ----- AVX2 kernels -----
+
+TARGET_AVX2
+static unsigned short DarkDeficit_AVX2(const unsigned short *l, const unsigned short *d, int n)
+{
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i const vl = _mm256_loadu_si256((const __m256i *)(l + i));
+        __m256i const vd = _mm256_loadu_si256((const __m256i *)(d + i));
+        acc = _mm256_max_epu16(acc, _mm256_subs_epu16(vd, vl));
+    }
+    unsigned short tmp[16];
+    _mm256_storeu_si256((__m256i *) tmp, acc);
+    unsigned short m = DarkDeficit_Scalar(l + i, d + i, n - i);
+    for (int j = 0; j < 16; j++)
+        if (tmp[j] > m)
+            m = tmp[j];
+    return m;
+}
+
+TARGET_AVX2
+static void DarkSubtract_AVX2(unsigned short *l, const unsigned short *d, int n, unsigned short offset)
+{
+    __m256i const off = _mm256_set1_epi16((short) offset);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i const vl = _mm256_loadu_si256((const __m256i *)(l + i));
+        __m256i const vd = _mm256_loadu_si256((const __m256i *)(d + i));
+        __m256i const v = _mm256_subs_epu16(_mm256_adds_epu16(_mm256_subs_epu16(vl, vd), off), _mm256_subs_epu16(vd, vl));
+        _mm256_storeu_si256((__m256i *)(l + i), v);
+    }
+    DarkSubtract_Scalar(l + i, d + i, n - i, offset);
+}
+
+TARGET_AVX2
+static void ThresholdMask_AVX2(unsigned int *bits, const unsigned short *src, int n, const double *thresh, int count)
+{
+    int const words = (n + 31) / 32;
+    unsigned int lo[4];
+    ThresholdMaskSetup(bits, words, thresh, count, lo);
+
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i lov[4];
+    for (int k = 0; k < count; k++)
+        lov[k] = _mm256_set1_epi16((short) lo[k]);
+
+    int i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i const a = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i const b = _mm256_loadu_si256((const __m256i *)(src + i + 16));
+        for (int k = 0; k < count; k++)
+        {
+            if (lo[k] > 65535)
+                continue;
+            __m256i const ma = _mm256_cmpeq_epi16(_mm256_subs_epu16(lov[k], a), zero);
+            __m256i const mb = _mm256_cmpeq_epi16(_mm256_subs_epu16(lov[k], b), zero);
+            // packs works within 128-bit lanes, permute the 64-bit quarters back into pixel order
+            __m256i const m = _mm256_permute4x64_epi64(_mm256_packs_epi16(ma, mb), 0xd8);
+            bits[k * words + (i >> 5)] = (unsigned int) _mm256_movemask_epi8(m);
+        }
+    }
+    // the compiler does not always clear the upper halves here (lov is kept in memory), and the
+    // caller's scalar double math would pay the AVX to SSE transition on every instruction
+    _mm256_zeroupper();
+    ThresholdMaskRange(bits, words, src, i, n, lo, count);
+}
+
+#define AVX2_SORT2(a, b) { __m256i const t_ = _mm256_min_epu16(a, b); b = _mm256_max_epu16(a, b); a = t_; }
+#define AVX2_MED3(a, b, c) _mm256_max_epu16(_mm256_min_epu16(a, b), _mm256_min_epu16(_mm256_max_epu16(a, b), c))
+
+TARGET_AVX2
+static void Median3x3_AVX2(unsigned short *dst, const unsigned short *r0, const unsigned short *r1, const unsigned short *r2, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i lo[3], mid[3], hi[3];
+        for (int j = 0; j < 3; j++)
+        {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(r0 + i + j));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(r1 + i + j));
+            __m256i c = _mm256_loadu_si256((const __m256i *)(r2 + i + j));
+            AVX2_SORT2(a, b);
+            AVX2_SORT2(b, c);
+            AVX2_SORT2(a, b);
+            lo[j] = a; mid[j] = b; hi[j] = c;
+        }
+        __m256i const maxlo = _mm256_max_epu16(_mm256_max_epu16(lo[0], lo[1]), lo[2]);
+        __m256i const minhi = _mm256_min_epu16(_mm256_min_epu16(hi[0], hi[1]), hi[2]);
+        __m256i const medmid = AVX2_MED3(mid[0], mid[1], mid[2]);
+        _mm256_storeu_si256((__m256i *)(dst + i), AVX2_MED3(maxlo, medmid, minhi));
+    }
+    Median3x3_SSE2(dst + i, r0 + i, r1 + i, r2 + i, n - i);
+}
+
+#undef AVX2_SORT2
+#undef AVX2_MED3
+
+TARGET_AVX2
+static void FloatMulAdd_AVX2(float *d, const float *v, float w, int n)
+{
+    __m256 const wv = _mm256_set1_ps(w);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(d + i), _mm256_mul_ps(wv, _mm256_loadu_ps(v + i))));
+    FloatMulAdd_Scalar(d + i, v + i, w, n - i);
+}
+
+TARGET_AVX2
+static void FloatMirrorMulAdd_AVX2(float *d, const float *v, int k, float w, int n)
+{
+    __m256 const wv = _mm256_set1_ps(w);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 const s = _mm256_add_ps(_mm256_loadu_ps(v + i - k), _mm256_loadu_ps(v + i + k));
+        _mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(d + i), _mm256_mul_ps(wv, s)));
+    }
+    FloatMirrorMulAdd_Scalar(d + i, v + i, k, w, n - i);
+}
+
+// SSE2 has no gather or byte shuffle, so the SSE2 table entry uses the scalar stretch
+
+TARGET_AVX2
+static void StretchToRGB_AVX2(unsigned char *rgb, const unsigned short *src, const unsigned char *lut, int n)
+{
+    // gather 32 bits at lut + src[i] and keep the low byte; the caller pads the table so
+    // the reads past entry 65535 stay in bounds
+    __m256i const lowByte = _mm256_set1_epi32(0xff);
+    __m128i const rgb0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    __m128i const rgb1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    __m128i const rgb2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    int const *base = (int const *) lut;
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i const idx0 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        __m256i const idx1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + i + 8)));
+        __m256i const v0 = _mm256_and_si256(_mm256_i32gather_epi32(base, idx0, 1), lowByte);
+        __m256i const v1 = _mm256_and_si256(_mm256_i32gather_epi32(base, idx1, 1), lowByte);
+        // packus works within 128-bit lanes, permute the 64-bit quarters back into pixel order
+        __m256i const w = _mm256_permute4x64_epi64(_mm256_packus_epi32(v0, v1), 0xd8);
+        __m128i const g = _mm_packus_epi16(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+        _mm_storeu_si128((__m128i *)(rgb + 0), _mm_shuffle_epi8(g, rgb0));
+        _mm_storeu_si128((__m128i *)(rgb + 16), _mm_shuffle_epi8(g, rgb1));
+        _mm_storeu_si128((__m128i *)(rgb + 32), _mm_shuffle_epi8(g, rgb2));
+        rgb += 48;
+    }
+    StretchToRGB_Scalar(rgb, src + i, lut, n - i);
+}
+
+static void cpuid(unsigned int info[4], unsigned int leaf, unsigned int subleaf)
+{
+#if defined(_MSC_VER)
+    __cpuidex((int *) info, (int) leaf, (int) subleaf);
+#else
+    __cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+static unsigned long long xgetbv0(void)
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long) edx << 32) | eax;
+#endif
+}
+
+static SimdLevel DetectSimdLevel(void)
+{
+    unsigned int info[4];
+
+    cpuid(info, 0, 0);
+    unsigned int const maxLeaf = info[0];
+    if (maxLeaf < 1)
+        return SIMD_NONE;
+
+    cpuid(info, 1, 0);
+    bool const sse2 = (info[3] & (1 << 26)) != 0;
+    bool const osxsave = (info[2] & (1 << 27)) != 0;
+    bool const avx = (info[2] & (1 << 28)) != 0;
+
+    if (!sse2)
+        return SIMD_NONE;
+
+    if (maxLeaf >= 7 && osxsave && avx)
+    {
+        // the OS must save the YMM registers on context switch
+        if ((xgetbv0() & 0x6) == 0x6)
+        {
+            cpuid(info, 7, 0);
+            if (info[1] & (1 << 5))
+                return SIMD_AVX2;
+        }
+    }
+
+    return SIMD_SSE2;
+}
+
+#else // PHD_SIMD_X86
+
+static SimdLevel DetectSimdLevel(void)
+{
+    return SIMD_NONE;
+}
+
+#endif // PHD_SIMD_X86
+
+static ImageKernels s_kernels[] =
+{
+    { SIMD_NONE, DarkDeficit_Scalar, DarkSubtract_Scalar, Median3x3_Scalar,
+      FloatMulAdd_Scalar, FloatMirrorMulAdd_Scalar, StretchToRGB_Scalar, ThresholdMask_Scalar },
+#if defined(PHD_SIMD_X86)
+    { SIMD_SSE2, DarkDeficit_SSE2, DarkSubtract_SSE2, Median3x3_SSE2,
+      FloatMulAdd_SSE2, FloatMirrorMulAdd_SSE2, StretchToRGB_Scalar, ThresholdMask_SSE2 },
+    { SIMD_AVX2, DarkDeficit_AVX2, DarkSubtract_AVX2, Median3x3_AVX2,
+      FloatMulAdd_AVX2, FloatMirrorMulAdd_AVX2, StretchToRGB_AVX2, ThresholdMask_AVX2 },
+#endif
+};
+
+// detected once during static initialization, before any worker threads are started
+static SimdLevel s_cpuLevel = DetectSimdLevel();
+
+SimdLevel GetCpuSimdLevel(void)
+{
+    return s_cpuLevel;
+}
+
+const char *SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SIMD_SSE2: return "SSE2";
+        case SIMD_AVX2: return "AVX2";
+        default:        return "none";
+    }
+}
+
+const ImageKernels& GetImageKernels(SimdLevel level)
+{
+    if (level > s_cpuLevel)
+        level = s_cpuLevel;
+    return s_kernels[level];
+}
+
+const ImageKernels& GetImageKernels(void)
+{
+    return s_kernels[s_cpuLevel];
+}
+
+// index of the lowest set bit of a non-zero word
+static int LowestBit(unsigned int b)
+{
+    static const int s_debruijn[32] =
+    {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9,
+    };
+    return s_debruijn[((b & (0u - b)) * 0x077CB531u) >> 27];
+}
+
+void MaskedCentroid(const unsigned short *win, int width, int n, int x0, int y0,
+                    const unsigned int *bits, double thresh, double *mass, double *mx, double *my)
+{
+    // a set bit means pixel > thresh, so val > 0 for exactly these pixels
+    double m = *mass, sx = *mx, sy = *my;
+    int const words = (n + 31) / 32;
+    for (int w = 0; w < words; w++)
+    {
+        for (unsigned int b = bits[w]; b != 0; b &= b - 1)
+        {
+            int const j = w * 32 + LowestBit(b);
+            double const val = (double) win[j] - thresh;
+            sx += (double) (x0 + j % width) * val;
+            sy += (double) (y0 + j / width) * val;
+            m += val;
+        }
+    }
+    *mass = m;
+    *mx = sx;
+    *my = sy;
+}
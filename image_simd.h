@@ -0,0 +1,86 @@
+/*
+ *  image_simd.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef IMAGE_SIMD_INCLUDED
+#define IMAGE_SIMD_INCLUDED
+
+/*
+ * Row kernels for the per-frame image processing hot paths. Each kernel has a scalar
+ * implementation and, on x86, SSE2 and AVX2 implementations. The best implementation
+ * supported by the CPU is selected once at startup; all implementations produce
+ * bit-identical results.
+ */
+
+enum SimdLevel
+{
+    SIMD_NONE,
+    SIMD_SSE2,
+    SIMD_AVX2,
+};
+
+struct ImageKernels
+{
+    SimdLevel level;
+
+    // returns max(dark[i] - light[i], 0) over the row
+    unsigned short (*darkDeficit)(const unsigned short *light, const unsigned short *dark, int n);
+    // light[i] = min(light[i] - dark[i] + offset, 65535); offset must be >= the row's darkDeficit
+    void (*darkSubtract)(unsigned short *light, const unsigned short *dark, int n, unsigned short offset);
+    // dst[i] = median of the 3x3 neighborhood r0[i..i+2], r1[i..i+2], r2[i..i+2]
+    void (*median3x3)(unsigned short *dst, const unsigned short *r0, const unsigned short *r1, const unsigned short *r2, int n);
+    // d[i] += w * v[i]
+    void (*floatMulAdd)(float *d, const float *v, float w, int n);
+    // d[i] += w * (v[i - k] + v[i + k])
+    void (*floatMirrorMulAdd)(float *d, const float *v, int k, float w, int n);
+    // rgb[3i] = rgb[3i+1] = rgb[3i+2] = lut[src[i]]; lut must be readable 3 bytes past entry 65535
+    void (*stretchToRGB)(unsigned char *rgb, const unsigned short *src, const unsigned char *lut, int n);
+    // bit j % 32 of bits[k * ((n + 31) / 32) + j / 32] = src[j] > thresh[k], for k < count <= 4
+    void (*thresholdMask)(unsigned int *bits, const unsigned short *src, int n, const double *thresh, int count);
+};
+
+extern SimdLevel GetCpuSimdLevel(void);
+extern const char *SimdLevelName(SimdLevel level);
+
+// kernels for the best SIMD level supported by this CPU
+extern const ImageKernels& GetImageKernels(void);
+// kernels for a specific SIMD level (or the best available level if the CPU does not support it)
+extern const ImageKernels& GetImageKernels(SimdLevel level);
+
+// Star::Find centroid sums over the pixels of a window (n pixels, width wide, first pixel at
+// (x0, y0)) that have their bit set in one threshold's thresholdMask bits. In pixel order,
+// val = pixel - thresh, mass += val, mx += x * val, my += y * val
+extern void MaskedCentroid(const unsigned short *win, int width, int n, int x0, int y0,
+                           const unsigned int *bits, double thresh, double *mass, double *mx, double *my);
+
+#endif // IMAGE_SIMD_INCLUDED
@@ -456,6 +456,8 @@ Mount::Mount(void)
 {
     m_connected = false;
     m_requestCount = 0;
+    m_lastMoveStart = 0;
+    m_lastMoveEnd = 0;
 
     m_pYGuideAlgorithm = NULL;
     m_pXGuideAlgorithm = NULL;
@@ -580,7 +582,7 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, bool norma
         double xDistance = mountVectorEndpoint.X;
         double yDistance = mountVectorEndpoint.Y;
 
-        Debug.AddLine(wxString::Format("Moving (%.2f, %.2f) raw xDistance=%.2f yDistance=%.2f",
+        DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_NORMAL).AddLine(wxString::Format("Moving (%.2f, %.2f) raw xDistance=%.2f yDistance=%.2f",
             cameraVectorEndpoint.X, cameraVectorEndpoint.Y, xDistance, yDistance));
 
         if (normalMove)
@@ -603,8 +605,10 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, bool norma
         GUIDE_DIRECTION yDirection = yDistance > 0.0 ? DOWN : UP;
 
         int requestedXAmount = (int) floor(fabs(xDistance / m_xRate) + 0.5);
+        int requestedYAmount = (int) floor(fabs(yDistance / m_cal.yRate) + 0.5);
         MoveResultInfo xMoveResult;
-        result = Move(xDirection, requestedXAmount, normalMove, &xMoveResult);
+        MoveResultInfo yMoveResult;
+        result = MoveAxes(xDirection, requestedXAmount, yDirection, requestedYAmount, normalMove, &xMoveResult, &yMoveResult);
 
         wxString msg;
 
@@ -614,30 +618,23 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, bool norma
                 fabs(xDistance), xMoveResult.amountMoved);
         }
 
-        MoveResultInfo yMoveResult;
-        if (result == MOVE_OK || result == MOVE_ERROR)
+        if (yMoveResult.amountMoved > 0)
         {
-            int requestedYAmount = (int) floor(fabs(yDistance / m_cal.yRate) + 0.5);
-            result = Move(yDirection, requestedYAmount, normalMove, &yMoveResult);
-
-            if (yMoveResult.amountMoved > 0)
-            {
-                msg = wxString::Format(_("%s%*s%s %.2f px %d ms"), msg,
-                    msg.IsEmpty() ? 42 : msg.Len() < 30 ? 30 - msg.Len() : 1, "",
-                    yDirection == SOUTH ? _("South") : _("North"),
-                    fabs(yDistance), yMoveResult.amountMoved);
-            }
+            msg = wxString::Format(_("%s%*s%s %.2f px %d ms"), msg,
+                msg.IsEmpty() ? 42 : msg.Len() < 30 ? 30 - msg.Len() : 1, "",
+                yDirection == SOUTH ? _("South") : _("North"),
+                fabs(yDistance), yMoveResult.amountMoved);
         }
 
         if (!msg.IsEmpty())
         {
             pFrame->SetStatusText(msg, 1);
-            Debug.AddLine(msg);
+            DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_NORMAL).AddLine(msg);
         }
 
         GuideStepInfo info;
         info.mount = this;
-        info.frameNumber = pFrame->m_frameCounter;
+        info.frameNumber = pFrame->FrameCounter();
         info.time = pFrame->TimeSinceGuidingStarted();
         info.cameraOffset = &cameraVectorEndpoint;
         info.mountOffset = &mountVectorEndpoint;
@@ -745,11 +742,11 @@ bool Mount::TransformCameraCoordinatesToMountCoordinates(const PHD_Point& camera
             sin(yAngle) * hyp
             );
 
-        Debug.AddLine("CameraToMount -- cameraTheta (%.2f) - m_xAngle (%.2f) = xAngle (%.2f = %.2f)",
+        DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine("CameraToMount -- cameraTheta (%.2f) - m_xAngle (%.2f) = xAngle (%.2f = %.2f)",
                 cameraTheta, m_cal.xAngle, xAngle, norm_angle(xAngle));
-        Debug.AddLine("CameraToMount -- cameraTheta (%.2f) - (m_xAngle (%.2f) + m_yAngleError (%.2f)) = yAngle (%.2f = %.2f)",
+        DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine("CameraToMount -- cameraTheta (%.2f) - (m_xAngle (%.2f) + m_yAngleError (%.2f)) = yAngle (%.2f = %.2f)",
                 cameraTheta, m_cal.xAngle, m_yAngleError, yAngle, norm_angle(yAngle));
-        Debug.AddLine("CameraToMount -- cameraX=%.2f cameraY=%.2f hyp=%.2f cameraTheta=%.2f mountX=%.2f mountY=%.2f, mountTheta=%.2f",
+        DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine("CameraToMount -- cameraX=%.2f cameraY=%.2f hyp=%.2f cameraTheta=%.2f mountX=%.2f mountY=%.2f, mountTheta=%.2f",
                 cameraVectorEndpoint.X, cameraVectorEndpoint.Y, hyp, cameraTheta, mountVectorEndpoint.X, mountVectorEndpoint.Y,
                 mountVectorEndpoint.Angle());
     }
@@ -790,9 +787,9 @@ bool Mount::TransformMountCoordinatesToCameraCoordinates(const PHD_Point& mountV
                 sin(xAngle) * hyp
                 );
 
-        Debug.AddLine("MountToCamera -- mountTheta (%.2f) + m_xAngle (%.2f) = xAngle (%.2f = %.2f)",
+        DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine("MountToCamera -- mountTheta (%.2f) + m_xAngle (%.2f) = xAngle (%.2f = %.2f)",
                 mountTheta, m_cal.xAngle, xAngle, norm_angle(xAngle));
-        Debug.AddLine("MountToCamera -- mountX=%.2f mountY=%.2f hyp=%.2f mountTheta=%.2f cameraX=%.2f, cameraY=%.2f cameraTheta=%.2f",
+        DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine("MountToCamera -- mountX=%.2f mountY=%.2f hyp=%.2f mountTheta=%.2f cameraX=%.2f, cameraY=%.2f cameraTheta=%.2f",
                 mountVectorEndpoint.X, mountVectorEndpoint.Y, hyp, mountTheta, cameraVectorEndpoint.X, cameraVectorEndpoint.Y,
                 cameraVectorEndpoint.Angle());
     }
@@ -893,11 +890,13 @@ void Mount::AdjustCalibrationForScopePointing(void)
 
 bool Mount::IsBusy(void)
 {
+    wxCriticalSectionLocker lock(m_requestLock);
     return m_requestCount > 0;
 }
 
 void Mount::IncrementRequestCount(void)
 {
+    wxCriticalSectionLocker lock(m_requestLock);
     m_requestCount++;
 
     // for the moment we never enqueue requests if the mount is busy, but we can
@@ -909,10 +908,49 @@ void Mount::IncrementRequestCount(void)
 
 void Mount::DecrementRequestCount(void)
 {
+    wxCriticalSectionLocker lock(m_requestLock);
     assert(m_requestCount > 0);
     m_requestCount--;
 }
 
+wxLongLong Mount::LastMoveEndTime(void) const
+{
+    wxCriticalSectionLocker lock(m_requestLock);
+    return m_lastMoveEnd;
+}
+
+void Mount::GetLastMoveTimes(wxLongLong *start, wxLongLong *end) const
+{
+    wxCriticalSectionLocker lock(m_requestLock);
+    *start = m_lastMoveStart;
+    *end = m_lastMoveEnd;
+}
+
+void Mount::SetLastMoveStartTime(const wxLongLong& t)
+{
+    wxCriticalSectionLocker lock(m_requestLock);
+    m_lastMoveStart = t;
+}
+
+void Mount::SetLastMoveEndTime(const wxLongLong& t)
+{
+    wxCriticalSectionLocker lock(m_requestLock);
+    m_lastMoveEnd = t;
+}
+
+Mount::MOVE_RESULT Mount::MoveAxes(GUIDE_DIRECTION xDirection, int xAmount, GUIDE_DIRECTION yDirection, int yAmount,
+                                   bool normalMove, MoveResultInfo *xMoveResult, MoveResultInfo *yMoveResult)
+{
+    MOVE_RESULT result = Move(xDirection, xAmount, normalMove, xMoveResult);
+
+    if (result == MOVE_OK || result == MOVE_ERROR)
+    {
+        result = Move(yDirection, yAmount, normalMove, yMoveResult);
+    }
+
+    return result;
+}
+
 bool Mount::HasNonGuiMove(void)
 {
     return false;
@@ -97,7 +97,10 @@ struct MoveResultInfo
 class Mount : public wxMessageBoxProxy
 {
     bool m_connected;
+    mutable wxCriticalSection m_requestLock; // guards the request count and the move times
     int m_requestCount;
+    wxLongLong m_lastMoveStart;
+    wxLongLong m_lastMoveEnd;
 
     bool m_calibrated;
     Calibration m_cal;
@@ -221,6 +224,19 @@ public:
     virtual void IncrementRequestCount(void);
     virtual void DecrementRequestCount(void);
 
+    // UTC ms when the last move request started and finished, written by the
+    // worker thread. The start is later than the end while a move is running.
+    wxLongLong LastMoveEndTime(void) const;
+    void GetLastMoveTimes(wxLongLong *start, wxLongLong *end) const;
+    void SetLastMoveStartTime(const wxLongLong& t);
+    void SetLastMoveEndTime(const wxLongLong& t);
+
+    // Send the RA (x) and Dec (y) parts of a guide correction. The default
+    // sends them one after the other; mounts that can pulse both axes at once
+    // override it so the correction takes max(x, y) instead of x + y.
+    virtual MOVE_RESULT MoveAxes(GUIDE_DIRECTION xDirection, int xAmount, GUIDE_DIRECTION yDirection, int yAmount,
+                                 bool normalMove, MoveResultInfo *xMoveResult, MoveResultInfo *yMoveResult);
+
     virtual bool HasNonGuiMove(void);
     virtual bool SynchronousOnly(void);
     virtual bool HasSetupDialog(void) const;
@@ -157,7 +157,8 @@ MyFrame::MyFrame(int instanceNumber, wxLocale *locale)
     : wxFrame(NULL, wxID_ANY, wxEmptyString),
     m_showBookmarksAccel(0),
     m_bookmarkLockPosAccel(0),
-    pStatsWin(0)
+    pStatsWin(0),
+    m_imagePool(3)
 {
     m_instanceNumber = instanceNumber;
     m_pLocale = locale;
@@ -166,6 +167,11 @@ MyFrame::MyFrame(int instanceNumber, wxLocale *locale)
 
     m_frameCounter = 0;
     m_loggedImageFrame = 0;
+    m_starSeed = StarSeed();
+    m_pProcessingThread = NULL;
+    StartProcessingThread();
+    m_pImageLogger = NULL;
+    StartImageLogger();
     m_pPrimaryWorkerThread = NULL;
     StartWorkerThread(m_pPrimaryWorkerThread);
     m_pSecondaryWorkerThread = NULL;
@@ -183,6 +189,7 @@ MyFrame::MyFrame(int instanceNumber, wxLocale *locale)
 
     m_image_logging_enabled = false;
     m_logged_image_format = (LOGGED_IMAGE_FORMAT) pConfig->Global.GetInt("/LoggedImageFormat", LIF_LOW_Q_JPEG);
+    m_logFullFrameImages = pConfig->Global.GetBoolean("/LogFullFrameImages", false);
 
     m_sampling = 1.0;
 
@@ -335,6 +342,8 @@ MyFrame::MyFrame(int instanceNumber, wxLocale *locale)
     m_continueCapturing = false;
     CaptureActive     = false;
     m_exposurePending = false;
+    m_exposurePipelined = false;
+    m_discardExposure = false;
 
     m_mgr.GetArtProvider()->SetMetric(wxAUI_DOCKART_GRADIENT_TYPE, wxAUI_GRADIENT_VERTICAL);
     m_mgr.GetArtProvider()->SetColor(wxAUI_DOCKART_INACTIVE_CAPTION_COLOUR, wxColour(0, 153, 255));
@@ -689,6 +698,24 @@ LOGGED_IMAGE_FORMAT MyFrame::GetLoggedImageFormat(void)
     return m_logged_image_format;
 }
 
+void MyFrame::SetLogFullFrameImages(bool val)
+{
+    pConfig->Global.SetBoolean("/LogFullFrameImages", val);
+    m_logFullFrameImages = val;
+}
+
+bool MyFrame::GetLogFullFrameImages(void) const
+{
+    return m_logFullFrameImages;
+}
+
+// Hands a copy of the star image (or the full frame) to the image logger thread
+void MyFrame::LogStarImage(const usImage& img, const PHD_Point& star, const PHD_Point& lockPos)
+{
+    if (m_pImageLogger)
+        m_pImageLogger->LogImage(img, star, lockPos, m_logged_image_format, m_logFullFrameImages);
+}
+
 Star::FindMode MyFrame::SetStarFindMode(Star::FindMode mode)
 {
     Star::FindMode prev = m_starFindMode;
@@ -715,6 +742,8 @@ enum {
 
 void MyFrame::LoadProfileSettings(void)
 {
+    Debug.LoadProfileSettings();
+
     int noiseReductionMethod = pConfig->Profile.GetInt("/NoiseReductionMethod", DefaultNoiseReductionMethod);
     SetNoiseReductionMethod(noiseReductionMethod);
 
@@ -729,6 +758,8 @@ void MyFrame::LoadProfileSettings(void)
 
     SetAutoLoadCalibration(pConfig->Profile.GetBoolean("/AutoLoadCalibration", false));
 
+    SetPipelinedCapture(pConfig->Profile.GetBoolean("/frame/pipelinedCapture", false));
+
     int focalLength = pConfig->Profile.GetInt("/frame/focalLength", DefaultFocalLength);
     SetFocalLength(focalLength);
 
@@ -1150,6 +1181,30 @@ bool MyFrame::StartWorkerThread(WorkerThread*& pWorkerThread)
     return bError;
 }
 
+// request latency statistics of the primary or secondary worker thread;
+// returns true if the thread is not running
+bool MyFrame::GetWorkerLatencyStats(bool secondary, WorkerLatencyStats *stats)
+{
+    wxCriticalSectionLocker lock(m_CSpWorkerThread);
+
+    WorkerThread *pWorkerThread = secondary ? m_pSecondaryWorkerThread : m_pPrimaryWorkerThread;
+    if (!pWorkerThread)
+        return true;
+
+    pWorkerThread->GetLatencyStats(stats);
+    return false;
+}
+
+void MyFrame::ResetWorkerLatencyStats(void)
+{
+    wxCriticalSectionLocker lock(m_CSpWorkerThread);
+
+    if (m_pPrimaryWorkerThread)
+        m_pPrimaryWorkerThread->ResetLatencyStats();
+    if (m_pSecondaryWorkerThread)
+        m_pSecondaryWorkerThread->ResetLatencyStats();
+}
+
 bool MyFrame::StopWorkerThread(WorkerThread*& pWorkerThread)
 {
     bool killed = false;
@@ -1198,6 +1253,114 @@ bool MyFrame::StopWorkerThread(WorkerThread*& pWorkerThread)
     return killed;
 }
 
+bool MyFrame::StartProcessingThread(void)
+{
+    bool bError = false;
+
+    try
+    {
+        Debug.AddLine("StartProcessingThread begins");
+
+        m_pProcessingThread = new ProcessingThread(this);
+
+        if (m_pProcessingThread->Create() != wxTHREAD_NO_ERROR)
+        {
+            throw ERROR_INFO("Could not Create() the processing thread!");
+        }
+
+        if (m_pProcessingThread->Run() != wxTHREAD_NO_ERROR)
+        {
+            throw ERROR_INFO("Could not Run() the processing thread!");
+        }
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        delete m_pProcessingThread;
+        m_pProcessingThread = NULL;
+        bError = true;
+    }
+
+    Debug.AddLine(wxString::Format("StartProcessingThread(0x%p) ends", m_pProcessingThread));
+
+    return bError;
+}
+
+void MyFrame::StopProcessingThread(void)
+{
+    Debug.AddLine(wxString::Format("StopProcessingThread(0x%p) begins", m_pProcessingThread));
+
+    if (m_pProcessingThread)
+    {
+        // the worker threads are stopped first, so no new frames can arrive
+        if (m_pProcessingThread->IsRunning())
+        {
+            m_pProcessingThread->EnqueueTerminateRequest();
+            wxThread::ExitCode threadExitCode = m_pProcessingThread->Wait();
+            Debug.AddLine("StopProcessingThread() threadExitCode=%d", threadExitCode);
+        }
+
+        delete m_pProcessingThread;
+        m_pProcessingThread = NULL;
+    }
+
+    Debug.AddLine("StopProcessingThread ends");
+}
+
+bool MyFrame::StartImageLogger(void)
+{
+    bool bError = false;
+
+    try
+    {
+        Debug.AddLine("StartImageLogger begins");
+
+        m_pImageLogger = new ImageLogger();
+
+        if (m_pImageLogger->Create() != wxTHREAD_NO_ERROR)
+        {
+            throw ERROR_INFO("Could not Create() the image logger thread!");
+        }
+
+        if (m_pImageLogger->Run() != wxTHREAD_NO_ERROR)
+        {
+            throw ERROR_INFO("Could not Run() the image logger thread!");
+        }
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        delete m_pImageLogger;
+        m_pImageLogger = NULL;
+        bError = true;
+    }
+
+    Debug.AddLine(wxString::Format("StartImageLogger(0x%p) ends", m_pImageLogger));
+
+    return bError;
+}
+
+void MyFrame::StopImageLogger(void)
+{
+    Debug.AddLine(wxString::Format("StopImageLogger(0x%p) begins", m_pImageLogger));
+
+    if (m_pImageLogger)
+    {
+        // frames still queued are written out before the thread exits
+        if (m_pImageLogger->IsRunning())
+        {
+            m_pImageLogger->EnqueueTerminateRequest();
+            wxThread::ExitCode threadExitCode = m_pImageLogger->Wait();
+            Debug.AddLine("StopImageLogger() threadExitCode=%d", threadExitCode);
+        }
+
+        delete m_pImageLogger;
+        m_pImageLogger = NULL;
+    }
+
+    Debug.AddLine("StopImageLogger ends");
+}
+
 void MyFrame::OnRequestExposure(wxCommandEvent& evt)
 {
     EXPOSE_REQUEST *req = (EXPOSE_REQUEST *) evt.GetClientData();
@@ -1244,14 +1407,95 @@ void MyFrame::ScheduleExposure(void)
 
     m_exposurePending = true;
 
-    usImage *img = new usImage();
+    PublishStarSeed();
+
+    usImage *img = m_imagePool.Acquire(pCamera->FullSize);
 
     wxCriticalSectionLocker lock(m_CSpWorkerThread);
     assert(m_pPrimaryWorkerThread);
     m_pPrimaryWorkerThread->EnqueueWorkerThreadExposeRequest(img, exposureDuration, exposureOptions, subframe);
 }
 
-void MyFrame::SchedulePrimaryMove(Mount *pMount, const PHD_Point& vectorEndpoint, bool normalMove)
+// make the guider's current star position available to the processing thread
+void MyFrame::PublishStarSeed(void)
+{
+    StarSeed seed = pGuider->GetStarSeed();
+    wxCriticalSectionLocker lock(m_starSeedLock);
+    m_starSeed = seed;
+}
+
+// The frame counter is advanced by the processing thread (Guider::GuideStep)
+// and read by the main and worker threads
+unsigned int MyFrame::FrameCounter(void)
+{
+    wxCriticalSectionLocker lock(m_frameCounterLock);
+    return m_frameCounter;
+}
+
+unsigned int MyFrame::IncrementFrameCounter(void)
+{
+    wxCriticalSectionLocker lock(m_frameCounterLock);
+    return ++m_frameCounter;
+}
+
+void MyFrame::ResetFrameCounter(void)
+{
+    wxCriticalSectionLocker lock(m_frameCounterLock);
+    m_frameCounter = 0;
+}
+
+StarSeed MyFrame::GetPublishedStarSeed(void)
+{
+    wxCriticalSectionLocker lock(m_starSeedLock);
+    return m_starSeed;
+}
+
+// true if the exposure being processed or captured now was started while the
+// previous frame was still being processed
+bool MyFrame::IsExposurePipelined(void)
+{
+    wxCriticalSectionLocker lock(m_CSpWorkerThread);
+    return m_exposurePipelined;
+}
+
+// An overlapped exposure still in flight was started before the guider state
+// changed, e.g. before calibration began; drop it when it arrives.
+void MyFrame::DiscardPipelinedExposure(void)
+{
+    wxCriticalSectionLocker lock(m_CSpWorkerThread);
+
+    if (m_exposurePending && m_exposurePipelined && !m_discardExposure)
+    {
+        Debug.AddLine("discarding the overlapped exposure in flight");
+        m_discardExposure = true;
+    }
+}
+
+// Overlapping the next exposure with the processing of the current frame only
+// pays off if the capture and the guide pulses both run off the main thread
+// and the pulses can be sent while the camera is exposing. Calibration and AO
+// bumps assume each frame follows the previous move, so they run serially.
+bool MyFrame::CanPipelineCapture(void)
+{
+    if (!m_pipelinedCapture || !m_continueCapturing)
+        return false;
+
+    if (!pCamera || !pCamera->HasNonGuiCapture())
+        return false;
+
+    if (pMount && pMount->IsConnected() && (!pMount->HasNonGuiMove() || pMount->SynchronousOnly()))
+        return false;
+
+    if (pSecondaryMount && pSecondaryMount->IsConnected())
+        return false;
+
+    GUIDER_STATE state = pGuider->GetState();
+    return state != STATE_CALIBRATING_PRIMARY && state != STATE_CALIBRATING_SECONDARY;
+}
+
+// frameEnd is the end of the exposure the correction was measured on, if
+// known; the worker thread logs the time from there to the guide pulse
+void MyFrame::SchedulePrimaryMove(Mount *pMount, const PHD_Point& vectorEndpoint, bool normalMove, const wxLongLong& frameEnd)
 {
     wxCriticalSectionLocker lock(m_CSpWorkerThread);
 
@@ -1260,8 +1504,21 @@ void MyFrame::SchedulePrimaryMove(Mount *pMount, const PHD_Point& vectorEndpoint
     assert(pMount);
     pMount->IncrementRequestCount();
 
+    if (m_exposurePipelined)
+    {
+        // the primary thread is busy with the overlapped exposure, or is about
+        // to start it: the guide step runs on the processing thread before the
+        // main thread schedules the next exposure. Send the correction to the
+        // secondary thread so it goes out now rather than after the exposure.
+        // CanPipelineCapture made sure there is no secondary mount using that
+        // thread.
+        assert(m_pSecondaryWorkerThread);
+        m_pSecondaryWorkerThread->EnqueueWorkerThreadMoveRequest(pMount, vectorEndpoint, normalMove, frameEnd);
+        return;
+    }
+
     assert(m_pPrimaryWorkerThread);
-    m_pPrimaryWorkerThread->EnqueueWorkerThreadMoveRequest(pMount, vectorEndpoint, normalMove);
+    m_pPrimaryWorkerThread->EnqueueWorkerThreadMoveRequest(pMount, vectorEndpoint, normalMove, frameEnd);
 }
 
 void MyFrame::ScheduleSecondaryMove(Mount *pMount, const PHD_Point& vectorEndpoint, bool normalMove)
@@ -1306,9 +1563,14 @@ void MyFrame::StartCapturing()
     {
         m_continueCapturing = true;
         CaptureActive     = true;
-        m_frameCounter = 0;
+        ResetFrameCounter();
         m_loggedImageFrame = 0;
 
+        {
+            wxCriticalSectionLocker lock(m_CSpWorkerThread);
+            m_discardExposure = false;
+        }
+
         CheckDarkFrameGeometry();
         UpdateButtonsStatus();
         SetStatusText(wxEmptyString);
@@ -1541,6 +1803,8 @@ void MyFrame::OnClose(wxCloseEvent& event)
     bool killed = StopWorkerThread(m_pPrimaryWorkerThread);
     if (StopWorkerThread(m_pSecondaryWorkerThread))
         killed = true;
+    StopProcessingThread();
+    StopImageLogger();
 
     // disconnect all gear
     pGearDialog->Shutdown(killed);
@@ -1657,6 +1921,17 @@ void MyFrame::SetAutoLoadCalibration(bool val)
     }
 }
 
+bool MyFrame::GetPipelinedCapture(void) const
+{
+    return m_pipelinedCapture;
+}
+
+void MyFrame::SetPipelinedCapture(bool val)
+{
+    m_pipelinedCapture = val;
+    pConfig->Profile.SetBoolean("/frame/pipelinedCapture", m_pipelinedCapture);
+}
+
 static void load_calibration(Mount *mnt)
 {
     wxString prefix = "/" + mnt->GetMountClassName() + "/calibration/";
@@ -2102,12 +2377,14 @@ wxString MyFrame::PixelScaleSummary(void) const
 wxString MyFrame::GetSettingsSummary()
 {
     // return a loggable summary of current global configs managed by MyFrame
-    return wxString::Format("Dither = %s, Dither scale = %.3f, Image noise reduction = %s, Guide-frame time lapse = %d, Server %s\n"
+    return wxString::Format("Dither = %s, Dither scale = %.3f, Image noise reduction = %s, Guide-frame time lapse = %d, "
+        "Overlapped exposures = %s, Server %s\n"
         "%s\n",
         m_ditherRaOnly ? "RA only" : "both axes",
         m_ditherScaleFactor,
         m_noiseReductionMethod == NR_NONE ? "none" : m_noiseReductionMethod == NR_2x2MEAN ? "2x2 mean" : "3x3 mean",
         m_timeLapse,
+        m_pipelinedCapture ? "enabled" : "disabled",
         m_serverMode ? "enabled" : "disabled",
         PixelScaleSummary()
     );
@@ -2174,6 +2451,13 @@ MyFrameConfigDialogPane::MyFrameConfigDialogPane(wxWindow *pParent, MyFrame *pFr
     DoAdd(_("Image logging format"), m_pLoggedImageFormat,
           _("File format of logged images"));
 
+    m_pLogFullFrames = new wxCheckBox(pParent, wxID_ANY, _("Log full frames"), wxDefaultPosition, wxDefaultSize);
+    DoAdd(m_pLogFullFrames, _("Log the whole guide frame rather than just the area around the guide star"));
+
+    m_pBinaryGuideLog = new wxCheckBox(pParent, wxID_ANY, _("Binary guide log"), wxDefaultPosition, wxDefaultSize);
+    DoAdd(m_pBinaryGuideLog, _("Write the guide log in the compact binary format. Use guidelog_convert to produce the text log. "
+        "Takes effect when the next guide log is started."));
+
     m_pDitherRaOnly = new wxCheckBox(pParent, wxID_ANY,_("Dither RA only"), wxPoint(-1,-1), wxSize(75,-1));
     DoAdd(m_pDitherRaOnly, _("Constrain dither to RA only?"));
 
@@ -2201,6 +2485,11 @@ MyFrameConfigDialogPane::MyFrameConfigDialogPane(wxWindow *pParent, MyFrame *pFr
     DoAdd(_("Time Lapse (ms)"), m_pTimeLapse,
           _("How long should PHD wait between guide frames? Default = 0ms, useful when using very short exposures (e.g., using a video camera) but wanting to send guide commands less frequently"));
 
+    m_pPipelinedCapture = new wxCheckBox(pParent, wxID_ANY, _("Overlap exposures"), wxDefaultPosition, wxDefaultSize);
+    DoAdd(m_pPipelinedCapture, _("Start the next exposure while the current frame is measured and the guide correction is sent. "
+        "Frames exposed before the correction finished are displayed but not used for guiding. "
+        "Not used during calibration, with an AO, or when guiding through the camera."));
+
     m_pFocalLength = new wxTextCtrl(pParent, wxID_ANY, _T("    "), wxDefaultPosition, wxSize(width+30, -1));
     DoAdd( _("Focal length (mm)"), m_pFocalLength,
            _("Guider telescope focal length, used with the camera pixel size to display guiding error in arc-sec."));
@@ -2303,10 +2592,13 @@ void MyFrameConfigDialogPane::LoadValues(void)
     m_pResetConfiguration->Enable(!pFrame->CaptureActive);
     m_pResetDontAskAgain->SetValue(false);
     m_pLoggedImageFormat->SetSelection(m_pFrame->GetLoggedImageFormat());
+    m_pLogFullFrames->SetValue(m_pFrame->GetLogFullFrameImages());
+    m_pBinaryGuideLog->SetValue(GuideLog.GetBinaryFormat());
     m_pNoiseReduction->SetSelection(m_pFrame->GetNoiseReductionMethod());
     m_pDitherRaOnly->SetValue(m_pFrame->GetDitherRaOnly());
     m_pDitherScaleFactor->SetValue(m_pFrame->GetDitherScaleFactor());
     m_pTimeLapse->SetValue(m_pFrame->GetTimeLapse());
+    m_pPipelinedCapture->SetValue(m_pFrame->GetPipelinedCapture());
     SetFocalLength(m_pFrame->GetFocalLength());
     m_pFocalLength->Enable(!pFrame->CaptureActive);
 
@@ -2356,10 +2648,13 @@ void MyFrameConfigDialogPane::UnloadValues(void)
         }
 
         m_pFrame->SetLoggedImageFormat((LOGGED_IMAGE_FORMAT) m_pLoggedImageFormat->GetSelection());
+        m_pFrame->SetLogFullFrameImages(m_pLogFullFrames->GetValue());
+        GuideLog.SetBinaryFormat(m_pBinaryGuideLog->GetValue());
         m_pFrame->SetNoiseReductionMethod(m_pNoiseReduction->GetSelection());
         m_pFrame->SetDitherRaOnly(m_pDitherRaOnly->GetValue());
         m_pFrame->SetDitherScaleFactor(m_pDitherScaleFactor->GetValue());
         m_pFrame->SetTimeLapse(m_pTimeLapse->GetValue());
+        m_pFrame->SetPipelinedCapture(m_pPipelinedCapture->GetValue());
 
         m_pFrame->SetFocalLength(GetFocalLength());
 
@@ -38,6 +38,9 @@
 #define MYFRAME_H_INCLUDED
 
 class WorkerThread;
+class ProcessingThread;
+class ImageLogger;
+struct WorkerLatencyStats;
 class MyFrame;
 class RefineDefMap;
 struct alert_params;
@@ -86,6 +89,8 @@ class MyFrameConfigDialogPane : public ConfigDialogPane
     wxCheckBox *m_pResetConfiguration;
     wxCheckBox *m_pResetDontAskAgain;
     wxChoice* m_pLoggedImageFormat;
+    wxCheckBox *m_pLogFullFrames;
+    wxCheckBox *m_pBinaryGuideLog;
     wxCheckBox *m_pDitherRaOnly;
     wxSpinCtrlDouble *m_pDitherScaleFactor;
     wxChoice *m_pNoiseReduction;
@@ -97,6 +102,7 @@ class MyFrameConfigDialogPane : public ConfigDialogPane
     wxTextCtrl *m_pLogDir;
     wxButton *m_pSelectDir;
     wxCheckBox *m_pAutoLoadCalibration;
+    wxCheckBox *m_pPipelinedCapture;
     wxComboBox *m_autoExpDurationMin;
     wxComboBox *m_autoExpDurationMax;
     wxSpinCtrlDouble *m_autoExpSNR;
@@ -131,14 +137,17 @@ protected:
     bool SetLanguage(int language);
 
     void SetAutoLoadCalibration(bool val);
+    void SetPipelinedCapture(bool val);
 
     friend class MyFrameConfigDialogPane;
     friend class WorkerThread;
+    friend class ProcessingThread;
 
 private:
     NOISE_REDUCTION_METHOD m_noiseReductionMethod;
     bool m_image_logging_enabled;
     LOGGED_IMAGE_FORMAT m_logged_image_format;
+    bool m_logFullFrameImages;
     double m_ditherScaleFactor;
     bool m_ditherRaOnly;
     bool m_serverMode;
@@ -146,6 +155,7 @@ private:
     int  m_focalLength;
     double m_sampling;
     bool m_autoLoadCalibration;
+    bool m_pipelinedCapture; // start the next exposure while the previous frame is processed
     int m_instanceNumber;
 
     wxAuiManager m_mgr;
@@ -192,14 +202,16 @@ public:
     wxDialog *pCalReviewDlg;
     bool CaptureActive; // Is camera looping captures?
     bool m_exposurePending; // exposure scheduled and not completed
+    bool m_exposurePipelined; // the pending exposure was started before the previous frame was processed; guarded by m_CSpWorkerThread
+    bool m_discardExposure; // the pending overlapped exposure predates a guider state change; guarded by m_CSpWorkerThread
     double Stretch_gamma;
     wxLocale *m_pLocale;
-    unsigned int m_frameCounter;
     unsigned int m_loggedImageFrame;
     wxDateTime m_guidingStarted;
     Star::FindMode m_starFindMode;
     bool m_rawImageMode;
     bool m_rawImageModeWarningDone;
+    ImagePool m_imagePool; // recycled image buffers for the exposure loop
 
     void RegisterTextCtrl(wxTextCtrl *ctrl);
     void OnQuit(wxCommandEvent& evt);
@@ -282,6 +294,9 @@ public:
     bool IsImageLoggingEnabled(void);
     void SetLoggedImageFormat(LOGGED_IMAGE_FORMAT val);
     LOGGED_IMAGE_FORMAT GetLoggedImageFormat(void);
+    void SetLogFullFrameImages(bool val);
+    bool GetLogFullFrameImages(void) const;
+    void LogStarImage(const usImage& img, const PHD_Point& star, const PHD_Point& lockPos);
     Star::FindMode GetStarFindMode(void) const;
     Star::FindMode SetStarFindMode(Star::FindMode mode);
     bool GetRawImageMode(void) const;
@@ -293,6 +308,16 @@ public:
     int GetFocalLength(void);
     int GetLanguage(void);
     bool GetAutoLoadCalibration(void);
+    bool GetPipelinedCapture(void) const;
+    void PublishStarSeed(void);
+    StarSeed GetPublishedStarSeed(void);
+    unsigned int FrameCounter(void);
+    unsigned int IncrementFrameCounter(void);
+    void ResetFrameCounter(void);
+    bool IsExposurePipelined(void);
+    void DiscardPipelinedExposure(void);
+    bool GetWorkerLatencyStats(bool secondary, WorkerLatencyStats *stats);
+    void ResetWorkerLatencyStats(void);
     void LoadCalibration(void);
     int GetInstanceNumber() const { return m_instanceNumber; }
     static wxString GetDefaultFileDir();
@@ -330,13 +355,14 @@ public:
         bool            normalMove;
         Mount::MOVE_RESULT moveResult;
         PHD_Point       vectorEndpoint;
+        wxLongLong_t    frameEndMs;     // end of the exposure the move corrects, 0 if unknown
         wxSemaphore     *pSemaphore;
     };
     void OnRequestMountMove(wxCommandEvent& evt);
 
     void ScheduleExposure(void);
 
-    void SchedulePrimaryMove(Mount *pMount, const PHD_Point& vectorEndpoint, bool normalMove=true);
+    void SchedulePrimaryMove(Mount *pMount, const PHD_Point& vectorEndpoint, bool normalMove=true, const wxLongLong& frameEnd=0);
     void ScheduleSecondaryMove(Mount *pMount, const PHD_Point& vectorEndpoint, bool normalMove=true);
     void ScheduleCalibrationMove(Mount *pMount, const GUIDE_DIRECTION direction, int duration);
 
@@ -368,6 +394,15 @@ private:
     wxCriticalSection m_CSpWorkerThread;
     WorkerThread *m_pPrimaryWorkerThread;
     WorkerThread *m_pSecondaryWorkerThread;
+    ProcessingThread *m_pProcessingThread;
+    ImageLogger *m_pImageLogger;
+
+    wxCriticalSection m_frameCounterLock;
+    unsigned int m_frameCounter;
+
+    // guide star position for the processing thread, see PublishStarSeed
+    wxCriticalSection m_starSeedLock;
+    StarSeed m_starSeed;
 
     wxSocketServer *SocketServer;
 
@@ -381,6 +416,11 @@ private:
 
     bool StartWorkerThread(WorkerThread*& pWorkerThread);
     bool StopWorkerThread(WorkerThread*& pWorkerThread);
+    bool StartProcessingThread(void);
+    void StopProcessingThread(void);
+    bool StartImageLogger(void);
+    void StopImageLogger(void);
+    bool CanPipelineCapture(void);
     void OnSetStatusText(wxThreadEvent& event);
     void DoAlert(const alert_params& params);
     void OnAlertButton(wxCommandEvent& evt);
@@ -559,6 +599,7 @@ enum {
     SOCK_SERVER_CLIENT_ID,
     EVENT_SERVER_ID,
     EVENT_SERVER_CLIENT_ID,
+    EVENT_SERVER_FLUSH_ID,
 };
 
 wxDECLARE_EVENT(APPSTATE_NOTIFY_EVENT, wxCommandEvent);
@@ -300,6 +300,10 @@ void MyFrame::FinishStop(void)
     UpdateButtonsStatus();
     SetStatusText(_("Stopped."));
     PhdController::AbortController("Stopped capturing");
+
+    // don't hold on to idle frame buffers while we are not capturing
+    m_imagePool.LogStats("capture stopped");
+    m_imagePool.Trim();
 }
 
 static wxString RawModeWarningKey(void)
@@ -344,18 +348,19 @@ void MyFrame::OnExposeComplete(wxThreadEvent& event)
 
         m_exposurePending = false;
 
-        usImage *pNewFrame = event.GetPayload<usImage *>();
+        ProcessedFrame frame = event.GetPayload<ProcessedFrame>();
+        usImage *pNewFrame = frame.pImage;
 
         if (pGuider->GetPauseType() == PAUSE_FULL)
         {
-            delete pNewFrame;
+            m_imagePool.Release(pNewFrame);
             Debug.AddLine("guider is paused, ignoring frame, not scheduling exposure");
             return;
         }
 
         if (event.GetInt())
         {
-            delete pNewFrame;
+            m_imagePool.Release(pNewFrame);
 
             StopCapturing();
             if (pGuider->IsCalibratingOrGuiding())
@@ -377,7 +382,28 @@ void MyFrame::OnExposeComplete(wxThreadEvent& event)
 
             throw ERROR_INFO("Error reported capturing image");
         }
-        ++m_frameCounter;
+
+        bool discard;
+        {
+            wxCriticalSectionLocker lock(m_CSpWorkerThread);
+            discard = m_discardExposure;
+            m_discardExposure = false;
+            if (discard)
+                m_exposurePipelined = false;
+        }
+        if (discard)
+        {
+            // exposed before the guider state changed, take a fresh frame
+            m_imagePool.Release(pNewFrame);
+            Debug.AddLine("discarded overlapped exposure");
+
+            CaptureActive = m_continueCapturing;
+            if (!CaptureActive)
+                FinishStop();
+            else
+                ScheduleExposure();
+            return;
+        }
 
         if (m_rawImageMode && !m_rawImageModeWarningDone)
         {
@@ -385,23 +411,54 @@ void MyFrame::OnExposeComplete(wxThreadEvent& event)
             m_rawImageModeWarningDone = true;
         }
 
-        pGuider->UpdateGuideState(pNewFrame, !m_continueCapturing);
+        // with overlapped exposures, get the camera going on the next frame
+        // before this one is evaluated
+        bool pipelined = CanPipelineCapture();
+        {
+            wxCriticalSectionLocker lock(m_CSpWorkerThread);
+            m_exposurePipelined = pipelined;
+        }
+        if (pipelined)
+        {
+            ScheduleExposure();
+        }
+
+        wxLongLong captureDone = pNewFrame->ImgEndMs;
+
+        if (frame.step.done && m_continueCapturing)
+        {
+            // the processing thread ran the guide step and queued the
+            // correction, the worker thread logs the camera to pulse latency
+            pGuider->ShowGuideStep(pNewFrame, frame.step);
+        }
+        else
+        {
+            pGuider->UpdateGuideState(pNewFrame, !m_continueCapturing, &frame.measurement);
+        }
         pNewFrame = NULL; // the guider owns it now
 
+        // the processing thread picks up the star position for the next frame here
+        PublishStarSeed();
+
+        Debug.AddLine("frame latency: processing %ld ms, capture to display %ld ms",
+            (frame.processDone - captureDone).ToLong(), (::wxGetUTCTimeMillis() - captureDone).ToLong());
+
         PhdController::UpdateControllerState();
 
         Debug.AddLine(wxString::Format("OnExposeCompete: CaptureActive=%d m_continueCapturing=%d",
             CaptureActive, m_continueCapturing));
 
-        CaptureActive = m_continueCapturing;
+        // an overlapped exposure may still be in flight if capturing was
+        // stopped while this frame was evaluated; its completion finishes the stop
+        CaptureActive = m_continueCapturing || m_exposurePending;
 
-        if (CaptureActive)
+        if (!CaptureActive)
         {
-            ScheduleExposure();
+            FinishStop();
         }
-        else
+        else if (!m_exposurePending)
         {
-            FinishStop();
+            ScheduleExposure();
         }
     }
     catch (wxString Msg)
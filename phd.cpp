@@ -125,6 +125,16 @@ bool PhdApp::OnInit()
 
     Debug.Init("debug", pConfig->Global.GetBoolean("/EnableDebugLog", true));
 
+    // Debug log lines are written by a flusher thread, so the lines leading up
+    // to a crash may still be queued in memory when the process dies; before
+    // the flusher every line reached the file synchronously. Install the fatal
+    // exception handler so OnFatalException can write them out. This changes
+    // how crashes are reported (wx takes over the fatal signals on Unix and the
+    // unhandled exception filter on Windows), so only do it when there is a
+    // debug log to save.
+    if (Debug.IsEnabled())
+        wxHandleFatalExceptions();
+
     Debug.AddLine(wxString::Format("PHD2 version %s begins execution with:", FULLVER));
     Debug.AddLine(wxString::Format("   %s", wxVERSION_STRING));
     float dummy;
@@ -132,6 +142,7 @@ bool PhdApp::OnInit()
 #if defined(CV_VERSION)
     Debug.AddLine(wxString::Format("   opencv %s", CV_VERSION));
 #endif
+    Debug.AddLine(wxString::Format("   SIMD image kernels: %s", SimdLevelName(GetCpuSimdLevel())));
 
 #if defined(__WINDOWS__)
     HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
@@ -196,9 +207,19 @@ int PhdApp::OnExit(void)
     delete m_instanceChecker; // OnExit() won't be called if we return false
     m_instanceChecker = 0;
 
+    StopRowBandThreads();
+
+    Debug.Shutdown();
+
     return wxApp::OnExit();
 }
 
+void PhdApp::OnFatalException(void)
+{
+    // Debug.AddLine could block on a lock held by the crashed thread
+    Debug.FlushOnCrash();
+}
+
 void PhdApp::OnInitCmdLine(wxCmdLineParser& parser)
 {
     parser.SetDesc(cmdLineDesc);
@@ -63,9 +63,11 @@
 #include <wx/thread.h>
 #include <wx/utils.h>
 
+#include <deque>
 #include <map>
 #include <math.h>
 #include <stdarg.h>
+#include <vector>
 
 #define APPNAME _T("PHD2 Guiding")
 #define PHDVERSION _T("2.5.0")
@@ -148,9 +150,11 @@ WX_DEFINE_ARRAY_DOUBLE(double, ArrayOfDbl);
 #include "configdialog.h"
 #include "optionsbutton.h"
 #include "usImage.h"
+#include "image_pool.h"
 #include "point.h"
 #include "star.h"
 #include "circbuf.h"
+#include "guidelog_binary.h"
 #include "guidinglog.h"
 #include "graph.h"
 #include "statswindow.h"
@@ -170,12 +174,15 @@ WX_DEFINE_ARRAY_DOUBLE(double, ArrayOfDbl);
 #include "stepguiders.h"
 #include "rotators.h"
 #include "image_math.h"
+#include "image_simd.h"
 #include "testguide.h"
 #include "advanced_dialog.h"
 #include "gear_dialog.h"
 #include "myframe.h"
 #include "debuglog.h"
 #include "worker_thread.h"
+#include "processing_thread.h"
+#include "image_logger.h"
 #include "event_server.h"
 #include "confirm_dialog.h"
 #include "phdcontrol.h"
@@ -209,6 +216,7 @@ public:
     PhdApp(void);
     bool OnInit(void);
     int OnExit(void);
+    void OnFatalException(void);
     void OnInitCmdLine(wxCmdLineParser& parser);
     bool OnCmdLineParsed(wxCmdLineParser & parser);
     virtual bool Yield(bool onlyIfNeeded=false);
@@ -0,0 +1,160 @@
+/*
+ *  processing_thread.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+ProcessingThread::ProcessingThread(MyFrame *pFrame)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_pFrame(pFrame)
+{
+    Debug.AddLine("ProcessingThread constructor called");
+}
+
+ProcessingThread::~ProcessingThread(void)
+{
+    Debug.AddLine("ProcessingThread destructor called");
+}
+
+void ProcessingThread::EnqueueProcessingRequest(usImage *pImage, bool error)
+{
+    PROCESSING_REQUEST req;
+    req.terminate = false;
+    req.pImage = pImage;
+    req.error = error;
+
+    wxMessageQueueError queueError = m_queue.Post(req);
+    assert(queueError == wxMSGQUEUE_NO_ERROR);
+}
+
+void ProcessingThread::EnqueueTerminateRequest(void)
+{
+    PROCESSING_REQUEST req;
+    req.terminate = true;
+    req.pImage = NULL;
+    req.error = false;
+
+    wxMessageQueueError queueError = m_queue.Post(req);
+    assert(queueError == wxMSGQUEUE_NO_ERROR);
+}
+
+void ProcessingThread::HandleProcessing(const PROCESSING_REQUEST& req, ProcessedFrame *frame)
+{
+    frame->pImage = req.pImage;
+    frame->error = req.error;
+    frame->measurement.seed.valid = false;
+    frame->measurement.found = false;
+    frame->step.done = false;
+
+    if (!req.error)
+    {
+        usImage *img = req.pImage;
+
+        switch (m_pFrame->GetNoiseReductionMethod())
+        {
+            case NR_NONE:
+                break;
+            case NR_2x2MEAN:
+                QuickLRecon(*img);
+                break;
+            case NR_3x3MEDIAN:
+                Median3(*img);
+                break;
+        }
+
+        img->CalcStats();
+
+        // read the seed as late as possible: with overlapped exposures the
+        // main thread publishes the position from the previous frame while
+        // this one is being captured
+        StarSeed seed = m_pFrame->GetPublishedStarSeed();
+        frame->measurement.seed = seed;
+
+        if (seed.valid)
+        {
+            Star& star = frame->measurement.star;
+            star.SetXY(seed.X, seed.Y);
+            frame->measurement.found = star.Find(img, seed.searchRegion, seed.findMode);
+        }
+
+        // while guiding, this also queues the guide correction
+        m_pFrame->pGuider->GuideStep(img, &frame->measurement, &frame->step);
+    }
+
+    frame->processDone = ::wxGetUTCTimeMillis();
+}
+
+void ProcessingThread::SendProcessingComplete(const ProcessedFrame& frame)
+{
+    wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, MYFRAME_WORKER_THREAD_EXPOSE_COMPLETE);
+    event->SetPayload<ProcessedFrame>(frame);
+    event->SetInt(frame.error);
+    wxQueueEvent(m_pFrame, event);
+}
+
+/*
+ * entry point for the processing thread
+ */
+wxThread::ExitCode ProcessingThread::Entry()
+{
+    Debug.AddLine("ProcessingThread::Entry() begins");
+
+    while (!TestDestroy())
+    {
+        PROCESSING_REQUEST req;
+        wxMessageQueueError queueError = m_queue.Receive(req);
+
+        assert(queueError == wxMSGQUEUE_NO_ERROR);
+
+        if (req.terminate)
+        {
+            Debug.AddLine("processing thread servicing terminate request");
+            break;
+        }
+
+        Debug.AddLine("processing thread servicing frame, error=%d", req.error);
+
+        ProcessedFrame frame;
+        HandleProcessing(req, &frame);
+
+        // the main thread owns the image once the event is sent
+        Debug.AddLine("processing thread done, %ld ms", (frame.processDone - frame.pImage->ImgEndMs).ToLong());
+
+        SendProcessingComplete(frame);
+    }
+
+    Debug.AddLine("ProcessingThread::Entry() ends");
+    Debug.Flush();
+
+    return (wxThread::ExitCode)0;
+}
@@ -0,0 +1,88 @@
+/*
+ *  processing_thread.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PROCESSING_THREAD_H_INCLUDED
+#define PROCESSING_THREAD_H_INCLUDED
+
+/*
+ * The processing thread sits between the primary worker thread and the main
+ * thread. The worker thread hands each captured frame to it; the processing
+ * thread applies noise reduction, computes the image statistics and measures
+ * the guide star at the position most recently published by the main thread
+ * (MyFrame::PublishStarSeed).
+ *
+ * While guiding, the processing thread also runs the guide step
+ * (Guider::GuideStep): the star checks, the lock position shift and the
+ * scheduling of the guide correction, so the correction reaches a worker
+ * thread without waiting for the GUI. Only the finished frame, the measurement
+ * and the result of the guide step are posted to the main thread, which
+ * updates the display, the graphs and the status from them. Selection and
+ * calibration still run in Guider::UpdateGuideState on the main thread.
+ */
+
+struct ProcessedFrame
+{
+    usImage *pImage;
+    bool error;
+    StarMeasurement measurement;    // meaningful if measurement.seed.valid
+    GuideStepResult step;           // meaningful if step.done
+    wxLongLong processDone;         // UTC ms when processing finished
+};
+
+class ProcessingThread : public wxThread
+{
+    struct PROCESSING_REQUEST
+    {
+        bool terminate;
+        usImage *pImage;
+        bool error;
+    };
+
+    MyFrame *m_pFrame;
+    wxMessageQueue<PROCESSING_REQUEST> m_queue;
+
+public:
+    ProcessingThread(MyFrame *pFrame);
+    ~ProcessingThread(void);
+
+    void EnqueueProcessingRequest(usImage *pImage, bool error);
+    void EnqueueTerminateRequest(void);
+
+private:
+    wxThread::ExitCode Entry();
+    void HandleProcessing(const PROCESSING_REQUEST& req, ProcessedFrame *frame);
+    void SendProcessingComplete(const ProcessedFrame& frame);
+};
+
+#endif /* PROCESSING_THREAD_H_INCLUDED */
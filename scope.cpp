@@ -531,91 +531,102 @@ static void AlertLimitReached(GuideAxis axis)
     }
 }
 
-Mount::MOVE_RESULT Scope::Move(GUIDE_DIRECTION direction, int duration, bool normalMove, MoveResultInfo *moveResult)
+// Apply the dec guide mode and the max RA/Dec durations to a guide pulse and
+// keep track of how often the limits are hit
+int Scope::LimitGuideDuration(GUIDE_DIRECTION direction, int duration, bool normalMove, bool *limitReached)
 {
-    MOVE_RESULT result = MOVE_OK;
-    bool limitReached = false;
+    *limitReached = false;
 
-    try
+    switch (direction)
     {
-        Debug.AddLine("Move(%d, %d, %d)", direction, duration, normalMove);
-
-        if (!m_guidingEnabled)
-        {
-            throw THROW_INFO("Guiding disabled");
-        }
+        case NORTH:
+        case SOUTH:
 
-        // Compute the actual guide durations
-
-        switch (direction)
-        {
-            case NORTH:
-            case SOUTH:
+            // Enforce dec guiding mode and max dec duration for normal moves
+            if (normalMove)
+            {
+                if ((m_decGuideMode == DEC_NONE) ||
+                    (direction == SOUTH && m_decGuideMode == DEC_NORTH) ||
+                    (direction == NORTH && m_decGuideMode == DEC_SOUTH))
+                {
+                    duration = 0;
+                    Debug.AddLine("duration set to 0 by GuideMode");
+                }
 
-                // Enforce dec guiding mode and max dec duration for normal moves
-                if (normalMove)
+                if (duration > m_maxDecDuration)
                 {
-                    if ((m_decGuideMode == DEC_NONE) ||
-                        (direction == SOUTH && m_decGuideMode == DEC_NORTH) ||
-                        (direction == NORTH && m_decGuideMode == DEC_SOUTH))
-                    {
-                        duration = 0;
-                        Debug.AddLine("duration set to 0 by GuideMode");
-                    }
+                    duration = m_maxDecDuration;
+                    Debug.AddLine("duration set to %d by maxDecDuration", duration);
+                    *limitReached = true;
+                }
 
-                    if (duration > m_maxDecDuration)
-                    {
-                        duration = m_maxDecDuration;
-                        Debug.AddLine("duration set to %d by maxDecDuration", duration);
-                        limitReached = true;
-                    }
+                if (*limitReached && direction == m_decLimitReachedDirection)
+                {
+                    if (++m_decLimitReachedCount >= LIMIT_REACHED_WARN_COUNT)
+                        AlertLimitReached(GUIDE_DEC);
+                }
+                else
+                    m_decLimitReachedCount = 0;
 
-                    if (limitReached && direction == m_decLimitReachedDirection)
-                    {
-                        if (++m_decLimitReachedCount >= LIMIT_REACHED_WARN_COUNT)
-                            AlertLimitReached(GUIDE_DEC);
-                    }
-                    else
-                        m_decLimitReachedCount = 0;
+                if (*limitReached)
+                    m_decLimitReachedDirection = direction;
+                else
+                    m_decLimitReachedDirection = NONE;
+            }
+            break;
+        case EAST:
+        case WEST:
 
-                    if (limitReached)
-                        m_decLimitReachedDirection = direction;
-                    else
-                        m_decLimitReachedDirection = NONE;
+            if (normalMove)
+            {
+                // enforce max RA duration for normal moves
+                if (duration > m_maxRaDuration)
+                {
+                    duration = m_maxRaDuration;
+                    Debug.AddLine("duration set to %d by maxRaDuration", duration);
+                    *limitReached = true;
                 }
-                break;
-            case EAST:
-            case WEST:
 
-                if (normalMove)
+                if (*limitReached && direction == m_raLimitReachedDirection)
                 {
-                    // enforce max RA duration for normal moves
-                    if (duration > m_maxRaDuration)
-                    {
-                        duration = m_maxRaDuration;
-                        Debug.AddLine("duration set to %d by maxRaDuration", duration);
-                        limitReached = true;
-                    }
+                    if (++m_raLimitReachedCount >= LIMIT_REACHED_WARN_COUNT)
+                        AlertLimitReached(GUIDE_RA);
+                }
+                else
+                    m_raLimitReachedCount = 0;
 
-                    if (limitReached && direction == m_raLimitReachedDirection)
-                    {
-                        if (++m_raLimitReachedCount >= LIMIT_REACHED_WARN_COUNT)
-                            AlertLimitReached(GUIDE_RA);
-                    }
-                    else
-                        m_raLimitReachedCount = 0;
+                if (*limitReached)
+                    m_raLimitReachedDirection = direction;
+                else
+                    m_raLimitReachedDirection = NONE;
+            }
+            break;
 
-                    if (limitReached)
-                        m_raLimitReachedDirection = direction;
-                    else
-                        m_raLimitReachedDirection = NONE;
-                }
-                break;
+        case NONE:
+            break;
+    }
 
-            case NONE:
-                break;
+    return duration;
+}
+
+Mount::MOVE_RESULT Scope::Move(GUIDE_DIRECTION direction, int duration, bool normalMove, MoveResultInfo *moveResult)
+{
+    MOVE_RESULT result = MOVE_OK;
+    bool limitReached = false;
+
+    try
+    {
+        Debug.AddLine("Move(%d, %d, %d)", direction, duration, normalMove);
+
+        if (!m_guidingEnabled)
+        {
+            throw THROW_INFO("Guiding disabled");
         }
 
+        // Compute the actual guide durations
+
+        duration = LimitGuideDuration(direction, duration, normalMove, &limitReached);
+
         // Actually do the guide
         assert(duration >= 0);
         if (duration > 0)
@@ -646,6 +657,77 @@ Mount::MOVE_RESULT Scope::Move(GUIDE_DIRECTION direction, int duration, bool nor
     return result;
 }
 
+Mount::MOVE_RESULT Scope::MoveAxes(GUIDE_DIRECTION raDirection, int raDuration, GUIDE_DIRECTION decDirection, int decDuration,
+                                   bool normalMove, MoveResultInfo *raMoveResult, MoveResultInfo *decMoveResult)
+{
+    if (!CanGuideBothAxes())
+    {
+        return Mount::MoveAxes(raDirection, raDuration, decDirection, decDuration, normalMove, raMoveResult, decMoveResult);
+    }
+
+    MOVE_RESULT result = MOVE_OK;
+    bool raLimitReached = false;
+    bool decLimitReached = false;
+
+    try
+    {
+        Debug.AddLine("MoveAxes(%d, %d, %d, %d, %d)", raDirection, raDuration, decDirection, decDuration, normalMove);
+
+        if (!m_guidingEnabled)
+        {
+            throw THROW_INFO("Guiding disabled");
+        }
+
+        raDuration = LimitGuideDuration(raDirection, raDuration, normalMove, &raLimitReached);
+        decDuration = LimitGuideDuration(decDirection, decDuration, normalMove, &decLimitReached);
+
+        assert(raDuration >= 0 && decDuration >= 0);
+        if (raDuration > 0 || decDuration > 0)
+        {
+            result = GuideBothAxes(raDirection, raDuration, decDirection, decDuration);
+            if (result != MOVE_OK)
+            {
+                throw ERROR_INFO("guide failed");
+            }
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        if (result == MOVE_OK)
+            result = MOVE_ERROR;
+        raDuration = decDuration = 0;
+    }
+
+    Debug.AddLine(wxString::Format("MoveAxes returns status %d, amount %d, %d", result, raDuration, decDuration));
+
+    raMoveResult->amountMoved = raDuration;
+    raMoveResult->limited = raLimitReached;
+    decMoveResult->amountMoved = decDuration;
+    decMoveResult->limited = decLimitReached;
+
+    return result;
+}
+
+bool Scope::CanGuideBothAxes(void)
+{
+    return false;
+}
+
+Mount::MOVE_RESULT Scope::GuideBothAxes(GUIDE_DIRECTION raDirection, int raDuration,
+                                        GUIDE_DIRECTION decDirection, int decDuration)
+{
+    MOVE_RESULT result = MOVE_OK;
+
+    if (raDuration > 0)
+        result = Guide(raDirection, raDuration);
+
+    if (decDuration > 0 && result == MOVE_OK)
+        result = Guide(decDirection, decDuration);
+
+    return result;
+}
+
 static wxString CalibrationWarningKey(Calibration_Issues etype)
 {
     wxString qual;
@@ -190,7 +190,10 @@ private:
     // functions with an implemenation in Scope that cannot be over-ridden
     // by a subclass
     MOVE_RESULT Move(GUIDE_DIRECTION direction, int durationMs, bool normalMove, MoveResultInfo *moveResultInfo);
+    MOVE_RESULT MoveAxes(GUIDE_DIRECTION raDirection, int raDurationMs, GUIDE_DIRECTION decDirection, int decDurationMs,
+                         bool normalMove, MoveResultInfo *raMoveResult, MoveResultInfo *decMoveResult);
     MOVE_RESULT CalibrationMove(GUIDE_DIRECTION direction, int duration);
+    int LimitGuideDuration(GUIDE_DIRECTION direction, int durationMs, bool normalMove, bool *limitReached);
     int CalibrationMoveSize(void);
     int CalibrationTotDistance(void);
 
@@ -201,6 +204,13 @@ private:
 // these MUST be supplied by a subclass
 private:
     virtual MOVE_RESULT Guide(GUIDE_DIRECTION direction, int durationMs) = 0;
+
+// these CAN be supplied by a subclass that is able to pulse RA and Dec at the
+// same time; the default pulses one axis after the other
+private:
+    virtual bool CanGuideBothAxes(void);
+    virtual MOVE_RESULT GuideBothAxes(GUIDE_DIRECTION raDirection, int raDurationMs,
+                                      GUIDE_DIRECTION decDirection, int decDurationMs);
 };
 
 inline bool Scope::IsStopGuidingWhenSlewingEnabled(void) const
@@ -330,10 +330,8 @@ void ScopeINDI::newProperty(INDI::Property *property)
     CheckState();
 }
 
-Mount::MOVE_RESULT ScopeINDI::Guide(GUIDE_DIRECTION direction, int duration) 
+void ScopeINDI::StartPulse(GUIDE_DIRECTION direction, int duration)
 {
-  // guide using timed pulse guide 
-    if (pulseGuideNS_prop && pulseGuideEW_prop) {
     // despite what is sayed in INDI standard properties description, every telescope driver expect the guided time in msec.  
     switch (direction) {
         case EAST:
@@ -360,6 +358,13 @@ Mount::MOVE_RESULT ScopeINDI::Guide(GUIDE_DIRECTION direction, int duration)
 	    printf("error ScopeINDI::Guide NONE\n");
             break;
     }
+}
+
+Mount::MOVE_RESULT ScopeINDI::Guide(GUIDE_DIRECTION direction, int duration) 
+{
+  // guide using timed pulse guide 
+    if (pulseGuideNS_prop && pulseGuideEW_prop) {
+    StartPulse(direction, duration);
     wxMilliSleep(duration);
     return MOVE_OK;
   }
@@ -414,6 +419,30 @@ Mount::MOVE_RESULT ScopeINDI::Guide(GUIDE_DIRECTION direction, int duration)
   else return MOVE_ERROR;
 }
 
+Mount::MOVE_RESULT ScopeINDI::GuideBothAxes(GUIDE_DIRECTION raDirection, int raDuration,
+                                            GUIDE_DIRECTION decDirection, int decDuration)
+{
+    // the EW and NS pulse properties are independent, so both pulses run at
+    // the same time and the move takes as long as the longer of the two
+    if (raDuration > 0)
+        StartPulse(raDirection, raDuration);
+    if (decDuration > 0)
+        StartPulse(decDirection, decDuration);
+
+    int first = raDuration < decDuration ? raDuration : decDuration;
+    int last = raDuration < decDuration ? decDuration : raDuration;
+
+    if (first > 0)
+    {
+        wxMilliSleep(first);
+        Debug.AddLine("INDI Scope: %s pulse complete", raDuration <= decDuration ? "RA" : "Dec");
+    }
+    wxMilliSleep(last - first);
+    Debug.AddLine("INDI Scope: %s pulse complete", raDuration <= decDuration ? "Dec" : "RA");
+
+    return MOVE_OK;
+}
+
 double ScopeINDI::GetGuidingDeclination(void)
 {
     double dec;
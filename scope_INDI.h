@@ -75,6 +75,7 @@ private:
     bool     eod_coord;
     void     ClearStatus();
     void     CheckState();
+    void     StartPulse(GUIDE_DIRECTION direction, int duration);
     
 protected:
     virtual void newDevice(INDI::BaseDevice *dp);
@@ -99,6 +100,8 @@ public:
     void     SetupDialog();
 
     MOVE_RESULT Guide(GUIDE_DIRECTION direction, int duration);
+    bool        CanGuideBothAxes(void) { return (pulseGuideNS_prop && pulseGuideEW_prop); }
+    MOVE_RESULT GuideBothAxes(GUIDE_DIRECTION raDirection, int raDuration, GUIDE_DIRECTION decDirection, int decDuration);
 
     bool   CanPulseGuide() { return (pulseGuideNS_prop && pulseGuideEW_prop);}
     bool   CanReportPosition(void) { return (coord_prop); }
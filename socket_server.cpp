@@ -341,13 +341,13 @@ void MyFrame::HandleSockServerInput(wxSocketBase *sock)
                 {
                     rval = 0;
                 }
-                else if (m_frameCounter > UCHAR_MAX)
+                else if (FrameCounter() > UCHAR_MAX)
                 {
                     rval = UCHAR_MAX;
                 }
                 else
                 {
-                    rval = m_frameCounter;
+                    rval = FrameCounter();
                 }
                 break;
 
@@ -87,7 +87,7 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
 
     try
     {
-        Debug.Write(wxString::Format("Star::Find(%d, %d, %d, %d, (%d,%d,%d,%d))\n", searchRegion, base_x, base_y, mode,
+        DEBUG_LOG(DBGLOG_STAR, DBGLOG_VERBOSE).Write(wxString::Format("Star::Find(%d, %d, %d, %d, (%d,%d,%d,%d))\n", searchRegion, base_x, base_y, mode,
                                      pImg->Subframe.x, pImg->Subframe.y, pImg->Subframe.width, pImg->Subframe.height));
 
         if (base_x < 0 || base_y < 0)
@@ -120,41 +120,43 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
         const unsigned short *dataptr = pImg->ImageData;
         int rowsize = pImg->Size.GetWidth();
 
-        // compute localmin and localmean, which we need to find the star
+        // Compute localmin and localmean, which we need to find the star, and get a rough guess
+        // on the star's location by finding the peak value within the search region. This is done
+        // in a single pass over the rows: the statistics of the interior pixels relative to
+        // localmin are taken from the raw values (the top three values and the sum) and adjusted
+        // once localmin is known.
         unsigned short localmin = 65535;
-        double localmean = 0.0;
+        wxUint64 regionSum = 0;
+
+        unsigned long maxlval = 0;
+        unsigned short rawmax = 0, rawnear1 = 0, rawnear2 = 0;
+        unsigned long rawsum = 0;
+
         for (int y = start_y; y <= end_y; y++)
         {
+            const unsigned short *const row = dataptr + rowsize * y;
+
             for (int x = start_x; x <= end_x; x++)
             {
-                unsigned short val = *(dataptr + x + rowsize * y);
+                unsigned short val = row[x];
                 if (val < localmin)
                     localmin = val;
-                localmean += (double) val;
+                regionSum += val;
             }
-        }
 
-        double area = (double)((end_x - start_x + 1) * (end_y - start_y + 1));
-        localmean /= area;
-
-        // get rough guess on star's location by finding the peak value within the search region
-
-        unsigned long maxlval = 0;
-        unsigned short max = 0, nearmax1 = 0, nearmax2 = 0;
-        unsigned long sum = 0;
+            if (y == start_y || y == end_y)
+                continue;
 
-        for (int y = start_y + 1; y <= end_y - 1; y++)
-        {
             for (int x = start_x + 1; x <= end_x - 1; x++)
             {
                 unsigned long lval;
 
-                lval = *(dataptr + (x + 0) + rowsize * (y + 0)) +  // combine adjacent pixels to smooth image
-                       *(dataptr + (x + 1) + rowsize * (y + 0)) +        // find max of this smoothed area and set
-                       *(dataptr + (x - 1) + rowsize * (y + 0)) +        // base_x and y to be this spot
-                       *(dataptr + (x + 0) + rowsize * (y + 1)) +
-                       *(dataptr + (x + 0) + rowsize * (y - 1)) +
-                       *(dataptr + (x + 0) + rowsize * (y + 0));  // weight current pixel by 2x
+                lval = row[x + 0] +                // combine adjacent pixels to smooth image
+                       row[x + 1] +                // find max of this smoothed area and set
+                       row[x - 1] +                // base_x and y to be this spot
+                       row[x + rowsize] +
+                       row[x - rowsize] +
+                       row[x + 0];                 // weight current pixel by 2x
 
                 if (lval >= maxlval)
                 {
@@ -163,18 +165,28 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
                     maxlval = lval;
                 }
 
-                unsigned short sval = *(dataptr + x + rowsize * y) - localmin;
-                sum += sval;
+                unsigned short rval = row[x];
+                rawsum += rval;
 
-                if (sval > max)
-                    std::swap(sval, max);
-                if (sval > nearmax1)
-                    std::swap(sval, nearmax1);
-                if (sval > nearmax2)
-                    std::swap(sval, nearmax2);
+                if (rval > rawmax)
+                    std::swap(rval, rawmax);
+                if (rval > rawnear1)
+                    std::swap(rval, rawnear1);
+                if (rval > rawnear2)
+                    std::swap(rval, rawnear2);
             }
+
         }
 
+        double area = (double)((end_x - start_x + 1) * (end_y - start_y + 1));
+        double localmean = (double) regionSum / area;
+
+        // every interior pixel is >= localmin; slots of the top three that were never filled hold 0
+        unsigned short max = rawmax > localmin ? rawmax - localmin : 0;
+        unsigned short nearmax2 = rawnear2 > localmin ? rawnear2 - localmin : 0;
+        unsigned long interiorCount = (unsigned long)(std::max(end_x - start_x - 1, 0) * std::max(end_y - start_y - 1, 0));
+        unsigned long sum = rawsum - interiorCount * localmin;
+
         // SNR = max / mean = max / (sum / area) = max * area / sum
         if (sum > 0)
             SNR = (double) max * area / (double) sum;
@@ -207,25 +219,29 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
             int endx1 = wxMin(end_x, base_x + hft_range);
             int endy1 = wxMin(end_y, base_y + hft_range);
 
+            // gather the window once and find the pixels above each threshold in a single pass,
+            // then sum only those pixels for each threshold tried
+            enum { WIN_MAX = (2 * hft_range + 1) * (2 * hft_range + 1), WIN_WORDS = (WIN_MAX + 31) / 32 };
+            unsigned short win[WIN_MAX];
+            unsigned int above[WXSIZEOF(thresholds) * WIN_WORDS];
+
+            int const winWidth = endx1 - startx1 + 1;
+            int const winHeight = endy1 - starty1 + 1;
+            int const winSize = winWidth > 0 && winHeight > 0 ? winWidth * winHeight : 0;
+            int const winWords = (winSize + 31) / 32;
+
+            for (int y = 0; winSize > 0 && y < winHeight; y++)
+                memcpy(&win[y * winWidth], dataptr + rowsize * (starty1 + y) + startx1, winWidth * sizeof(unsigned short));
+
+            GetImageKernels().thresholdMask(above, win, winSize, thresholds, (int) WXSIZEOF(thresholds));
+
             double mass = 0.0, mx = 0.0, my = 0.0;
 
             for (unsigned int i = 0; i < WXSIZEOF(thresholds) && mass < 10.0; i++)
             {
                 mass = mx = my = 0.000001;
-                double threshold = thresholds[i];
-                for (int y = starty1; y <= endy1; y++)
-                {
-                    for (int x = startx1; x <= endx1; x++)
-                    {
-                        double val = (double) *(dataptr + x + rowsize * y) - threshold;
-                        if (val > 0.0)
-                        {
-                            mx += (double) x * val;
-                            my += (double) y * val;
-                            mass += val;
-                        }
-                    }
-                }
+                MaskedCentroid(win, winWidth, winSize, startx1, starty1, &above[i * winWords], thresholds[i],
+                               &mass, &mx, &my);
             }
 
             Mass = mass;
@@ -267,7 +283,7 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
         SNR = 0.0;
     }
 
-    Debug.AddLine(wxString::Format("Star::Find returns %d (%d), X=%.2f, Y=%.2f, Mass=%.f, SNR=%.1f",
+    DEBUG_LOG(DBGLOG_STAR, DBGLOG_NORMAL).AddLine(wxString::Format("Star::Find returns %d (%d), X=%.2f, Y=%.2f, Mass=%.f, SNR=%.1f",
         bReturn, Result, newX, newY, Mass, SNR));
 
     return bReturn;
@@ -355,87 +371,122 @@ static void SaveImage(const FloatImg& img, const char *name)
 #endif // SAVE_AUTOFIND_IMG
 }
 
-static void psf_conv(FloatImg& dst, const FloatImg& src)
+// The PSF fit is linear in the pixel values: sum(PSF[k] * (S[k] - n[k] * mean)) over the
+// pixel classes k of the grid, with mean = sum(S) / 81. That is a convolution with a 9x9
+// kernel whose weight at each position is the class weight less sum(PSF[k] * n[k]) / 81.
+// The kernel is symmetric about both axes, so it is stored as one quadrant and applied to
+// the sums of mirrored pixel pairs.
+struct PsfKernel
 {
-    dst.Init(src.Size);
+    float w[5][5]; // w[dy][dx]
 
-    //                       A      B1     B2    C1     C2    C3     D1     D2     D3
-    const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
+    PsfKernel()
+    {
+        //                       A      B1     B2    C1     C2    C3     D1     D2     D3
+        const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
+        enum { A, B1, B2, C1, C2, C3, D1, D2, D3 };
+
+        /* PSF Grid is:
+        D3 D3 D3 D3 D3 D3 D3 D3 D3
+        D3 D3 D3 D2 D1 D2 D3 D3 D3
+        D3 D3 C3 C2 C1 C2 C3 D3 D3
+        D3 D2 C2 B2 B1 B2 C2 D2 D3
+        D3 D1 C1 B1 A  B1 C1 D1 D3
+        D3 D2 C2 B2 B1 B2 C2 D2 D3
+        D3 D3 C3 C2 C1 C2 C3 D3 D3
+        D3 D3 D3 D2 D1 D2 D3 D3 D3
+        D3 D3 D3 D3 D3 D3 D3 D3 D3
+
+        1@A
+        4@B1, B2, C1, C3, D1
+        8@C2, D2
+        44 * D3
+        */
+
+        static const int quadrant[5][5] = {
+            { A,  B1, C1, D1, D3 },
+            { B1, B2, C2, D2, D3 },
+            { C1, C2, C3, D3, D3 },
+            { D1, D2, D3, D3, D3 },
+            { D3, D3, D3, D3, D3 },
+        };
+        static const int count[] = { 1, 4, 4, 4, 8, 4, 4, 8, 44 };
+
+        double c = 0.0;
+        for (int k = 0; k < 9; k++)
+            c += PSF[k] * count[k];
+
+        for (int dy = 0; dy < 5; dy++)
+            for (int dx = 0; dx < 5; dx++)
+                w[dy][dx] = (float)(PSF[quadrant[dy][dx]] - c / 81.0);
+    }
+};
 
-    int const width = src.Size.GetWidth();
-    int const height = src.Size.GetHeight();
+// Each output row is computed from the five vertical pair sums v[dy][x] = px(x, y - dy) + px(x, y + dy),
+// then from horizontal pairs of those using the SIMD row kernels. The sums are formed in the same
+// order for every pixel, so identical neighborhoods give identical results.
+struct PsfConvTask : public RowBandTask
+{
+    FloatImg& m_dst;
+    const FloatImg& m_src;
+    const PsfKernel& m_kernel;
 
-    memset(dst.px, 0, src.NPixels * sizeof(float));
+    PsfConvTask(FloatImg& dst, const FloatImg& src, const PsfKernel& kernel)
+        : m_dst(dst), m_src(src), m_kernel(kernel) { }
 
-    /* PSF Grid is:
-    D3 D3 D3 D3 D3 D3 D3 D3 D3
-    D3 D3 D3 D2 D1 D2 D3 D3 D3
-    D3 D3 C3 C2 C1 C2 C3 D3 D3
-    D3 D2 C2 B2 B1 B2 C2 D2 D3
-    D3 D1 C1 B1 A  B1 C1 D1 D3
-    D3 D2 C2 B2 B1 B2 C2 D2 D3
-    D3 D3 C3 C2 C1 C2 C3 D3 D3
-    D3 D3 D3 D2 D1 D2 D3 D3 D3
-    D3 D3 D3 D3 D3 D3 D3 D3 D3
-
-    1@A
-    4@B1, B2, C1, C3, D1
-    8@C2, D2
-    44 * D3
-    */
-
-    int psf_size = 4;
-
-    for (int y = psf_size; y < height - psf_size; y++)
+    void Run(int y0, int y1)
     {
-        for (int x = psf_size; x < width - psf_size; x++)
+        enum { PSF_SIZE = 4 };
+
+        int const width = m_src.Size.GetWidth();
+        int const height = m_src.Size.GetHeight();
+
+        if (width <= 2 * PSF_SIZE)
+            return;
+
+        const ImageKernels& kernels = GetImageKernels();
+
+        std::vector<float> vbuf(PSF_SIZE * width);
+
+        for (int y = std::max(y0, (int) PSF_SIZE); y < std::min(y1, height - PSF_SIZE); y++)
         {
-            float A, B1, B2, C1, C2, C3, D1, D2, D3;
-
-#define PX(dx, dy) *(src.px + width * (y + (dy)) + x + (dx))
-            A =  PX(+0, +0);
-            B1 = PX(+0, -1) + PX(+0, +1) + PX(+1, +0) + PX(-1, +0);
-            B2 = PX(-1, -1) + PX(+1, -1) + PX(-1, +1) + PX(+1, +1);
-            C1 = PX(+0, -2) + PX(-2, +0) + PX(+2, +0) + PX(+0, +2);
-            C2 = PX(-1, -2) + PX(+1, -2) + PX(-2, -1) + PX(+2, -1) + PX(-2, +1) + PX(+2, +1) + PX(-1, +2) + PX(+1, +2);
-            C3 = PX(-2, -2) + PX(+2, -2) + PX(-2, +2) + PX(+2, +2);
-            D1 = PX(+0, -3) + PX(-3, +0) + PX(+3, +0) + PX(+0, +3);
-            D2 = PX(-1, -3) + PX(+1, -3) + PX(-3, -1) + PX(+3, -1) + PX(-3, +1) + PX(+3, +1) + PX(-1, +3) + PX(+1, +3);
-            D3 = PX(-4, -2) + PX(-3, -2) + PX(+3, -2) + PX(+4, -2) + PX(-4, -1) + PX(+4, -1) + PX(-4, +0) + PX(+4, +0) + PX(-4, +1) + PX(+4, +1) + PX(-4, +2) + PX(-3, +2) + PX(+3, +2) + PX(+4, +2);
-#undef PX
-            int i;
-            const float *uptr;
-
-            uptr = src.px + width * (y - 4) + (x - 4);
-            for (i = 0; i < 9; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y - 3) + (x - 4);
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-            uptr += 3;
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y + 3) + (x - 4);
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-            uptr += 3;
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y + 4) + (x - 4);
-            for (i = 0; i < 9; i++)
-                D3 += *uptr++;
-
-            double mean = (A + B1 + B2 + C1 + C2 + C3 + D1 + D2 + D3) / 81.0;
-            double PSF_fit = PSF[0] * (A - mean) + PSF[1] * (B1 - 4.0 * mean) + PSF[2] * (B2 - 4.0 * mean) +
-                PSF[3] * (C1 - 4.0 * mean) + PSF[4] * (C2 - 8.0 * mean) + PSF[5] * (C3 - 4.0 * mean) +
-                PSF[6] * (D1 - 4.0 * mean) + PSF[7] * (D2 - 8.0 * mean) + PSF[8] * (D3 - 44.0 * mean);
-
-            dst.px[width * y + x] = (float) PSF_fit;
+            const float *const row = m_src.px + width * y;
+            const float *v[PSF_SIZE + 1];
+            v[0] = row;
+            for (int dy = 1; dy <= PSF_SIZE; dy++)
+            {
+                const float *const above = row - width * dy;
+                const float *const below = row + width * dy;
+                float *const vd = &vbuf[(dy - 1) * width];
+                for (int x = 0; x < width; x++)
+                    vd[x] = above[x] + below[x];
+                v[dy] = vd;
+            }
+
+            // dst was zeroed by psf_conv
+            float *const d = m_dst.px + width * y + PSF_SIZE;
+            int const n = width - 2 * PSF_SIZE;
+
+            for (int dy = 0; dy <= PSF_SIZE; dy++)
+            {
+                const float *const vd = v[dy] + PSF_SIZE;
+                kernels.floatMulAdd(d, vd, m_kernel.w[dy][0], n);
+                for (int dx = 1; dx <= PSF_SIZE; dx++)
+                    kernels.floatMirrorMulAdd(d, vd, dx, m_kernel.w[dy][dx], n);
+            }
         }
     }
+};
+
+static const PsfKernel s_psfKernel;
+
+static void psf_conv(FloatImg& dst, const FloatImg& src)
+{
+    dst.Init(src.Size);
+    memset(dst.px, 0, src.NPixels * sizeof(float));
+
+    PsfConvTask task(dst, src, s_psfKernel);
+    RunRowBands(task, src.Size.GetHeight(), BandThreadCount(src.NPixels));
 }
 
 static void Downsample(FloatImg& dst, const FloatImg& src, int downsample)
@@ -460,6 +511,156 @@ static void Downsample(FloatImg& dst, const FloatImg& src, int downsample)
     }
 }
 
+// dst[i] = max(src[i - r] .. src[i + r]) for i in [r, n - r), by the van Herk / Gil-Werman method:
+// with the row split into blocks of k = 2r + 1 elements, g holds the running max from the start
+// of each block and h the running max to the end of each block, so each window max is
+// max(h[i - r], g[i + r]) and the cost per element does not depend on r.
+static void RunningMax(float *dst, const float *src, int n, int r, float *g, float *h)
+{
+    int const k = 2 * r + 1;
+    for (int b = 0; b < n; b += k)
+    {
+        int const e = std::min(b + k, n);
+        g[b] = src[b];
+        for (int i = b + 1; i < e; i++)
+            g[i] = std::max(g[i - 1], src[i]);
+        h[e - 1] = src[e - 1];
+        for (int i = e - 2; i >= b; i--)
+            h[i] = std::max(h[i + 1], src[i]);
+    }
+    for (int i = r; i < n - r; i++)
+        dst[i] = std::max(h[i - r], g[i + r]);
+}
+
+// Max filter over (2r+1)x(2r+1) windows. dst is only valid where the window lies entirely inside
+// the image.
+static void MaxFilter(FloatImg& dst, const FloatImg& src, int r)
+{
+    int const width = src.Size.GetWidth();
+    int const height = src.Size.GetHeight();
+    int const k = 2 * r + 1;
+
+    dst.Init(src.Size);
+    if (width < k || height < k)
+        return;
+
+    // horizontal pass
+    {
+        std::vector<float> g(width), h(width);
+        for (int y = 0; y < height; y++)
+            RunningMax(&dst.px[y * width], &src.px[y * width], width, r, &g[0], &h[0]);
+    }
+
+    // Vertical pass, in place, by the same method applied to whole rows. gmax is the running
+    // max of the rows from the start of the block containing row t, and hbuf is the running max
+    // to the end of the block containing the top row s of the window ending at row t. The
+    // result for the window centered on row s + r is written to row s, which has been consumed
+    // by then, and the rows are shifted down by r at the end.
+    std::vector<float> gmax(width), hbuf(k * width);
+    for (int t = 0; t < height; t++)
+    {
+        const float *const row = &dst.px[t * width];
+        if (t % k == 0)
+            memcpy(&gmax[0], row, width * sizeof(float));
+        else
+            for (int x = 0; x < width; x++)
+                gmax[x] = std::max(gmax[x], row[x]);
+
+        int const s = t - (k - 1);
+        if (s < 0)
+            continue;
+
+        int const b = s - s % k;
+        if (s == b)
+        {
+            // rows b .. b + k - 1 <= t are all available and not yet overwritten
+            memcpy(&hbuf[(k - 1) * width], &dst.px[(b + k - 1) * width], width * sizeof(float));
+            for (int i = k - 2; i >= 0; i--)
+            {
+                const float *const src_row = &dst.px[(b + i) * width];
+                const float *const next = &hbuf[(i + 1) * width];
+                float *const hrow = &hbuf[i * width];
+                for (int x = 0; x < width; x++)
+                    hrow[x] = std::max(next[x], src_row[x]);
+            }
+        }
+
+        const float *const hrow = &hbuf[(s - b) * width];
+        float *const out = &dst.px[s * width];
+        for (int x = 0; x < width; x++)
+            out[x] = std::max(hrow[x], gmax[x]);
+    }
+
+    memmove(&dst.px[r * width], &dst.px[0], (height - 2 * r) * width * sizeof(float));
+}
+
+// Mean and standard deviation over (2r+1)x(2r+1) windows clipped to a rectangle, for windows
+// centered on rows visited in increasing order. Column sums over the rows of the current window
+// are updated as rows enter and leave the window, and their prefix sums give the sum over any
+// window in the row with two lookups. Values are taken relative to offset to keep the sums of
+// squares well conditioned.
+class LocalStats
+{
+    const FloatImg& m_img;
+    wxRect m_rect;
+    int m_r;
+    double m_offset;
+    std::vector<double> m_col;
+    std::vector<double> m_col2;
+    std::vector<double> m_sum;
+    std::vector<double> m_sum2;
+    int m_top;              // rows m_top .. m_bot are in the column sums
+    int m_bot;
+
+    void AddRow(int y, double sign)
+    {
+        const float *const p = &m_img.px[y * m_img.Size.GetWidth() + m_rect.GetLeft()];
+        for (int i = 0; i < m_rect.GetWidth(); i++)
+        {
+            double const v = (double) p[i] - m_offset;
+            m_col[i] += sign * v;
+            m_col2[i] += sign * v * v;
+        }
+    }
+
+public:
+
+    LocalStats(const FloatImg& img, const wxRect& rect, int r, double offset)
+        : m_img(img), m_rect(rect), m_r(r), m_offset(offset),
+        m_col(rect.GetWidth(), 0.0), m_col2(rect.GetWidth(), 0.0),
+        m_sum(rect.GetWidth() + 1, 0.0), m_sum2(rect.GetWidth() + 1, 0.0),
+        m_top(rect.GetTop()), m_bot(rect.GetTop() - 1)
+    { }
+
+    void SetRow(int y)
+    {
+        int const top = std::max(m_rect.GetTop(), y - m_r);
+        int const bot = std::min(m_rect.GetBottom(), y + m_r);
+
+        while (m_bot < bot)
+            AddRow(++m_bot, 1.0);
+        while (m_top < top)
+            AddRow(m_top++, -1.0);
+
+        for (int i = 0; i < m_rect.GetWidth(); i++)
+        {
+            m_sum[i + 1] = m_sum[i] + m_col[i];
+            m_sum2[i + 1] = m_sum2[i] + m_col2[i];
+        }
+    }
+
+    void Get(int x, double *mean, double *stdev) const
+    {
+        int const x0 = std::max(m_rect.GetLeft(), x - m_r) - m_rect.GetLeft();
+        int const x1 = std::min(m_rect.GetRight(), x + m_r) - m_rect.GetLeft() + 1;
+        double const n = (double) ((x1 - x0) * (m_bot - m_top + 1));
+        double const m = (m_sum[x1] - m_sum[x0]) / n;
+        double const var = (m_sum2[x1] - m_sum2[x0]) / n - m * m;
+        *mean = m_offset + m;
+        *stdev = sqrt(std::max(var, 0.0));
+    }
+};
+
 struct Peak
 {
     int x;
@@ -471,22 +672,97 @@ struct Peak
     bool operator<(const Peak& rhs) const { return val < rhs.val; }
 };
 
-static void RemoveItems(std::set<Peak>& stars, const std::set<int>& to_erase)
+// greater intensity first
+static bool BrighterPeak(const Peak& a, const Peak& b)
+{
+    return b < a;
+}
+
+static bool SameIntensity(const Peak& a, const Peak& b)
+{
+    return !(a < b) && !(b < a);
+}
+
+// Uniform grid of peak indexes for finding the peaks near a given point. The cell size is at
+// least the search distance, so only the 3x3 block of cells around the point needs to be searched.
+class PeakGrid
+{
+    int m_cellSize;
+    int m_cols;
+    int m_rows;
+    std::vector<int> m_cellStart;   // peaks in cell c are m_items[m_cellStart[c]] .. m_items[m_cellStart[c + 1] - 1]
+    std::vector<int> m_items;
+
+    int Cell(int x, int y) const
+    {
+        int const cx = std::min(std::max(x / m_cellSize, 0), m_cols - 1);
+        int const cy = std::min(std::max(y / m_cellSize, 0), m_rows - 1);
+        return cy * m_cols + cx;
+    }
+
+public:
+
+    // index the peaks for which keep[i] is set
+    PeakGrid(const std::vector<Peak>& peaks, const std::vector<bool>& keep, const wxSize& size, int cellSize)
+        : m_cellSize(std::max(cellSize, 1)),
+        m_cols(size.GetWidth() / m_cellSize + 1),
+        m_rows(size.GetHeight() / m_cellSize + 1),
+        m_cellStart(m_cols * m_rows + 1, 0)
+    {
+        // counting sort by cell
+        for (unsigned int i = 0; i < peaks.size(); i++)
+            if (keep[i])
+                ++m_cellStart[Cell(peaks[i].x, peaks[i].y) + 1];
+        for (unsigned int c = 1; c < m_cellStart.size(); c++)
+            m_cellStart[c] += m_cellStart[c - 1];
+        m_items.resize(m_cellStart.back());
+        std::vector<int> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+        for (unsigned int i = 0; i < peaks.size(); i++)
+            if (keep[i])
+                m_items[fill[Cell(peaks[i].x, peaks[i].y)]++] = i;
+    }
+
+    // get the indexes of the peaks that may be within cellSize of (x, y), in increasing order
+    void Near(int x, int y, std::vector<int> *indexes) const
+    {
+        indexes->clear();
+        int const cx = std::min(std::max(x / m_cellSize, 0), m_cols - 1);
+        int const cy = std::min(std::max(y / m_cellSize, 0), m_rows - 1);
+        for (int j = std::max(cy - 1, 0); j <= std::min(cy + 1, m_rows - 1); j++)
+        {
+            for (int i = std::max(cx - 1, 0); i <= std::min(cx + 1, m_cols - 1); i++)
+            {
+                int const c = j * m_cols + i;
+                indexes->insert(indexes->end(), m_items.begin() + m_cellStart[c], m_items.begin() + m_cellStart[c + 1]);
+            }
+        }
+        std::sort(indexes->begin(), indexes->end());
+    }
+};
+
+// Runs Star::Find on a batch of candidates, one candidate per band.
+struct FindCandidatesTask : public RowBandTask
 {
-    int n = 0;
-    for (std::set<Peak>::iterator it = stars.begin(); it != stars.end(); n++)
+    const usImage& m_image;
+    int m_searchRegion;
+    const std::vector<Peak>& m_peaks;
+    const std::vector<int>& m_order;
+    int m_start;
+    std::vector<Star>& m_results;
+
+    FindCandidatesTask(const usImage& image, int searchRegion, const std::vector<Peak>& peaks, const std::vector<int>& order,
+                       int start, std::vector<Star>& results)
+        : m_image(image), m_searchRegion(searchRegion), m_peaks(peaks), m_order(order), m_start(start), m_results(results) { }
+
+    void Run(int y0, int y1)
     {
-        if (to_erase.find(n) != to_erase.end())
+        for (int i = m_start + y0; i < m_start + y1; i++)
         {
-            std::set<Peak>::iterator next = it;
-            ++next;
-            stars.erase(it);
-            it = next;
+            const Peak& pk = m_peaks[m_order[i]];
+            m_results[i].Find(&m_image, m_searchRegion, pk.x, pk.y, Star::FIND_CENTROID);
         }
-        else
-            ++it;
     }
-}
+};
 
 bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegion)
 {
@@ -498,7 +774,7 @@ bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegi
 
     wxBusyCursor busy;
 
-    Debug.AddLine(wxString::Format("Star::AutoFind called with edgeAllowance = %d searchRegion = %d", extraEdgeAllowance, searchRegion));
+    DEBUG_LOG(DBGLOG_STAR, DBGLOG_NORMAL).AddLine(wxString::Format("Star::AutoFind called with edgeAllowance = %d searchRegion = %d", extraEdgeAllowance, searchRegion));
 
     // run a 3x3 median first to eliminate hot pixels
     usImage smoothed;
@@ -532,50 +808,44 @@ bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegi
     SaveImage(conv, "PHD2_AutoFind.fit");
 
     enum { TOP_N = 100 };  // keep track of the brightest stars
-    std::set<Peak> stars;  // sorted by ascending intensity
+    std::vector<Peak> stars;
 
     double global_mean, global_stdev;
     GetStats(&global_mean, &global_stdev, conv, convRect);
 
-    Debug.AddLine("AutoFind: global mean = %.1f, stdev %.1f", global_mean, global_stdev);
+    DEBUG_LOG(DBGLOG_STAR, DBGLOG_NORMAL).AddLine("AutoFind: global mean = %.1f, stdev %.1f", global_mean, global_stdev);
 
     const double threshold = 0.1;
-    Debug.AddLine("AutoFind: using threshold = %.1f", threshold);
+    DEBUG_LOG(DBGLOG_STAR, DBGLOG_NORMAL).AddLine("AutoFind: using threshold = %.1f", threshold);
 
     // find each local maximum
     int srch = 4;
+    FloatImg peak;
+    MaxFilter(peak, conv, srch);
+
+    const int local = 7;
+    LocalStats localStats(conv, convRect, local, global_mean);
+
     for (int y = convRect.GetTop() + srch; y <= convRect.GetBottom() - srch; y++)
     {
+        bool rowStats = false;
+
         for (int x = convRect.GetLeft() + srch; x <= convRect.GetRight() - srch; x++)
         {
             float val = conv.px[dw * y + x];
-            bool ismax = false;
-            if (val > 0.0)
-            {
-                ismax = true;
-                for (int j = -srch; j <= srch; j++)
-                {
-                    for (int i = -srch; i <= srch; i++)
-                    {
-                        if (i == 0 && j == 0)
-                            continue;
-                        if (conv.px[dw * (y + j) + (x + i)] > val)
-                        {
-                            ismax = false;
-                            break;
-                        }
-                    }
-                }
-            }
-            if (!ismax)
+
+            // a local maximum has no greater value in the search window
+            if (!(val > 0.0) || val < peak.px[dw * y + x])
                 continue;
 
             // compare local maximum to mean value of surrounding pixels
-            const int local = 7;
+            if (!rowStats)
+            {
+                localStats.SetRow(y);
+                rowStats = true;
+            }
             double local_mean, local_stdev;
-            wxRect localRect(x - local, y - local, 2 * local + 1, 2 * local + 1);
-            localRect.Intersect(convRect);
-            GetStats(&local_mean, &local_stdev, conv, localRect);
+            localStats.Get(x, &local_mean, &local_stdev);
 
             // this is our measure of star intensity
             double h = (val - local_mean) / global_stdev;
@@ -590,35 +860,45 @@ bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegi
             int imgx = x * downsample + downsample / 2;
             int imgy = y * downsample + downsample / 2;
 
-            stars.insert(Peak(imgx, imgy, h));
-            if (stars.size() > TOP_N)
-                stars.erase(stars.begin());
+            stars.push_back(Peak(imgx, imgy, h));
         }
     }
 
-    for (std::set<Peak>::const_reverse_iterator it = stars.rbegin(); it != stars.rend(); ++it)
-        Debug.AddLine("AutoFind: local max [%d, %d] %.1f", it->x, it->y, it->val);
+    // keep the TOP_N brightest, sorted by decreasing intensity. Peaks of equal intensity count
+    // as one star, and the first one found is kept.
+    std::stable_sort(stars.begin(), stars.end(), BrighterPeak);
+    stars.erase(std::unique(stars.begin(), stars.end(), SameIntensity), stars.end());
+    if (stars.size() > TOP_N)
+        stars.resize(TOP_N);
+
+    for (std::vector<Peak>::const_iterator it = stars.begin(); it != stars.end(); ++it)
+        DEBUG_LOG(DBGLOG_STAR, DBGLOG_VERBOSE).AddLine("AutoFind: local max [%d, %d] %.1f", it->x, it->y, it->val);
 
-    // merge stars that are very close into a single star
+    std::vector<bool> keep(stars.size(), true);
+    std::vector<int> nearby;
+
+    // merge stars that are very close into a single star: a star is dropped if there is a
+    // brighter star very close to it
     {
-        const int minlimitsq = 5 * 5;
-    repeat:
-        for (std::set<Peak>::const_iterator a = stars.begin(); a != stars.end(); ++a)
+        const int minlimit = 5;
+        const int minlimitsq = minlimit * minlimit;
+        PeakGrid grid(stars, keep, image.Size, minlimit);
+        for (unsigned int a = 0; a < stars.size(); a++)
         {
-            std::set<Peak>::const_iterator b = a;
-            ++b;
-            for (; b != stars.end(); ++b)
+            grid.Near(stars[a].x, stars[a].y, &nearby);
+            for (unsigned int k = 0; k < nearby.size() && nearby[k] < (int) a; k++)
             {
-                int dx = a->x - b->x;
-                int dy = a->y - b->y;
+                const Peak& b = stars[nearby[k]];
+                int dx = stars[a].x - b.x;
+                int dy = stars[a].y - b.y;
                 int d2 = dx * dx + dy * dy;
                 if (d2 < minlimitsq)
                 {
                     // very close, treat as single star
-                    Debug.AddLine("AutoFind: merge [%d, %d] %.1f - [%d, %d] %.1f", a->x, a->y, a->val, b->x, b->y, b->val);
+                    DEBUG_LOG(DBGLOG_STAR, DBGLOG_VERBOSE).AddLine("AutoFind: merge [%d, %d] %.1f - [%d, %d] %.1f", stars[a].x, stars[a].y, stars[a].val, b.x, b.y, b.val);
                     // erase the dimmer one
-                    stars.erase(a);
-                    goto repeat;
+                    keep[a] = false;
+                    break;
                 }
             }
         }
@@ -627,35 +907,43 @@ bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegi
     // exclude stars that would fit within a single searchRegion box
     {
         // build a list of stars to be excluded
-        std::set<int> to_erase;
+        std::vector<bool> erase(stars.size(), false);
         const int extra = 5; // extra safety margin
         const int fullw = searchRegion + extra;
-        for (std::set<Peak>::const_iterator a = stars.begin(); a != stars.end(); ++a)
+        PeakGrid grid(stars, keep, image.Size, fullw);
+        for (unsigned int a = 0; a < stars.size(); a++)
         {
-            std::set<Peak>::const_iterator b = a;
-            ++b;
-            for (; b != stars.end(); ++b)
+            if (!keep[a])
+                continue;
+            grid.Near(stars[a].x, stars[a].y, &nearby);
+            for (unsigned int k = 0; k < nearby.size(); k++)
             {
-                int dx = abs(a->x - b->x);
-                int dy = abs(a->y - b->y);
+                // visit each pair once, with a the brighter star
+                if (nearby[k] <= (int) a)
+                    continue;
+                const Peak& b = stars[nearby[k]];
+                int dx = abs(stars[a].x - b.x);
+                int dy = abs(stars[a].y - b.y);
                 if (dx <= fullw && dy <= fullw)
                 {
                     // stars closer than search region, exclude them both
                     // but do not let a very dim star eliminate a very bright star
-                    if (b->val / a->val >= 5.0)
+                    if (stars[a].val / b.val >= 5.0)
                     {
-                        Debug.AddLine("AutoFind: close dim-bright [%d, %d] %.1f - [%d, %d] %.1f", a->x, a->y, a->val, b->x, b->y, b->val);
+                        DEBUG_LOG(DBGLOG_STAR, DBGLOG_VERBOSE).AddLine("AutoFind: close dim-bright [%d, %d] %.1f - [%d, %d] %.1f", b.x, b.y, b.val, stars[a].x, stars[a].y, stars[a].val);
                     }
                     else
                     {
-                        Debug.AddLine("AutoFind: too close [%d, %d] %.1f - [%d, %d] %.1f", a->x, a->y, a->val, b->x, b->y, b->val);
-                        to_erase.insert(std::distance(stars.begin(), a));
-                        to_erase.insert(std::distance(stars.begin(), b));
+                        DEBUG_LOG(DBGLOG_STAR, DBGLOG_VERBOSE).AddLine("AutoFind: too close [%d, %d] %.1f - [%d, %d] %.1f", b.x, b.y, b.val, stars[a].x, stars[a].y, stars[a].val);
+                        erase[a] = true;
+                        erase[nearby[k]] = true;
                     }
                 }
             }
         }
-        RemoveItems(stars, to_erase);
+        for (unsigned int a = 0; a < stars.size(); a++)
+            if (erase[a])
+                keep[a] = false;
     }
 
     // exclude stars too close to the edge
@@ -663,44 +951,63 @@ bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegi
         enum { MIN_EDGE_DIST = 40 };
         int edgeDist = MIN_EDGE_DIST + extraEdgeAllowance;
 
-        std::set<Peak>::iterator it = stars.begin();
-        while (it != stars.end())
+        for (unsigned int a = 0; a < stars.size(); a++)
         {
-            std::set<Peak>::iterator next = it;
-            ++next;
-            if (it->x <= edgeDist || it->x >= image.Size.GetWidth() - edgeDist ||
-                it->y <= edgeDist || it->y >= image.Size.GetHeight() - edgeDist)
+            if (!keep[a])
+                continue;
+            const Peak& pk = stars[a];
+            if (pk.x <= edgeDist || pk.x >= image.Size.GetWidth() - edgeDist ||
+                pk.y <= edgeDist || pk.y >= image.Size.GetHeight() - edgeDist)
             {
-                Debug.AddLine("AutoFind: too close to edge [%d, %d] %.1f", it->x, it->y, it->val);
-                stars.erase(it);
+                DEBUG_LOG(DBGLOG_STAR, DBGLOG_VERBOSE).AddLine("AutoFind: too close to edge [%d, %d] %.1f", pk.x, pk.y, pk.val);
+                keep[a] = false;
             }
-            it = next;
         }
     }
 
+    // the survivors, brightest first
+    std::vector<int> order;
+    for (unsigned int a = 0; a < stars.size(); a++)
+        if (keep[a])
+            order.push_back(a);
+
     // At first I tried running Star::Find on the survivors to find the best
     // star. This had the unfortunate effect of locating hot pixels which
     // the psf convolution so nicely avoids. So, don't do that!  -ag
 
+    // Run Star::Find on the candidates in batches of one per core, brightest first, and stop at
+    // the first batch containing an acceptable star; the results are kept for the second pass
+    std::vector<Star> found(order.size());
+    int const batch = std::max(1, std::min(wxThread::GetCPUCount(), 4));
+    int nfound = 0;
+
     // find the brightest non-saturated star. If no non-saturated stars, settle for a saturated star.
     bool allowSaturated = false;
     while (true)
     {
-        Debug.AddLine("AutoSelect: finding best star allowSaturated = %d", allowSaturated);
+        DEBUG_LOG(DBGLOG_STAR, DBGLOG_NORMAL).AddLine("AutoSelect: finding best star allowSaturated = %d", allowSaturated);
 
-        for (std::set<Peak>::reverse_iterator it = stars.rbegin(); it != stars.rend(); ++it)
+        for (int i = 0; i < (int) order.size(); i++)
         {
-            Star tmp;
-            tmp.Find(&image, searchRegion, it->x, it->y, FIND_CENTROID);
+            if (i == nfound)
+            {
+                int const n = std::min(batch, (int) order.size() - nfound);
+                FindCandidatesTask task(image, searchRegion, stars, order, nfound, found);
+                RunRowBands(task, n, n);
+                nfound += n;
+            }
+
+            const Peak& pk = stars[order[i]];
+            Star& tmp = found[i];
             if (tmp.WasFound())
             {
                 if (tmp.GetError() == STAR_SATURATED && !allowSaturated)
                 {
-                    Debug.AddLine("Autofind: star saturated [%d, %d] %.1f Mass %.f SNR %.1f", it->x, it->y, it->val, tmp.Mass, tmp.SNR);
+                    DEBUG_LOG(DBGLOG_STAR, DBGLOG_VERBOSE).AddLine("Autofind: star saturated [%d, %d] %.1f Mass %.f SNR %.1f", pk.x, pk.y, pk.val, tmp.Mass, tmp.SNR);
                     continue;
                 }
-                SetXY(it->x, it->y);
-                Debug.AddLine("Autofind returns star at [%d, %d] %.1f Mass %.f SNR %.1f", it->x, it->y, it->val, tmp.Mass, tmp.SNR);
+                SetXY(pk.x, pk.y);
+                DEBUG_LOG(DBGLOG_STAR, DBGLOG_NORMAL).AddLine("Autofind returns star at [%d, %d] %.1f Mass %.f SNR %.1f", pk.x, pk.y, pk.val, tmp.Mass, tmp.SNR);
                 return true;
             }
         }
@@ -708,11 +1015,11 @@ bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegi
         if (allowSaturated)
             break; // no stars found
 
-        Debug.AddLine("AutoFind: could not find a non-saturated star!");
+        DEBUG_LOG(DBGLOG_STAR, DBGLOG_NORMAL).AddLine("AutoFind: could not find a non-saturated star!");
 
         allowSaturated = true;
     }
 
-    Debug.AddLine("Autofind: no star found");
+    DEBUG_LOG(DBGLOG_STAR, DBGLOG_NORMAL).AddLine("Autofind: no star found");
     return false;
 }
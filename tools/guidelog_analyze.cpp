@@ -0,0 +1,377 @@
+/*
+ *  guidelog_analyze.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Summarizes PHD2 guide logs: for each guiding session, the RA, Dec and total
+// RMS, the RA oscillation index, peak errors, star lost count and dither count.
+// The statistics are computed the same way as the graph window's statistics
+// (GraphLogClientWindow::UpdateStats) over the whole session.
+//
+// usage: guidelog_analyze [options] LOG...
+//
+//   --csv              one comma separated line per session
+//   --frames N-M       only use guide steps with frame numbers N through M
+//   --time HH:MM:SS-HH:MM:SS
+//                      for debug logs, print the lines logged in this time range
+//   --no-index         do not read or write the .idx index files
+
+#include "guidelog_reader.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct SessionStats
+{
+    unsigned int steps;
+    double duration;
+    double rmsRa;
+    double rmsDec;
+    double rmsTot;
+    double oscIndex;
+    double raPeak;
+    double decPeak;
+    unsigned int starLost;
+    unsigned int dithers;
+};
+
+struct Options
+{
+    bool csv;
+    bool useIndex;
+    bool frameRange;
+    double frameMin, frameMax;
+    bool timeRange;
+    double timeMin, timeMax;
+};
+
+// same as rms() in graph.cpp
+static double rms(unsigned int nr, double sum_y, double sum_y2)
+{
+    if (nr == 0)
+        return 0.0;
+    double const n = (double) nr;
+    return sqrt(n * sum_y2 - sum_y * sum_y) / n;
+}
+
+static void ComputeStats(const GuideLogReader& log, int sectionIdx, const Options& opts, SessionStats *st)
+{
+    const GuideLogSection& section = log.Sections()[sectionIdx];
+
+    size_t n;
+    size_t first = log.FindRows(section.firstRow, section.rowCount, opts.frameMin, opts.frameMax, &n);
+
+    double sumRa = 0.0, sumRa2 = 0.0, sumDec = 0.0, sumDec2 = 0.0;
+    double prevRa = 0.0;
+    double t0 = 0.0, t1 = 0.0;
+    int raSameSides = 0;
+
+    memset(st, 0, sizeof(*st));
+
+    for (size_t i = 0; i < n; i++)
+    {
+        GuideLogStep step;
+        if (log.GetStep(section, first + i, &step))
+            continue;
+
+        if (st->steps == 0)
+            t0 = step.time;
+        else if (step.raRaw * prevRa > 0.0)
+            ++raSameSides;
+        t1 = step.time;
+        prevRa = step.raRaw;
+
+        sumRa += step.raRaw;
+        sumRa2 += step.raRaw * step.raRaw;
+        sumDec += step.decRaw;
+        sumDec2 += step.decRaw * step.decRaw;
+
+        if (fabs(step.raRaw) > st->raPeak)
+            st->raPeak = fabs(step.raRaw);
+        if (fabs(step.decRaw) > st->decPeak)
+            st->decPeak = fabs(step.decRaw);
+
+        ++st->steps;
+    }
+
+    st->duration = t1 - t0;
+    st->rmsRa = rms(st->steps, sumRa, sumRa2);
+    st->rmsDec = rms(st->steps, sumDec, sumDec2);
+    st->rmsTot = hypot(st->rmsRa, st->rmsDec);
+    st->oscIndex = st->steps >= 2 ? 1.0 - (double) raSameSides / (double) (st->steps - 1) : 0.0;
+
+    // Star lost events are selected by their frame number. Dithers have no
+    // frame number, so a dither is counted when it precedes a selected step.
+    size_t rowEnd = first + n;
+    const std::vector<GuideLogEvent>& events = log.Events();
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const GuideLogEvent& ev = events[i];
+        if (ev.section != sectionIdx)
+            continue;
+        if (ev.type == GLE_STAR_LOST)
+        {
+            double frame = atof(log.Text(ev.offset, ev.offset + 16).c_str());
+            if (frame >= opts.frameMin && frame <= opts.frameMax)
+                ++st->starLost;
+        }
+        else if (ev.type == GLE_DITHER)
+        {
+            if (!opts.frameRange || (ev.row >= first && ev.row < rowEnd))
+                ++st->dithers;
+        }
+    }
+}
+
+static std::string FormatDuration(double secs)
+{
+    char buf[32];
+    long s = (long) (secs + 0.5);
+    sprintf(buf, "%02ld:%02ld:%02ld", s / 3600, (s / 60) % 60, s % 60);
+    return buf;
+}
+
+static std::string FormatTimeOfDay(double ms)
+{
+    char buf[32];
+    long s = (long) (ms / 1000.0);
+    sprintf(buf, "%02ld:%02ld:%02ld.%03ld", (s / 3600) % 24, (s / 60) % 60, s % 60, (long) fmod(ms, 1000.0));
+    return buf;
+}
+
+static std::string SessionStart(const GuideLogSection& section)
+{
+    static const char prefix[] = "Guiding Begins at ";
+    if (section.title.compare(0, sizeof(prefix) - 1, prefix) == 0)
+        return section.title.substr(sizeof(prefix) - 1);
+    return section.title;
+}
+
+static unsigned int AnalyzeGuideLog(const GuideLogReader& log, const Options& opts)
+{
+    const std::vector<GuideLogSection>& sections = log.Sections();
+    unsigned int sessions = 0;
+
+    if (!opts.csv)
+        printf("%s\n", log.Path().c_str());
+
+    for (size_t i = 0; i < sections.size(); i++)
+    {
+        const GuideLogSection& section = sections[i];
+        if (section.type != GLS_GUIDING)
+            continue;
+
+        SessionStats st;
+        ComputeStats(log, (int) i, opts, &st);
+        ++sessions;
+
+        double scale = section.pixelScale;
+
+        if (opts.csv)
+        {
+            printf("\"%s\",%s,%u,%.0f,%.3f,%.3f,%.3f,", log.Path().c_str(), SessionStart(section).c_str(),
+                st.steps, st.duration, st.rmsRa, st.rmsDec, st.rmsTot);
+            if (scale > 0.0)
+                printf("%.3f,%.3f,%.3f,", st.rmsRa * scale, st.rmsDec * scale, st.rmsTot * scale);
+            else
+                printf(",,,");
+            printf("%.2f,%.3f,%.3f,%u,%u\n", st.oscIndex, st.raPeak, st.decPeak, st.starLost, st.dithers);
+        }
+        else
+        {
+            printf("  Guiding %s, %u frames, %s\n", SessionStart(section).c_str(), st.steps,
+                FormatDuration(st.duration).c_str());
+            printf("    RMS RA %.2f, Dec %.2f, Tot %.2f px", st.rmsRa, st.rmsDec, st.rmsTot);
+            if (scale > 0.0)
+                printf(" (%.2f, %.2f, %.2f arc-sec)", st.rmsRa * scale, st.rmsDec * scale, st.rmsTot * scale);
+            printf("\n    RA Osc %.2f%s, Peak RA %.2f, Dec %.2f px, Star lost %u, Dithers %u\n",
+                st.oscIndex, st.steps >= 2 && (st.oscIndex > 0.6 || st.oscIndex < 0.15) ? " (alert)" : "",
+                st.raPeak, st.decPeak, st.starLost, st.dithers);
+        }
+    }
+
+    return sessions;
+}
+
+static void AnalyzeDebugLog(const GuideLogReader& log, const Options& opts)
+{
+    const std::vector<GuideLogRow>& rows = log.Rows();
+
+    if (!opts.timeRange)
+    {
+        if (!opts.csv)
+        {
+            printf("%s\n  debug log, %lu lines", log.Path().c_str(), (unsigned long) rows.size());
+            if (!rows.empty())
+                printf(", %s - %s", FormatTimeOfDay(rows.front().key).c_str(), FormatTimeOfDay(rows.back().key).c_str());
+            printf("\n");
+        }
+        return;
+    }
+
+    // the range may be on the first or (after midnight) a later day of the log
+    double const DAY_MS = 24.0 * 3600.0 * 1000.0;
+    double lastKey = rows.empty() ? 0.0 : rows.back().key;
+    for (double day = 0.0; day <= lastKey; day += DAY_MS)
+    {
+        size_t n;
+        size_t first = log.FindRows(0, rows.size(), opts.timeMin + day, opts.timeMax + day, &n);
+        for (size_t i = 0; i < n; i++)
+            printf("%s\n", log.RowText(first + i).c_str());
+    }
+}
+
+static bool ParseTimeOfDay(const char *s, double *ms)
+{
+    int h, m;
+    double sec = 0.0;
+    int n = sscanf(s, "%d:%d:%lf", &h, &m, &sec);
+    if (n < 2)
+        return true;
+    *ms = ((h * 60.0 + m) * 60.0 + sec) * 1000.0;
+    return false;
+}
+
+static bool ParseTimeRange(const char *arg, Options *opts)
+{
+    const char *dash = strchr(arg, '-');
+    if (!dash)
+        return true;
+    std::string from(arg, dash - arg);
+    if (ParseTimeOfDay(from.c_str(), &opts->timeMin) || ParseTimeOfDay(dash + 1, &opts->timeMax))
+        return true;
+    if (opts->timeMax < opts->timeMin)
+        opts->timeMax += 24.0 * 3600.0 * 1000.0;
+    opts->timeRange = true;
+    return false;
+}
+
+static bool ParseFrameRange(const char *arg, Options *opts)
+{
+    double lo, hi;
+    if (sscanf(arg, "%lf-%lf", &lo, &hi) != 2 || hi < lo)
+        return true;
+    opts->frameRange = true;
+    opts->frameMin = lo;
+    opts->frameMax = hi;
+    return false;
+}
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [--csv] [--frames N-M] [--time HH:MM:SS-HH:MM:SS] [--no-index] LOG...\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    Options opts;
+    opts.csv = false;
+    opts.useIndex = true;
+    opts.frameRange = false;
+    opts.frameMin = -1e30;
+    opts.frameMax = 1e30;
+    opts.timeRange = false;
+    opts.timeMin = opts.timeMax = 0.0;
+
+    std::vector<const char *> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--csv") == 0)
+            opts.csv = true;
+        else if (strcmp(arg, "--no-index") == 0)
+            opts.useIndex = false;
+        else if (strcmp(arg, "--frames") == 0 && i + 1 < argc)
+        {
+            if (ParseFrameRange(argv[++i], &opts))
+            {
+                Usage(argv[0]);
+                return 2;
+            }
+        }
+        else if (strcmp(arg, "--time") == 0 && i + 1 < argc)
+        {
+            if (ParseTimeRange(argv[++i], &opts))
+            {
+                Usage(argv[0]);
+                return 2;
+            }
+        }
+        else if (arg[0] == '-' && arg[1] == '-')
+        {
+            Usage(argv[0]);
+            return 2;
+        }
+        else
+            files.push_back(arg);
+    }
+
+    if (files.empty())
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    if (opts.csv && !opts.timeRange)
+        printf("File,Start,Frames,Duration,RMSRA,RMSDec,RMSTot,RMSRAArcsec,RMSDecArcsec,RMSTotArcsec,RAOsc,PeakRA,PeakDec,StarLost,Dithers\n");
+
+    int ret = 0;
+    unsigned int sessions = 0;
+    unsigned int guideLogs = 0;
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        GuideLogReader log;
+        if (log.Open(files[i], opts.useIndex))
+        {
+            fprintf(stderr, "%s: %s\n", files[i], log.LastError().c_str());
+            ret = 1;
+            continue;
+        }
+
+        if (log.Kind() == GLK_DEBUG_LOG)
+            AnalyzeDebugLog(log, opts);
+        else if (!opts.timeRange)
+        {
+            sessions += AnalyzeGuideLog(log, opts);
+            ++guideLogs;
+        }
+    }
+
+    if (!opts.csv && guideLogs > 1)
+        printf("%u guide logs, %u guiding sessions\n", guideLogs, sessions);
+
+    return ret;
+}
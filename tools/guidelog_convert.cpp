@@ -0,0 +1,102 @@
+/*
+ *  guidelog_convert.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Converts a binary guide log (PHD2_GuideLog_*.bin) to the text guide log
+// format. The output is identical to the text log PHD2 would have written.
+//
+// usage: guidelog_convert INPUT [OUTPUT]
+//
+// OUTPUT defaults to INPUT with the extension replaced by .txt; use - to
+// write to standard output.
+
+#include "guidelog_reader.h"
+
+#include <stdio.h>
+
+static std::string DefaultOutputName(const std::string& input)
+{
+    size_t slash = input.find_last_of("/\\");
+    size_t dot = input.rfind('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return input + ".txt";
+    return input.substr(0, dot) + ".txt";
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "usage: %s INPUT [OUTPUT]\n", argv[0]);
+        return 2;
+    }
+
+    const char *input = argv[1];
+    std::string output = argc > 2 ? argv[2] : DefaultOutputName(input);
+
+    MappedFile file;
+    if (file.Open(input))
+    {
+        fprintf(stderr, "%s: cannot read file\n", input);
+        return 1;
+    }
+
+    std::string text;
+    std::string error;
+    if (GuideLogBinaryToText((const unsigned char *) file.Data(), file.Size(), &text, &error))
+    {
+        fprintf(stderr, "%s: %s\n", input, error.c_str());
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (output != "-")
+    {
+        out = fopen(output.c_str(), "w");
+        if (!out)
+        {
+            fprintf(stderr, "%s: cannot create file\n", output.c_str());
+            return 1;
+        }
+    }
+
+    bool err = fwrite(text.data(), 1, text.size(), out) != text.size();
+
+    if (out != stdout && fclose(out) != 0)
+        err = true;
+
+    if (err)
+        fprintf(stderr, "%s: error writing file\n", output.c_str());
+
+    return err ? 1 : 0;
+}
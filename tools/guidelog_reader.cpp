@@ -0,0 +1,853 @@
+/*
+ *  guidelog_reader.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "guidelog_reader.h"
+#include "../guidelog_binary.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+#define GUIDELOG_INDEX_MAGIC "PHD2GIDX"
+
+enum
+{
+    GUIDELOG_INDEX_VERSION = 1,
+    MAX_FIELDS = 64
+};
+
+MappedFile::MappedFile()
+    : m_data(0),
+    m_size(0),
+#ifdef _WIN32
+    m_file(INVALID_HANDLE_VALUE),
+    m_mapping(0)
+#else
+    m_fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+#ifdef _WIN32
+    // the log may still be open for writing by PHD2
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return true;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        Close();
+        return true;
+    }
+    m_size = (size_t) size.QuadPart;
+
+    if (m_size > 0)
+    {
+        m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+        if (!m_mapping)
+        {
+            Close();
+            return true;
+        }
+        m_data = (const char *) MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!m_data)
+        {
+            Close();
+            return true;
+        }
+    }
+#else
+    m_fd = open(path.c_str(), O_RDONLY);
+    if (m_fd < 0)
+        return true;
+
+    struct stat st;
+    if (fstat(m_fd, &st) != 0)
+    {
+        Close();
+        return true;
+    }
+    m_size = (size_t) st.st_size;
+
+    if (m_size > 0)
+    {
+        void *p = mmap(0, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (p == MAP_FAILED)
+        {
+            Close();
+            return true;
+        }
+        madvise(p, m_size, MADV_SEQUENTIAL);
+        m_data = (const char *) p;
+    }
+#endif
+
+    if (m_size == 0)
+        m_data = "";
+
+    return false;
+}
+
+void MappedFile::Close()
+{
+    bool mapped = m_size > 0 && m_owned.empty();
+
+#ifdef _WIN32
+    if (mapped && m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+    m_mapping = 0;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (mapped && m_data)
+        munmap((void *) m_data, m_size);
+    if (m_fd >= 0)
+        close(m_fd);
+    m_fd = -1;
+#endif
+
+    m_data = 0;
+    m_size = 0;
+    m_owned.clear();
+}
+
+// replaces the file contents with buf, which is taken over (swapped)
+void MappedFile::Adopt(std::string& buf)
+{
+    Close();
+    m_owned.swap(buf);
+    m_data = m_owned.data();
+    m_size = m_owned.size();
+}
+
+bool GuideLogBinaryToText(const unsigned char *data, size_t size, std::string *text, std::string *error)
+{
+    size_t const hdrlen = GUIDELOG_BINARY_MAGIC_LEN + 2;
+
+    if (size < hdrlen || memcmp(data, GUIDELOG_BINARY_MAGIC, GUIDELOG_BINARY_MAGIC_LEN) != 0)
+    {
+        *error = "not a binary guide log";
+        return true;
+    }
+
+    GuideLogReadBuffer hdr(data + GUIDELOG_BINARY_MAGIC_LEN, 2);
+    unsigned int version = hdr.GetU16();
+    if (version > GUIDELOG_BINARY_VERSION)
+    {
+        *error = GuideLogPrintf("unsupported format version %u", version);
+        return true;
+    }
+
+    text->clear();
+    text->reserve(size * 2);
+
+    size_t pos = hdrlen;
+
+    while (pos < size)
+    {
+        if (size - pos < GUIDELOG_RECORD_HEADER_LEN)
+        {
+            *error = GuideLogPrintf("truncated record at offset %lu", (unsigned long) pos);
+            return true;
+        }
+
+        GuideLogReadBuffer rh(data + pos, GUIDELOG_RECORD_HEADER_LEN);
+        unsigned int type = rh.GetU8();
+        size_t len = rh.GetU32();
+
+        if (size - pos - GUIDELOG_RECORD_HEADER_LEN < len)
+        {
+            *error = GuideLogPrintf("truncated record at offset %lu", (unsigned long) pos);
+            return true;
+        }
+
+        const unsigned char *payload = data + pos + GUIDELOG_RECORD_HEADER_LEN;
+        GuideLogReadBuffer rd(payload, len);
+        bool ok = true;
+
+        switch (type)
+        {
+        case GLREC_TEXT:
+            text->append((const char *) payload, len);
+            break;
+        case GLREC_SETTLING:
+            *text += GuideLogFormatSettling(std::string((const char *) payload, len));
+            break;
+        case GLREC_GUIDE_STEP: {
+            GuideLogStepRecord rec;
+            if ((ok = GuideLogDecode(rd, &rec)))
+                *text += GuideLogFormat(rec);
+            break;
+        }
+        case GLREC_FRAME_DROPPED: {
+            GuideLogDropRecord rec;
+            if ((ok = GuideLogDecode(rd, &rec)))
+                *text += GuideLogFormat(rec);
+            break;
+        }
+        case GLREC_CALIBRATION_STEP: {
+            GuideLogCalStepRecord rec;
+            if ((ok = GuideLogDecode(rd, &rec)))
+                *text += GuideLogFormat(rec);
+            break;
+        }
+        case GLREC_CALIBRATION_DIRECTION_COMPLETE: {
+            GuideLogCalDirectionRecord rec;
+            if ((ok = GuideLogDecode(rd, &rec)))
+                *text += GuideLogFormat(rec);
+            break;
+        }
+        case GLREC_DITHER: {
+            GuideLogDitherRecord rec;
+            if ((ok = GuideLogDecode(rd, &rec)))
+                *text += GuideLogFormat(rec);
+            break;
+        }
+        case GLREC_SET_LOCK_POSITION: {
+            GuideLogLockPosRecord rec;
+            if ((ok = GuideLogDecode(rd, &rec)))
+                *text += GuideLogFormat(rec);
+            break;
+        }
+        case GLREC_LOCK_SHIFT: {
+            GuideLogLockShiftRecord rec;
+            if ((ok = GuideLogDecode(rd, &rec)))
+                *text += GuideLogFormat(rec);
+            break;
+        }
+        default:
+            // record type from a newer writer, skip it
+            break;
+        }
+
+        if (!ok)
+        {
+            *error = GuideLogPrintf("malformed record at offset %lu", (unsigned long) pos);
+            return true;
+        }
+
+        pos += GUIDELOG_RECORD_HEADER_LEN + len;
+    }
+
+    return false;
+}
+
+static bool StartsWith(const char *p, size_t len, const char *prefix)
+{
+    size_t n = strlen(prefix);
+    return len >= n && memcmp(p, prefix, n) == 0;
+}
+
+static bool Contains(const char *p, size_t len, const char *s)
+{
+    size_t n = strlen(s);
+    for (size_t i = 0; i + n <= len; i++)
+        if (memcmp(p + i, s, n) == 0)
+            return true;
+    return false;
+}
+
+// the mapped file is not nul terminated, so numbers are copied before parsing
+static double ParseDouble(const char *p, size_t len)
+{
+    char buf[64];
+    if (len >= sizeof(buf))
+        len = sizeof(buf) - 1;
+    memcpy(buf, p, len);
+    buf[len] = 0;
+    return strtod(buf, 0);
+}
+
+static int ParseInt(const char *p, size_t len)
+{
+    return (int) ParseDouble(p, len);
+}
+
+static bool IsDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// splits a CSV line into fields; quoted fields keep their quotes
+static int SplitFields(const char *p, size_t len, const char **field, size_t *flen)
+{
+    int n = 0;
+    size_t start = 0;
+    bool quoted = false;
+
+    for (size_t i = 0; i <= len && n < MAX_FIELDS; i++)
+    {
+        if (i < len && p[i] == '"')
+            quoted = !quoted;
+        else if (i == len || (p[i] == ',' && !quoted))
+        {
+            field[n] = p + start;
+            flen[n] = i - start;
+            ++n;
+            start = i + 1;
+        }
+    }
+
+    return n;
+}
+
+static const char *const s_columnNames[GLCOL_COUNT] =
+{
+    "Frame", "Time", "mount", "dx", "dy", "RARawDistance", "DECRawDistance", "RAGuideDistance", "DECGuideDistance",
+    "RADuration", "RADirection", "DECDuration", "DECDirection", "XStep", "YStep", "StarMass", "SNR", "ErrorCode",
+};
+
+static void MapColumns(const char *p, size_t len, GuideLogSection *section)
+{
+    const char *field[MAX_FIELDS];
+    size_t flen[MAX_FIELDS];
+    int n = SplitFields(p, len, field, flen);
+
+    for (int c = 0; c < GLCOL_COUNT; c++)
+    {
+        section->column[c] = -1;
+        for (int i = 0; i < n; i++)
+        {
+            if (flen[i] == strlen(s_columnNames[c]) && memcmp(field[i], s_columnNames[c], flen[i]) == 0)
+            {
+                section->column[c] = i;
+                break;
+            }
+        }
+    }
+}
+
+GuideLogReader::GuideLogReader()
+    : m_kind(GLK_GUIDE_LOG),
+    m_indexLoaded(false)
+{
+}
+
+void GuideLogReader::Close()
+{
+    m_file.Close();
+    m_sections.clear();
+    m_rows.clear();
+    m_events.clear();
+    m_indexLoaded = false;
+}
+
+static bool FileInfo(const std::string& path, unsigned long long *size, long long *mtime)
+{
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path.c_str(), &st) != 0)
+        return true;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return true;
+#endif
+    *size = (unsigned long long) st.st_size;
+    *mtime = (long long) st.st_mtime;
+    return false;
+}
+
+bool GuideLogReader::Open(const std::string& path, bool useIndexFile)
+{
+    Close();
+
+    m_path = path;
+    m_error.clear();
+
+    unsigned long long logSize;
+    long long logTime;
+
+    if (FileInfo(path, &logSize, &logTime) || m_file.Open(path))
+    {
+        m_error = "cannot open file";
+        return true;
+    }
+
+    const char *data = m_file.Data();
+    size_t size = m_file.Size();
+
+    if (size >= GUIDELOG_BINARY_MAGIC_LEN && memcmp(data, GUIDELOG_BINARY_MAGIC, GUIDELOG_BINARY_MAGIC_LEN) == 0)
+    {
+        std::string text;
+        if (GuideLogBinaryToText((const unsigned char *) data, size, &text, &m_error))
+        {
+            Close();
+            return true;
+        }
+        m_file.Adopt(text);
+        data = m_file.Data();
+        size = m_file.Size();
+    }
+
+    if (StartsWith(data, size, "PHD2 version"))
+        m_kind = GLK_GUIDE_LOG;
+    else if (size >= 13 && IsDigit(data[0]) && IsDigit(data[1]) && data[2] == ':' && data[8] == '.')
+        m_kind = GLK_DEBUG_LOG;
+    else
+    {
+        m_error = "not a PHD2 guide log or debug log";
+        Close();
+        return true;
+    }
+
+    std::string idxPath = path + ".idx";
+
+    if (useIndexFile && !LoadIndex(idxPath, logSize, logTime))
+    {
+        m_indexLoaded = true;
+        return false;
+    }
+
+    BuildIndex();
+
+    if (useIndexFile)
+        SaveIndex(idxPath, logSize, logTime);   // not being able to save the index is not an error
+
+    return false;
+}
+
+void GuideLogReader::BuildIndex()
+{
+    m_sections.clear();
+    m_rows.clear();
+    m_events.clear();
+
+    if (m_kind == GLK_DEBUG_LOG)
+        BuildDebugLogIndex();
+    else
+        BuildGuideLogIndex();
+}
+
+void GuideLogReader::BuildGuideLogIndex()
+{
+    const char *data = m_file.Data();
+    size_t const size = m_file.Size();
+    int cur = -1;
+
+    for (size_t pos = 0; pos < size; )
+    {
+        const char *line = data + pos;
+        const char *nl = (const char *) memchr(line, '\n', size - pos);
+        size_t next = nl ? (size_t) (nl - data) + 1 : size;
+        size_t len = (nl ? nl : data + size) - line;
+        if (len > 0 && line[len - 1] == '\r')
+            --len;
+
+        bool cal = StartsWith(line, len, "Calibration Begins at ");
+        bool guide = StartsWith(line, len, "Guiding Begins at ");
+
+        if (cal || guide)
+        {
+            if (cur >= 0)
+                m_sections[cur].end = pos;
+
+            GuideLogSection s;
+            s.type = cal ? GLS_CALIBRATION : GLS_GUIDING;
+            s.begin = pos;
+            s.end = size;
+            s.firstRow = m_rows.size();
+            s.rowCount = 0;
+            for (int c = 0; c < GLCOL_COUNT; c++)
+                s.column[c] = -1;
+            s.pixelScale = 0.0;
+            s.title.assign(line, len);
+            m_sections.push_back(s);
+            cur = (int) m_sections.size() - 1;
+        }
+        else if (cur >= 0 && (StartsWith(line, len, "Guiding Ends at ") || StartsWith(line, len, "Calibration complete, mount = ")))
+        {
+            m_sections[cur].end = next;
+            cur = -1;
+        }
+        else if (StartsWith(line, len, "INFO: "))
+        {
+            GuideLogEvent ev;
+            ev.type = -1;
+            if (StartsWith(line, len, "INFO: DITHER "))
+                ev.type = GLE_DITHER;
+            else if (StartsWith(line, len, "INFO: SET LOCK POSITION"))
+                ev.type = GLE_SET_LOCK_POSITION;
+            else if (StartsWith(line, len, "INFO: SETTLING STATE CHANGE"))
+                ev.type = GLE_SETTLING;
+
+            if (ev.type >= 0)
+            {
+                ev.section = cur;
+                ev.row = m_rows.size();
+                ev.offset = pos;
+                m_events.push_back(ev);
+            }
+        }
+        else if (cur >= 0)
+        {
+            GuideLogSection& s = m_sections[cur];
+
+            if (StartsWith(line, len, "Frame,Time,"))
+                MapColumns(line, len, &s);
+            else if (StartsWith(line, len, "Pixel scale = "))
+                s.pixelScale = ParseDouble(line + 14, len - 14);
+            else if (s.type == GLS_GUIDING && len > 0 && IsDigit(line[0]))
+            {
+                if (Contains(line, len, ",\"DROP\","))
+                {
+                    GuideLogEvent ev;
+                    ev.type = GLE_STAR_LOST;
+                    ev.section = cur;
+                    ev.row = m_rows.size();
+                    ev.offset = pos;
+                    m_events.push_back(ev);
+                }
+                else
+                {
+                    GuideLogRow row;
+                    row.offset = pos;
+                    row.length = (unsigned int) len;
+                    row.key = ParseInt(line, len);
+                    m_rows.push_back(row);
+                    ++s.rowCount;
+                }
+            }
+            else if (s.type == GLS_CALIBRATION)
+            {
+                // Direction,Step,dx,dy,x,y,Dist
+                const char *comma = (const char *) memchr(line, ',', len);
+                if (comma && comma + 1 < line + len && !memchr(line, ' ', comma - line) &&
+                    (IsDigit(comma[1]) || comma[1] == '-'))
+                {
+                    GuideLogRow row;
+                    row.offset = pos;
+                    row.length = (unsigned int) len;
+                    row.key = ParseInt(comma + 1, line + len - comma - 1);
+                    m_rows.push_back(row);
+                    ++s.rowCount;
+                }
+            }
+        }
+
+        pos = next;
+    }
+}
+
+void GuideLogReader::BuildDebugLogIndex()
+{
+    const char *data = m_file.Data();
+    size_t const size = m_file.Size();
+    double const DAY_MS = 24.0 * 3600.0 * 1000.0;
+    double dayOffset = 0.0;
+    double last = 0.0;
+
+    for (size_t pos = 0; pos < size; )
+    {
+        const char *line = data + pos;
+        const char *nl = (const char *) memchr(line, '\n', size - pos);
+        size_t next = nl ? (size_t) (nl - data) + 1 : size;
+        size_t len = (nl ? nl : data + size) - line;
+        if (len > 0 && line[len - 1] == '\r')
+            --len;
+
+        // HH:MM:SS.mmm
+        bool stamped = len >= 12 && IsDigit(line[0]) && IsDigit(line[1]) && line[2] == ':' &&
+            IsDigit(line[3]) && IsDigit(line[4]) && line[5] == ':' && IsDigit(line[6]) && IsDigit(line[7]) &&
+            line[8] == '.' && IsDigit(line[9]) && IsDigit(line[10]) && IsDigit(line[11]);
+
+        if (stamped)
+        {
+            double ms = (((line[0] - '0') * 10 + (line[1] - '0')) * 3600.0 +
+                ((line[3] - '0') * 10 + (line[4] - '0')) * 60.0 +
+                ((line[6] - '0') * 10 + (line[7] - '0'))) * 1000.0 +
+                (line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0');
+
+            // the log continues past midnight
+            if (ms + dayOffset < last - DAY_MS / 2.0)
+                dayOffset += DAY_MS;
+
+            GuideLogRow row;
+            row.offset = pos;
+            row.length = (unsigned int) len;
+            row.key = ms + dayOffset;
+            m_rows.push_back(row);
+            last = row.key;
+        }
+        else if (!m_rows.empty())
+        {
+            // a continuation of the previous line's message
+            GuideLogRow& row = m_rows.back();
+            row.length = (unsigned int) (pos + len - row.offset);
+        }
+
+        pos = next;
+    }
+}
+
+static void PutU64(GuideLogWriteBuffer& b, unsigned long long v)
+{
+    b.PutU32((unsigned int) (v & 0xffffffffu));
+    b.PutU32((unsigned int) (v >> 32));
+}
+
+static unsigned long long GetU64(GuideLogReadBuffer& b)
+{
+    unsigned long long lo = b.GetU32();
+    unsigned long long hi = b.GetU32();
+    return lo | (hi << 32);
+}
+
+bool GuideLogReader::SaveIndex(const std::string& idxPath, unsigned long long logSize, long long logTime) const
+{
+    GuideLogWriteBuffer b;
+
+    b.PutBytes(GUIDELOG_INDEX_MAGIC, 8);
+    b.PutU16(GUIDELOG_INDEX_VERSION);
+    b.PutU8(m_kind);
+    PutU64(b, logSize);
+    PutU64(b, (unsigned long long) logTime);
+
+    b.PutU32((unsigned int) m_sections.size());
+    for (size_t i = 0; i < m_sections.size(); i++)
+    {
+        const GuideLogSection& s = m_sections[i];
+        b.PutU8(s.type);
+        PutU64(b, s.begin);
+        PutU64(b, s.end);
+        b.PutU32((unsigned int) s.firstRow);
+        b.PutU32((unsigned int) s.rowCount);
+        for (int c = 0; c < GLCOL_COUNT; c++)
+            b.PutI32(s.column[c]);
+        b.PutF64(s.pixelScale);
+        b.PutStr(s.title);
+    }
+
+    b.PutU32((unsigned int) m_rows.size());
+    for (size_t i = 0; i < m_rows.size(); i++)
+    {
+        PutU64(b, m_rows[i].offset);
+        b.PutU32(m_rows[i].length);
+        b.PutF64(m_rows[i].key);
+    }
+
+    b.PutU32((unsigned int) m_events.size());
+    for (size_t i = 0; i < m_events.size(); i++)
+    {
+        const GuideLogEvent& ev = m_events[i];
+        b.PutU8(ev.type);
+        b.PutI32(ev.section);
+        b.PutU32((unsigned int) ev.row);
+        PutU64(b, ev.offset);
+    }
+
+    b.PutBytes(GUIDELOG_INDEX_MAGIC, 8);
+
+    FILE *fp = fopen(idxPath.c_str(), "wb");
+    if (!fp)
+        return true;
+    bool err = fwrite(b.Data(), 1, b.Size(), fp) != b.Size();
+    if (fclose(fp) != 0)
+        err = true;
+    if (err)
+        remove(idxPath.c_str());
+    return err;
+}
+
+bool GuideLogReader::LoadIndex(const std::string& idxPath, unsigned long long logSize, long long logTime)
+{
+    MappedFile idx;
+    if (idx.Open(idxPath))
+        return true;
+
+    GuideLogReadBuffer b((const unsigned char *) idx.Data(), idx.Size());
+
+    char magic[8];
+    b.GetBytes(magic, 8);
+    if (memcmp(magic, GUIDELOG_INDEX_MAGIC, 8) != 0 || b.GetU16() != GUIDELOG_INDEX_VERSION ||
+        (int) b.GetU8() != m_kind || GetU64(b) != logSize || GetU64(b) != (unsigned long long) logTime)
+    {
+        return true;
+    }
+
+    size_t const dataSize = m_file.Size();
+    std::vector<GuideLogSection> sections(b.GetU32());
+    for (size_t i = 0; i < sections.size() && !b.Error(); i++)
+    {
+        GuideLogSection& s = sections[i];
+        s.type = b.GetU8();
+        s.begin = GetU64(b);
+        s.end = GetU64(b);
+        s.firstRow = b.GetU32();
+        s.rowCount = b.GetU32();
+        for (int c = 0; c < GLCOL_COUNT; c++)
+            s.column[c] = b.GetI32();
+        s.pixelScale = b.GetF64();
+        s.title = b.GetStr();
+        if (s.begin > s.end || s.end > dataSize)
+            return true;
+    }
+
+    std::vector<GuideLogRow> rows(b.GetU32());
+    for (size_t i = 0; i < rows.size() && !b.Error(); i++)
+    {
+        GuideLogRow& r = rows[i];
+        r.offset = GetU64(b);
+        r.length = b.GetU32();
+        r.key = b.GetF64();
+        if (r.offset + r.length > dataSize)
+            return true;
+    }
+
+    std::vector<GuideLogEvent> events(b.GetU32());
+    for (size_t i = 0; i < events.size() && !b.Error(); i++)
+    {
+        GuideLogEvent& ev = events[i];
+        ev.type = b.GetU8();
+        ev.section = b.GetI32();
+        ev.row = b.GetU32();
+        ev.offset = GetU64(b);
+    }
+
+    b.GetBytes(magic, 8);
+    if (b.Error() || memcmp(magic, GUIDELOG_INDEX_MAGIC, 8) != 0)
+        return true;
+
+    for (size_t i = 0; i < sections.size(); i++)
+        if (sections[i].firstRow + sections[i].rowCount > rows.size())
+            return true;
+
+    m_sections.swap(sections);
+    m_rows.swap(rows);
+    m_events.swap(events);
+
+    return false;
+}
+
+std::string GuideLogReader::Text(unsigned long long begin, unsigned long long end) const
+{
+    if (end > m_file.Size())
+        end = m_file.Size();
+    if (begin >= end)
+        return std::string();
+    return std::string(m_file.Data() + begin, (size_t) (end - begin));
+}
+
+std::string GuideLogReader::RowText(size_t row) const
+{
+    const GuideLogRow& r = m_rows[row];
+    return Text(r.offset, r.offset + r.length);
+}
+
+static bool KeyLess(const GuideLogRow& row, double key)
+{
+    return row.key < key;
+}
+
+static bool LessKey(double key, const GuideLogRow& row)
+{
+    return key < row.key;
+}
+
+size_t GuideLogReader::FindRows(size_t first, size_t count, double keyMin, double keyMax, size_t *n) const
+{
+    std::vector<GuideLogRow>::const_iterator begin = m_rows.begin() + first;
+    std::vector<GuideLogRow>::const_iterator end = begin + count;
+
+    std::vector<GuideLogRow>::const_iterator lo = std::lower_bound(begin, end, keyMin, KeyLess);
+    std::vector<GuideLogRow>::const_iterator hi = std::upper_bound(lo, end, keyMax, LessKey);
+
+    *n = hi - lo;
+    return lo - m_rows.begin();
+}
+
+bool GuideLogReader::GetStep(const GuideLogSection& section, size_t row, GuideLogStep *step) const
+{
+    if (section.type != GLS_GUIDING || section.column[GLCOL_FRAME] < 0)
+        return true;
+
+    const GuideLogRow& r = m_rows[row];
+    const char *field[MAX_FIELDS];
+    size_t flen[MAX_FIELDS];
+    int n = SplitFields(m_file.Data() + r.offset, r.length, field, flen);
+
+    const int *col = section.column;
+#define FIELD(c) (col[c] >= 0 && col[c] < n ? field[col[c]] : ""), (col[c] >= 0 && col[c] < n ? flen[col[c]] : 0)
+
+    step->frame = ParseInt(FIELD(GLCOL_FRAME));
+    step->time = ParseDouble(FIELD(GLCOL_TIME));
+    step->ao = col[GLCOL_MOUNT] >= 0 && col[GLCOL_MOUNT] < n && flen[col[GLCOL_MOUNT]] == 4 &&
+        memcmp(field[col[GLCOL_MOUNT]], "\"AO\"", 4) == 0;
+    step->dx = ParseDouble(FIELD(GLCOL_DX));
+    step->dy = ParseDouble(FIELD(GLCOL_DY));
+    step->raRaw = ParseDouble(FIELD(GLCOL_RA_RAW));
+    step->decRaw = ParseDouble(FIELD(GLCOL_DEC_RAW));
+    step->raGuide = ParseDouble(FIELD(GLCOL_RA_GUIDE));
+    step->decGuide = ParseDouble(FIELD(GLCOL_DEC_GUIDE));
+    if (step->ao)
+    {
+        step->raDuration = ParseInt(FIELD(GLCOL_XSTEP));
+        step->decDuration = ParseInt(FIELD(GLCOL_YSTEP));
+    }
+    else
+    {
+        step->raDuration = ParseInt(FIELD(GLCOL_RA_DURATION));
+        step->decDuration = ParseInt(FIELD(GLCOL_DEC_DURATION));
+    }
+    step->starMass = ParseDouble(FIELD(GLCOL_STAR_MASS));
+    step->snr = ParseDouble(FIELD(GLCOL_SNR));
+    step->errorCode = ParseInt(FIELD(GLCOL_ERROR_CODE));
+
+#undef FIELD
+
+    return false;
+}
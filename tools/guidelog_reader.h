@@ -0,0 +1,226 @@
+/*
+ *  guidelog_reader.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDELOG_READER_H_INCLUDED
+#define GUIDELOG_READER_H_INCLUDED
+
+/*
+ * Guide log reader
+ *
+ * Reads PHD2 guide logs (text or binary) and debug logs without loading them
+ * into memory: the file is memory mapped and an index of its contents is built
+ * in one pass. The index is saved next to the log as <log>.idx and reused as
+ * long as the log's size and modification time are unchanged, so later queries
+ * on the same log do not have to scan it again.
+ *
+ * For a guide log the index holds the calibration and guiding sections, the
+ * column layout of each section, the byte range of each data row, and the
+ * dither, star lost, lock position and settling events. For a debug log it
+ * holds the byte range and time of each timestamped line.
+ *
+ * Rows are kept in file order. A row's key is the frame number (guide steps),
+ * the step number (calibration steps) or the time of day in milliseconds
+ * (debug log lines, continuing past 24h when the log spans midnight), so range
+ * queries are binary searches.
+ *
+ * Binary guide logs are decoded to the text form in memory; offsets then refer
+ * to the decoded text.
+ */
+
+#include <string>
+#include <vector>
+
+// Read-only view of a file's contents, memory mapped where possible
+class MappedFile
+{
+    const char *m_data;
+    size_t m_size;
+    std::string m_owned;
+#ifdef _WIN32
+    void *m_file;
+    void *m_mapping;
+#else
+    int m_fd;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool Open(const std::string& path);
+    void Close();
+    void Adopt(std::string& buf);
+
+    const char *Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+};
+
+enum GUIDELOG_KIND
+{
+    GLK_GUIDE_LOG,
+    GLK_DEBUG_LOG
+};
+
+enum GUIDELOG_SECTION_TYPE
+{
+    GLS_CALIBRATION,
+    GLS_GUIDING
+};
+
+enum GUIDELOG_EVENT_TYPE
+{
+    GLE_DITHER,
+    GLE_STAR_LOST,
+    GLE_SET_LOCK_POSITION,
+    GLE_SETTLING
+};
+
+// columns of a guiding section, located by name in the section's header line
+enum GUIDELOG_COLUMN
+{
+    GLCOL_FRAME,
+    GLCOL_TIME,
+    GLCOL_MOUNT,
+    GLCOL_DX,
+    GLCOL_DY,
+    GLCOL_RA_RAW,
+    GLCOL_DEC_RAW,
+    GLCOL_RA_GUIDE,
+    GLCOL_DEC_GUIDE,
+    GLCOL_RA_DURATION,
+    GLCOL_RA_DIRECTION,
+    GLCOL_DEC_DURATION,
+    GLCOL_DEC_DIRECTION,
+    GLCOL_XSTEP,
+    GLCOL_YSTEP,
+    GLCOL_STAR_MASS,
+    GLCOL_SNR,
+    GLCOL_ERROR_CODE,
+    GLCOL_COUNT
+};
+
+struct GuideLogRow
+{
+    unsigned long long offset;  // byte offset of the line
+    unsigned int length;        // line length excluding the line terminator
+    double key;
+};
+
+struct GuideLogSection
+{
+    int type;                   // GUIDELOG_SECTION_TYPE
+    unsigned long long begin;   // byte range of the section
+    unsigned long long end;
+    size_t firstRow;            // rows belonging to the section
+    size_t rowCount;
+    int column[GLCOL_COUNT];    // field position of each column, -1 if absent
+    double pixelScale;          // arc-sec/px, 0 if unspecified
+    std::string title;          // e.g. "Guiding Begins at 2015-01-31 20:12:40"
+};
+
+struct GuideLogEvent
+{
+    int type;                   // GUIDELOG_EVENT_TYPE
+    int section;                // section index, -1 if outside a section
+    size_t row;                 // number of rows preceding the event
+    unsigned long long offset;
+};
+
+// a guide step row parsed according to its section's columns
+struct GuideLogStep
+{
+    int frame;
+    double time;
+    bool ao;
+    double dx, dy;
+    double raRaw, decRaw;
+    double raGuide, decGuide;
+    int raDuration, decDuration;
+    double starMass;
+    double snr;
+    int errorCode;
+};
+
+class GuideLogReader
+{
+    std::string m_path;
+    MappedFile m_file;
+    int m_kind;
+    bool m_indexLoaded;
+    std::string m_error;
+
+    std::vector<GuideLogSection> m_sections;
+    std::vector<GuideLogRow> m_rows;
+    std::vector<GuideLogEvent> m_events;
+
+    void BuildIndex();
+    void BuildGuideLogIndex();
+    void BuildDebugLogIndex();
+    bool LoadIndex(const std::string& idxPath, unsigned long long logSize, long long logTime);
+    bool SaveIndex(const std::string& idxPath, unsigned long long logSize, long long logTime) const;
+
+public:
+    GuideLogReader();
+
+    // Opens a log and loads or builds its index. Returns true on error.
+    bool Open(const std::string& path, bool useIndexFile = true);
+    void Close();
+
+    const std::string& LastError() const { return m_error; }
+    const std::string& Path() const { return m_path; }
+    int Kind() const { return m_kind; }
+    bool IndexLoaded() const { return m_indexLoaded; }
+
+    const std::vector<GuideLogSection>& Sections() const { return m_sections; }
+    const std::vector<GuideLogRow>& Rows() const { return m_rows; }
+    const std::vector<GuideLogEvent>& Events() const { return m_events; }
+
+    std::string RowText(size_t row) const;
+    std::string Text(unsigned long long begin, unsigned long long end) const;
+
+    // rows in [first, first + count) with key in [keyMin, keyMax]; returns the
+    // index of the first such row and sets *n to the number of rows
+    size_t FindRows(size_t first, size_t count, double keyMin, double keyMax, size_t *n) const;
+
+    // parses a guide step row of a guiding section; returns true on error
+    bool GetStep(const GuideLogSection& section, size_t row, GuideLogStep *step) const;
+};
+
+// Decodes a binary guide log to the text guide log. Returns true on error.
+bool GuideLogBinaryToText(const unsigned char *data, size_t size, std::string *text, std::string *error);
+
+#endif // GUIDELOG_READER_H_INCLUDED
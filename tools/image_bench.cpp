@@ -0,0 +1,511 @@
+/*
+ *  image_bench.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 Developers
+ *  Copyright (c) 2026 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Times the per-frame image kernels (image_simd.cpp) at each SIMD level the CPU
+// supports, on a 16-bit FITS frame, and checks that every level produces the
+// same result. The 3x3 median is also compared with a plain per-pixel sort of
+// the neighborhood, which is how Median3 worked before it was vectorized, and the
+// Star::Find centroid is compared with the threshold-at-a-time loop it replaced,
+// on 15x15 stamps around the stars in the frame.
+//
+// usage: image_bench [FITS] [ITERATIONS]
+//
+// FITS defaults to simimage.fit. The frame is measured as loaded and tiled 3x3,
+// so that the large frame case is covered too.
+
+#include "../image_simd.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+static double NowMs(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double) now.QuadPart * 1000.0 / (double) freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1000.0 + (double) ts.tv_nsec / 1.0e6;
+#endif
+}
+
+struct Frame
+{
+    int width;
+    int height;
+    std::vector<unsigned short> pixels;
+};
+
+static bool HeaderValue(const std::string& card, const char *key, long *val)
+{
+    size_t const len = strlen(key);
+    if (card.compare(0, len, key) != 0 || (card.size() > len && card[len] != ' ' && card[len] != '='))
+        return false;
+    size_t eq = card.find('=');
+    if (eq == std::string::npos)
+        return false;
+    *val = strtol(card.c_str() + eq + 1, 0, 10);
+    return true;
+}
+
+// reads the primary image of a 16-bit, 2-axis FITS file
+static bool ReadFits(const char *path, Frame *frame, std::string *err)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        *err = "cannot open file";
+        return false;
+    }
+
+    long bitpix = 0, naxis = 0, naxis1 = 0, naxis2 = 0, bzero = 0;
+    bool end = false;
+    char card[81];
+    card[80] = 0;
+
+    while (!end && fread(card, 1, 80, fp) == 80)
+    {
+        std::string c(card);
+        HeaderValue(c, "BITPIX", &bitpix);
+        HeaderValue(c, "NAXIS", &naxis);
+        HeaderValue(c, "NAXIS1", &naxis1);
+        HeaderValue(c, "NAXIS2", &naxis2);
+        HeaderValue(c, "BZERO", &bzero);
+        end = c.compare(0, 4, "END ") == 0;
+    }
+
+    if (!end || bitpix != 16 || naxis != 2 || naxis1 <= 2 || naxis2 <= 2)
+    {
+        fclose(fp);
+        *err = "not a 16-bit 2-axis FITS image";
+        return false;
+    }
+
+    // the data starts at the next 2880 byte block
+    long const pos = ftell(fp);
+    fseek(fp, (pos + 2879) / 2880 * 2880, SEEK_SET);
+
+    frame->width = (int) naxis1;
+    frame->height = (int) naxis2;
+    size_t const n = (size_t) naxis1 * naxis2;
+    std::vector<unsigned char> raw(n * 2);
+    bool ok = fread(&raw[0], 1, raw.size(), fp) == raw.size();
+    fclose(fp);
+
+    if (!ok)
+    {
+        *err = "truncated image data";
+        return false;
+    }
+
+    frame->pixels.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        short const v = (short) ((raw[2 * i] << 8) | raw[2 * i + 1]);
+        frame->pixels[i] = (unsigned short) (v + bzero);
+    }
+
+    return true;
+}
+
+static void Tile(const Frame& src, int nx, int ny, Frame *dst)
+{
+    dst->width = src.width * nx;
+    dst->height = src.height * ny;
+    dst->pixels.resize((size_t) dst->width * dst->height);
+    for (int y = 0; y < dst->height; y++)
+    {
+        const unsigned short *s = &src.pixels[(size_t) (y % src.height) * src.width];
+        unsigned short *d = &dst->pixels[(size_t) y * dst->width];
+        for (int x = 0; x < nx; x++)
+            memcpy(d + x * src.width, s, src.width * sizeof(unsigned short));
+    }
+}
+
+// the dark subtraction done by SubtractDarkFused: find the largest dark excess
+// over the whole frame, then subtract with that offset so nothing clips at 0
+static void DarkSubtract(const ImageKernels& k, unsigned short *light, const unsigned short *dark, int width, int height)
+{
+    unsigned short offset = 0;
+    for (int y = 0; y < height; y++)
+        offset = std::max(offset, k.darkDeficit(light + y * width, dark + y * width, width));
+    for (int y = 0; y < height; y++)
+        k.darkSubtract(light + y * width, dark + y * width, width, offset);
+}
+
+// interior pixels of the 3x3 median; the border handling is scalar code shared by all levels
+static void Median3Interior(const ImageKernels& k, unsigned short *dst, const unsigned short *src, int width, int height)
+{
+    for (int y = 1; y < height - 1; y++)
+    {
+        const unsigned short *r = src + (y - 1) * width;
+        k.median3x3(dst + y * width + 1, r, r + width, r + 2 * width, width - 2);
+    }
+}
+
+static void Median3Reference(unsigned short *dst, const unsigned short *src, int width, int height)
+{
+    unsigned short a[9];
+    for (int y = 1; y < height - 1; y++)
+    {
+        for (int x = 1; x < width - 1; x++)
+        {
+            int n = 0;
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++)
+                    a[n++] = src[(y + dy) * width + x + dx];
+            std::nth_element(a, a + 4, a + 9);
+            dst[y * width + x] = a[4];
+        }
+    }
+}
+
+static void Report(const char *what, const char *level, double ms, int iterations, double baseMs, bool same)
+{
+    printf("  %-14s %-6s %9.3f ms/frame  %6.2fx%s\n", what, level, ms / iterations, baseMs / ms,
+           same ? "" : "  RESULT DIFFERS");
+}
+
+// a Star::Find centroid window: 15x15 around a star, with the thresholds
+// Star::Find derives from the 31x31 search region around it
+struct Stamp
+{
+    int x0;
+    int y0;
+    int width;
+    int height;
+    double thresh[3];
+};
+
+struct Centroid
+{
+    double mass;
+    double mx;
+    double my;
+
+    bool operator==(const Centroid& rhs) const
+    {
+        return memcmp(this, &rhs, sizeof(*this)) == 0;
+    }
+};
+
+// up to maxStamps of the brightest local maxima, at least 15 pixels apart
+static void FindStamps(const Frame& frame, size_t maxStamps, std::vector<Stamp> *stamps)
+{
+    int const w = frame.width;
+    int const h = frame.height;
+    const unsigned short *p = &frame.pixels[0];
+
+    double sum = 0.0, sum2 = 0.0;
+    for (size_t i = 0; i < frame.pixels.size(); i++)
+    {
+        sum += p[i];
+        sum2 += (double) p[i] * p[i];
+    }
+    double const mean = sum / frame.pixels.size();
+    double const sd = sqrt(std::max(0.0, sum2 / frame.pixels.size() - mean * mean));
+
+    std::vector<std::pair<unsigned short, int> > peaks;
+    for (int y = 15; y < h - 15; y++)
+        for (int x = 15; x < w - 15; x++)
+        {
+            unsigned short const v = p[y * w + x];
+            if (v < mean + 5.0 * sd)
+                continue;
+            bool isMax = true;
+            for (int dy = -1; dy <= 1 && isMax; dy++)
+                for (int dx = -1; dx <= 1; dx++)
+                    if (p[(y + dy) * w + x + dx] > v)
+                    {
+                        isMax = false;
+                        break;
+                    }
+            if (isMax)
+                peaks.push_back(std::make_pair(v, y * w + x));
+        }
+    std::sort(peaks.rbegin(), peaks.rend());
+
+    stamps->clear();
+    for (size_t i = 0; i < peaks.size() && stamps->size() < maxStamps; i++)
+    {
+        int const cx = peaks[i].second % w;
+        int const cy = peaks[i].second / w;
+
+        bool tooClose = false;
+        for (size_t j = 0; j < stamps->size(); j++)
+            if (abs((*stamps)[j].x0 + 7 - cx) < 15 && abs((*stamps)[j].y0 + 7 - cy) < 15)
+                tooClose = true;
+        if (tooClose)
+            continue;
+
+        unsigned short localMin = 65535, localMax = 0;
+        double localSum = 0.0;
+        for (int y = cy - 15; y <= cy + 15; y++)
+            for (int x = cx - 15; x <= cx + 15; x++)
+            {
+                unsigned short const v = p[y * w + x];
+                localMin = std::min(localMin, v);
+                localMax = std::max(localMax, v);
+                localSum += v;
+            }
+        double const localMean = localSum / (31.0 * 31.0);
+        double const max = localMax - localMin;
+
+        Stamp s;
+        s.x0 = cx - 7;
+        s.y0 = cy - 7;
+        s.width = 15;
+        s.height = 15;
+        s.thresh[0] = localMean + (max + localMin - localMean) / 10.0;
+        s.thresh[1] = localMean;
+        s.thresh[2] = (double) localMin;
+        stamps->push_back(s);
+    }
+}
+
+// the loop Star::Find used before: one pass over the window per threshold,
+// stopping at the first threshold that gives a mass of at least 10
+static Centroid CentroidReference(const Frame& frame, const Stamp& s)
+{
+    Centroid c;
+    c.mass = 0.0;
+    for (int i = 0; i < 3 && c.mass < 10.0; i++)
+    {
+        c.mass = c.mx = c.my = 0.000001;
+        for (int y = s.y0; y < s.y0 + s.height; y++)
+            for (int x = s.x0; x < s.x0 + s.width; x++)
+            {
+                double val = (double) frame.pixels[y * frame.width + x] - s.thresh[i];
+                if (val > 0.0)
+                {
+                    c.mx += (double) x * val;
+                    c.my += (double) y * val;
+                    c.mass += val;
+                }
+            }
+    }
+    return c;
+}
+
+// what Star::Find does now: gather the window, mask the pixels above all three
+// thresholds in one pass, then sum the masked pixels for each threshold tried
+static Centroid CentroidGathered(const ImageKernels& k, const Frame& frame, const Stamp& s)
+{
+    unsigned short win[15 * 15];
+    unsigned int above[3 * 8];
+    int const n = s.width * s.height;
+    int const words = (n + 31) / 32;
+
+    for (int y = 0; y < s.height; y++)
+        memcpy(&win[y * s.width], &frame.pixels[(s.y0 + y) * frame.width + s.x0], s.width * sizeof(unsigned short));
+
+    k.thresholdMask(above, win, n, s.thresh, 3);
+
+    Centroid c;
+    c.mass = 0.0;
+    for (int i = 0; i < 3 && c.mass < 10.0; i++)
+    {
+        c.mass = c.mx = c.my = 0.000001;
+        MaskedCentroid(win, s.width, n, s.x0, s.y0, &above[i * words], s.thresh[i], &c.mass, &c.mx, &c.my);
+    }
+    return c;
+}
+
+static bool BenchStamps(const Frame& frame, int iterations)
+{
+    std::vector<Stamp> stamps;
+    FindStamps(frame, 200, &stamps);
+    if (stamps.empty())
+    {
+        printf("star stamps: no stars found\n\n");
+        return true;
+    }
+
+    printf("star stamps: %u stars, %d iterations\n", (unsigned int) stamps.size(), iterations);
+
+    size_t const n = stamps.size();
+    std::vector<Centroid> ref(n), res(n);
+    bool allSame = true;
+
+    double t0 = NowMs();
+    for (int it = 0; it < iterations; it++)
+        for (size_t i = 0; i < n; i++)
+            ref[i] = CentroidReference(frame, stamps[i]);
+    double const refMs = NowMs() - t0;
+    printf("  %-14s %-6s %9.3f us/star\n", "centroid", "loop", refMs * 1000.0 / (iterations * n));
+
+    for (int level = SIMD_NONE; level <= GetCpuSimdLevel(); level++)
+    {
+        const ImageKernels& k = GetImageKernels((SimdLevel) level);
+
+        t0 = NowMs();
+        for (int it = 0; it < iterations; it++)
+            for (size_t i = 0; i < n; i++)
+                res[i] = CentroidGathered(k, frame, stamps[i]);
+        double const ms = NowMs() - t0;
+        bool const same = res == ref;
+        printf("  %-14s %-6s %9.3f us/star  %6.2fx%s\n", "centroid", SimdLevelName((SimdLevel) level),
+               ms * 1000.0 / (iterations * n), refMs / ms, same ? "" : "  RESULT DIFFERS");
+        allSame = allSame && same;
+    }
+
+    printf("\n");
+    return allSame;
+}
+
+static bool Bench(const Frame& frame, int iterations)
+{
+    int const w = frame.width;
+    int const h = frame.height;
+    size_t const n = frame.pixels.size();
+
+    printf("%dx%d (%.1f MP), %d iterations\n", w, h, (double) n / 1.0e6, iterations);
+
+    // a deterministic dark frame, some pixels brighter than the light frame
+    std::vector<unsigned short> dark(n);
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < n; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        dark[i] = (unsigned short) (200 + ((seed >> 16) % 400));
+    }
+
+    std::vector<unsigned char> lut(65536 + 3);
+    for (int i = 0; i < 65536; i++)
+        lut[i] = (unsigned char) (i >> 8);
+
+    std::vector<unsigned short> work(n), darkRef(n), medRef(n, 0), med(n, 0);
+    std::vector<unsigned char> rgb(n * 3), rgbRef(n * 3);
+    bool allSame = true;
+
+    double t0 = NowMs();
+    for (int i = 0; i < iterations; i++)
+        Median3Reference(&medRef[0], &frame.pixels[0], w, h);
+    double const sortMs = NowMs() - t0;
+    Report("median3", "sort", sortMs, iterations, sortMs, true);
+
+    double darkBase = 0.0, rgbBase = 0.0;
+
+    for (int level = SIMD_NONE; level <= GetCpuSimdLevel(); level++)
+    {
+        const ImageKernels& k = GetImageKernels((SimdLevel) level);
+        const char *name = SimdLevelName((SimdLevel) level);
+
+        double darkMs = 0.0;
+        for (int i = 0; i < iterations; i++)
+        {
+            work = frame.pixels;
+            t0 = NowMs();
+            DarkSubtract(k, &work[0], &dark[0], w, h);
+            darkMs += NowMs() - t0;
+        }
+        if (level == SIMD_NONE)
+        {
+            darkRef = work;
+            darkBase = darkMs;
+        }
+        bool same = work == darkRef;
+        Report("dark subtract", name, darkMs, iterations, darkBase, same);
+        allSame = allSame && same;
+
+        t0 = NowMs();
+        for (int i = 0; i < iterations; i++)
+            Median3Interior(k, &med[0], &frame.pixels[0], w, h);
+        double const medMs = NowMs() - t0;
+        same = med == medRef;
+        Report("median3", name, medMs, iterations, sortMs, same);
+        allSame = allSame && same;
+
+        t0 = NowMs();
+        for (int i = 0; i < iterations; i++)
+            k.stretchToRGB(&rgb[0], &frame.pixels[0], &lut[0], (int) n);
+        double const rgbMs = NowMs() - t0;
+        if (level == SIMD_NONE)
+        {
+            rgbRef = rgb;
+            rgbBase = rgbMs;
+        }
+        same = rgb == rgbRef;
+        Report("stretch", name, rgbMs, iterations, rgbBase, same);
+        allSame = allSame && same;
+    }
+
+    printf("\n");
+    return allSame;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 3)
+    {
+        fprintf(stderr, "usage: %s [FITS] [ITERATIONS]\n", argv[0]);
+        return 2;
+    }
+
+    const char *path = argc > 1 ? argv[1] : "simimage.fit";
+    int const iterations = argc > 2 ? std::max(1, atoi(argv[2])) : 20;
+
+    Frame frame;
+    std::string err;
+    if (!ReadFits(path, &frame, &err))
+    {
+        fprintf(stderr, "%s: %s\n", path, err.c_str());
+        return 1;
+    }
+
+    printf("CPU SIMD level: %s\n\n", SimdLevelName(GetCpuSimdLevel()));
+
+    Frame large;
+    Tile(frame, 3, 3, &large);
+
+    bool ok = Bench(frame, iterations);
+    ok = Bench(large, std::max(1, iterations / 4)) && ok;
+    ok = BenchStamps(frame, iterations * 50) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -35,6 +35,12 @@
 #include "phd.h"
 #include "image_math.h"
 
+#include <algorithm>
+
+#if defined(__WINDOWS__)
+#include <malloc.h>
+#endif
+
 bool usImage::Init(const wxSize& size)
 {
     // Allocates space for image and sets params up
@@ -46,13 +52,13 @@ bool usImage::Init(const wxSize& size)
     Subframe = wxRect(0, 0, 0, 0);
     Min = Max = 0;
 
-    if (NPixels != prev)
+    if (NPixels != prev || !ImageData)
     {
-        delete[] ImageData;
+        FreeImageData(ImageData);
 
         if (NPixels)
         {
-            ImageData = new unsigned short[NPixels];
+            ImageData = AllocImageData(NPixels);
             if (!ImageData)
             {
                 NPixels = 0;
@@ -66,6 +72,28 @@ bool usImage::Init(const wxSize& size)
     return false;
 }
 
+unsigned short *usImage::AllocImageData(int npixels)
+{
+    size_t const nbytes = npixels * sizeof(unsigned short);
+#if defined(__WINDOWS__)
+    return static_cast<unsigned short *>(_aligned_malloc(nbytes, IMAGE_DATA_ALIGNMENT));
+#else
+    void *p;
+    if (posix_memalign(&p, IMAGE_DATA_ALIGNMENT, nbytes) != 0)
+        return NULL;
+    return static_cast<unsigned short *>(p);
+#endif
+}
+
+void usImage::FreeImageData(unsigned short *data)
+{
+#if defined(__WINDOWS__)
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
 void usImage::SwapImageData(usImage& other)
 {
     unsigned short *t = ImageData;
@@ -73,82 +101,92 @@ void usImage::SwapImageData(usImage& other)
     other.ImageData = t;
 }
 
-void usImage::CalcStats()
+void usImage::CalcStats(void)
 {
     if (!ImageData || !NPixels)
         return;
 
-    Min = 65535; Max = 0;
-    FiltMin = 65535; FiltMax = 0;
-
-    if (Subframe.IsEmpty())
-    {
-        // full frame, no subframe
+    wxRect const rect = Subframe.IsEmpty() ? wxRect(Size) : Subframe;
+    CalcImageStats(*this, rect, &Min, &Max, &FiltMin, &FiltMax);
+}
 
-        const unsigned short *src;
+const unsigned char *StretchLUT::Get(int blevel, int wlevel, double power)
+{
+    enum { LUT_SIZE = 65536, LUT_PAD = 3 }; // the vectorized stretch reads 4 bytes per entry
 
-        src = ImageData;
-        for (int i = 0; i < NPixels; i++)
+    if (!m_lut.empty() && power == m_power)
+    {
+        if (blevel == m_blevel && wlevel == m_wlevel)
+            return &m_lut[0];
+
+        // While the levels move by less than 1/64 of the range the cached table is reused. This
+        // is an approximation: the displayed pixels then differ slightly from an exact stretch
+        // with the new levels, by up to about 4 of 255 steps. With gamma 1 only the white level
+        // is used.
+        int const tolerance = (m_wlevel - (power == 1.0 ? 0 : m_blevel)) / 64;
+        if (m_blevel < m_wlevel && blevel < wlevel &&
+            abs(wlevel - m_wlevel) < tolerance && (power == 1.0 || abs(blevel - m_blevel) < tolerance))
         {
-            int d = (int) *src++;
-            if (d < Min) Min = d;
-            if (d > Max) Max = d;
+            return &m_lut[0];
         }
+    }
 
-        unsigned short *tmpdata = new unsigned short[NPixels];
-
-        Median3(tmpdata, ImageData, Size, wxRect(Size));
-
-        src = tmpdata;
-        for (int i = 0; i < NPixels; i++)
-        {
-            int d = (int) *src++;
-            if (d < FiltMin) FiltMin = d;
-            if (d > FiltMax) FiltMax = d;
-        }
+    m_lut.resize(LUT_SIZE + LUT_PAD);
+    unsigned char *lut = &m_lut[0];
 
-        delete[] tmpdata;
+    if (power == 1.0 || blevel >= wlevel)
+    {
+        int const range = wxMax(1, wlevel);  // Go 0-max
+        int const end = wxMin(range, (int) LUT_SIZE);
+        for (int i = 0; i < end; i++)
+            lut[i] = (unsigned char) (((float) i / (float) range) * 255.0);
+        memset(lut + end, 255, LUT_SIZE - end);
     }
     else
     {
-        // Subframe
-
-        unsigned int pixcnt = Subframe.width * Subframe.height;
-        unsigned short *tmpdata = new unsigned short[pixcnt];
-
-        unsigned short *dst;
-
-        dst = tmpdata;
-        for (int y = 0; y < Subframe.height; y++)
+        // only the entries between the black and white levels need pow()
+        // clamp to the table, the levels can lie outside 0..65535
+        int const lo = wxMin(wxMax(blevel + 1, 0), (int) LUT_SIZE);
+        int const hi = wxMin(wxMax(wlevel, lo), (int) LUT_SIZE);
+        memset(lut, 0, lo);
+        float range = (float) (wlevel - blevel);
+        for (int i = lo; i < hi; i++)
         {
-            const unsigned short *src = ImageData + Subframe.x + (Subframe.y + y) * Size.GetWidth();
-            for (int x = 0; x < Subframe.width; x++)
-            {
-               int d = (int) *src;
-               if (d < Min) Min = d;
-               if (d > Max) Max = d;
-               *dst++ = *src++;
-            }
+            float d = ((float) i - (float) blevel) / range;
+            lut[i] = (unsigned char) (pow(d, (float) power) * 255.0);
         }
+        memset(lut + hi, 255, LUT_SIZE - hi);
+    }
 
-        dst = new unsigned short[pixcnt];
+    memset(lut + LUT_SIZE, 0, LUT_PAD);
 
-        Median3(dst, tmpdata, Subframe.GetSize(), wxRect(Subframe.GetSize()));
+    m_blevel = blevel;
+    m_wlevel = wlevel;
+    m_power = power;
 
-        const unsigned short *src = dst;
-        for (unsigned int i = 0; i < pixcnt; i++)
-        {
-            int d = (int) *src++;
-            if (d < FiltMin) FiltMin = d;
-            if (d > FiltMax) FiltMax = d;
-        }
+    return lut;
+}
+
+struct StretchTask : public RowBandTask
+{
+    unsigned char *m_dst;
+    const unsigned short *m_src;
+    int m_width;
+    const unsigned char *m_lut;
+    const ImageKernels& m_kernels;
 
-        delete[] dst;
-        delete[] tmpdata;
+    StretchTask(unsigned char *dst, const unsigned short *src, int width, const unsigned char *lut)
+        : m_dst(dst), m_src(src), m_width(width), m_lut(lut), m_kernels(GetImageKernels()) { }
+
+    void Run(int y0, int y1)
+    {
+        m_kernels.stretchToRGB(m_dst + y0 * m_width * 3, m_src + y0 * m_width, m_lut, (y1 - y0) * m_width);
     }
-}
+};
 
-bool usImage::CopyToImage(wxImage **rawimg, int blevel, int wlevel, double power)
+// Stretches the image into an RGB image of the same size. If the existing image can be
+// reused, only rows [y0, y1) are rendered; y1 < 0 means the last row.
+bool usImage::CopyToImage(wxImage **rawimg, int blevel, int wlevel, double power, StretchLUT *lut, int y0, int y1)
 {
     wxImage *img = *rawimg;
 
@@ -156,121 +194,126 @@ bool usImage::CopyToImage(wxImage **rawimg, int blevel, int wlevel, double power
     {
         delete img;
         img = new wxImage(Size.GetWidth(), Size.GetHeight(), false);
+        y0 = 0;
+        y1 = -1;
     }
 
-    unsigned char *ImgPtr = img->GetData();
-    unsigned short *RawPtr = ImageData;
+    if (y1 < 0 || y1 > Size.GetHeight())
+        y1 = Size.GetHeight();
+    if (y0 < 0)
+        y0 = 0;
 
-    if (power == 1.0 || blevel >= wlevel)
+    StretchLUT tmpLut;
+    if (!lut)
+        lut = &tmpLut;
+
+    if (y0 < y1)
     {
-        float range = (float) wxMax(1, wlevel);  // Go 0-max
-        for (int i = 0; i < NPixels; i++, RawPtr++)
-        {
-            float d;
-            if (*RawPtr >= range)
-                d = 255.0;
-            else
-                d = ((float) (*RawPtr) / range) * 255.0;
-
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
-        }
+        int const width = Size.GetWidth();
+        StretchTask task(img->GetData() + y0 * width * 3, ImageData + y0 * width, width, lut->Get(blevel, wlevel, power));
+        RunRowBands(task, y1 - y0, BandThreadCount(width * (y1 - y0)));
     }
-    else
+
+    *rawimg = img;
+    return false;
+}
+
+// Downscales by averaging the block of source pixels that falls on each output
+// pixel, then stretches the averages through the lookup table. Each band keeps
+// its own column sums, so bands can run in parallel.
+struct ScaledStretchTask : public RowBandTask
+{
+    const unsigned short *m_src;
+    wxSize m_srcSize;
+    unsigned char *m_dst;
+    wxSize m_dstSize;
+    int m_dstY0;
+    const unsigned char *m_lut;
+    const ImageKernels& m_kernels;
+
+    ScaledStretchTask(const usImage& src, unsigned char *dst, const wxSize& dstSize, int dstY0, const unsigned char *lut)
+        : m_src(src.ImageData), m_srcSize(src.Size), m_dst(dst), m_dstSize(dstSize), m_dstY0(dstY0), m_lut(lut),
+          m_kernels(GetImageKernels()) { }
+
+    void Run(int y0, int y1)
     {
-        float range = (float) (wlevel - blevel);
-        for (int i = 0; i < NPixels; i++, RawPtr++ )
+        int const srcW = m_srcSize.GetWidth();
+        int const srcH = m_srcSize.GetHeight();
+        int const dstW = m_dstSize.GetWidth();
+        int const dstH = m_dstSize.GetHeight();
+
+        std::vector<int> xStart(dstW + 1);
+        for (int x = 0; x <= dstW; x++)
+            xStart[x] = (int)((long long) x * srcW / dstW);
+
+        std::vector<unsigned int> colSum(srcW);
+        std::vector<unsigned short> row(dstW);
+
+        for (int y = m_dstY0 + y0; y < m_dstY0 + y1; y++)
         {
-            float d;
-            if (*RawPtr <= blevel)
-                d = 0.0;
-            else if (*RawPtr >= wlevel)
-                d = 255.0;
-            else
+            int const sy0 = (int)((long long) y * srcH / dstH);
+            int const sy1 = (int)((long long) (y + 1) * srcH / dstH);
+
+            std::fill(colSum.begin(), colSum.end(), 0);
+            for (int sy = sy0; sy < sy1; sy++)
             {
-                d = ((float) (*RawPtr) - (float) blevel) / range;
-                d = pow(d, (float) power) * 255.0;
+                const unsigned short *p = m_src + sy * srcW;
+                for (int sx = 0; sx < srcW; sx++)
+                    colSum[sx] += p[sx];
             }
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
+
+            for (int x = 0; x < dstW; x++)
+            {
+                unsigned long long sum = 0;
+                for (int sx = xStart[x]; sx < xStart[x + 1]; sx++)
+                    sum += colSum[sx];
+                row[x] = (unsigned short)(sum / ((unsigned long long) (xStart[x + 1] - xStart[x]) * (sy1 - sy0)));
+            }
+
+            m_kernels.stretchToRGB(m_dst + y * dstW * 3, &row[0], m_lut, dstW);
         }
     }
+};
 
-    *rawimg = img;
-    return false;
-}
-
-bool usImage::BinnedCopyToImage(wxImage **rawimg, int blevel, int wlevel, double power)
+// Renders the image downscaled to size (which must be no larger than the image in either
+// dimension) and stretched, in a single pass over the 16-bit data. If the existing image
+// has the right size, only output rows [y0, y1) are rendered; y1 < 0 means the last row.
+bool usImage::CopyToScaledImage(wxImage **rawimg, const wxSize& size, int blevel, int wlevel, double power,
+                                StretchLUT *lut, int y0, int y1)
 {
-    wxImage *img;
-    unsigned char *ImgPtr;
-    unsigned short *RawPtr;
-    int x,y;
-    float d;
-    //, s_factor;
-    int full_xsize, full_ysize;
-    int use_xsize, use_ysize;
-
-    full_xsize = Size.GetWidth();
-    full_ysize = Size.GetHeight();
-    use_xsize = full_xsize;
-    use_ysize = full_ysize;
-    if (use_xsize % 2) use_xsize--;
-    if (use_ysize % 2) use_ysize--;
-//  Binsize = 2;
-
-    img = *rawimg;
-    if ((!img->Ok()) || (img->GetWidth() != (full_xsize/2)) || (img->GetHeight() != (full_ysize/2)) ) {  // can't reuse bitmap
-        if (img->Ok()) {
-            delete img;  // Clear out current image if it exists
-            img = (wxImage *) NULL;
-        }
-        img = new wxImage(full_xsize/2, full_ysize/2, false);
+    if (size.GetWidth() <= 0 || size.GetHeight() <= 0 ||
+        size.GetWidth() > Size.GetWidth() || size.GetHeight() > Size.GetHeight())
+    {
+        return true;
     }
-    ImgPtr = img->GetData();
-    RawPtr = ImageData;
-//  s_factor = (((float) Max - (float) Min) / 255.0);
-    float range = (float) (wlevel - blevel);
-
-    if ((power == 1.0) || (range == 0.0)) {
-        range = wlevel;  // Go 0-max
-        if (range == 0.0) range = 0.001;
-        for (y=0; y<use_ysize; y+=2) {
-            for (x=0; x<use_xsize; x+=2) {
-                RawPtr = ImageData + x + y*full_xsize;
-                d = (float) (*RawPtr + *(RawPtr+1) + *(RawPtr+full_xsize) + *(RawPtr+1+full_xsize)) / 4.0;
-                d = (d / range) * 255.0;
-                if (d < 0.0) d = 0.0;
-                else if (d > 255.0) d = 255.0;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-            }
-        }
+
+    wxImage *img = *rawimg;
+
+    if (!img || !img->Ok() || img->GetSize() != size) // can't reuse bitmap
+    {
+        delete img;
+        img = new wxImage(size.GetWidth(), size.GetHeight(), false);
+        y0 = 0;
+        y1 = -1;
     }
-    else {
-        for (y=0; y<use_ysize; y+=2) {
-            for (x=0; x<use_xsize; x+=2) {
-                RawPtr = ImageData + x + y*full_xsize;
-                d = (float) (*RawPtr + *(RawPtr+1) + *(RawPtr+full_xsize) + *(RawPtr+1+full_xsize)) / 4.0;
-                d = (d - (float) blevel) / range ;
-                if (d < 0.0) d= 0.0;
-                else if (d > 1.0) d = 1.0;
-                d = pow(d, (float) power) * 255.0;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-            }
-        }
+
+    if (y1 < 0 || y1 > size.GetHeight())
+        y1 = size.GetHeight();
+    if (y0 < 0)
+        y0 = 0;
+
+    StretchLUT tmpLut;
+    if (!lut)
+        lut = &tmpLut;
+
+    if (y0 < y1)
+    {
+        ScaledStretchTask task(*this, img->GetData(), size, y0, lut->Get(blevel, wlevel, power));
+        // the source pixels read for the output rows; 64 bits, a large frame overflows int
+        long long srcPixels = (long long) Size.GetWidth() * Size.GetHeight() * (y1 - y0) / size.GetHeight();
+        RunRowBands(task, y1 - y0, BandThreadCount((int) wxMin(srcPixels, (long long) INT_MAX)));
     }
+
     *rawimg = img;
     return false;
 }
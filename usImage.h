@@ -35,6 +35,23 @@
 #ifndef USIMAGECLASS
 #define USIMAGECLASS
 
+// Table mapping 16-bit pixel values to 8-bit display values for a black level,
+// white level and gamma. The levels usually come from the image statistics and
+// move a little with every frame, so the table is reused while both levels stay
+// within 1/64 of the black-white range (about 4 display levels) of the levels it
+// was built for.
+class StretchLUT
+{
+    std::vector<unsigned char> m_lut;
+    int m_blevel;
+    int m_wlevel;
+    double m_power;
+
+public:
+    StretchLUT() : m_blevel(0), m_wlevel(0), m_power(0.0) { }
+    const unsigned char *Get(int blevel, int wlevel, double power);
+};
+
 class usImage
 {
 public:
@@ -47,27 +64,33 @@ public:
     int                 FiltMin, FiltMax;
     time_t              ImgStartTime;
     int                 ImgExpDur;
+    wxLongLong          ImgStartMs;     // UTC ms when the exposure was started (estimated by streaming cameras), 0 if unknown
+    wxLongLong          ImgEndMs;       // UTC ms when the camera returned the frame
     int                 ImgStackCnt;
 
+    // image buffers are aligned so that vectorized image processing can use aligned loads
+    enum { IMAGE_DATA_ALIGNMENT = 32 };
+
     usImage() {
-        Min = Max = FiltMin = FiltMax = 0;
         NPixels = 0;
         ImageData = NULL;
-        ImgStartTime = 0;
-        ImgExpDur = 0;
-        ImgStackCnt = 1;
+        ResetMetadata();
     }
-    ~usImage() { delete[] ImageData; }
+    ~usImage() { FreeImageData(ImageData); }
+
+    void                ResetMetadata();
 
     bool                Init(const wxSize& size);
     bool                Init(int width, int height) { return Init(wxSize(width, height)); }
     void                SwapImageData(usImage& other);
-    void                CalcStats();
+    void                CalcStats(void);
     void                InitImgStartTime();
     wxString            GetImgStartTime() const;
     bool                CopyFrom(const usImage& src);
-    bool                CopyToImage(wxImage **img, int blevel, int wlevel, double power);
-    bool                BinnedCopyToImage(wxImage **img, int blevel, int wlevel, double power); // Does 2x2 bin during copy
+    bool                CopyToImage(wxImage **img, int blevel, int wlevel, double power, StretchLUT *lut = 0,
+                                    int y0 = 0, int y1 = -1);
+    bool                CopyToScaledImage(wxImage **img, const wxSize& size, int blevel, int wlevel, double power,
+                                          StretchLUT *lut = 0, int y0 = 0, int y1 = -1);
     bool                CopyFromImage(const wxImage& img);
     bool                Load(const wxString& fname);
     bool                Save(const wxString& fname, const wxString& hdrComment = wxEmptyString) const;
@@ -75,8 +98,21 @@ public:
     unsigned short&     Pixel(int x, int y) { return ImageData[y * Size.x + x]; }
     const unsigned short& Pixel(int x, int y) const { return ImageData[y * Size.x + x]; }
     void                Clear(void);
+
+    static unsigned short *AllocImageData(int npixels);
+    static void         FreeImageData(unsigned short *data);
 };
 
+inline void usImage::ResetMetadata()
+{
+    Subframe = wxRect(0, 0, 0, 0);
+    Min = Max = FiltMin = FiltMax = 0;
+    ImgStartTime = 0;
+    ImgExpDur = 0;
+    ImgStartMs = ImgEndMs = 0;
+    ImgStackCnt = 1;
+}
+
 inline void usImage::Clear(void)
 {
     memset(ImageData, 0, NPixels * sizeof(unsigned short));
@@ -35,12 +35,93 @@
 
 #include "phd.h"
 
+/*************      Latency statistics      **************************/
+
+void LatencyHistogram::Reset(void)
+{
+    count = 0;
+    totalMs = 0.0;
+    maxMs = 0.0;
+    for (int i = 0; i < NUM_BUCKETS; i++)
+        buckets[i] = 0;
+}
+
+double LatencyHistogram::BucketLimitMs(int bucket)
+{
+    static const double limits[NUM_BUCKETS - 1] = {
+        1., 2., 5., 10., 20., 50., 100., 200., 500., 1000., 2000., 5000., 10000., 30000.,
+    };
+
+    return bucket < NUM_BUCKETS - 1 ? limits[bucket] : -1.0;
+}
+
+void LatencyHistogram::Add(double ms)
+{
+    int bucket = 0;
+    while (bucket < NUM_BUCKETS - 1 && ms >= BucketLimitMs(bucket))
+        ++bucket;
+
+    ++buckets[bucket];
+    ++count;
+    totalMs += ms;
+    if (ms > maxMs)
+        maxMs = ms;
+}
+
+double LatencyHistogram::MeanMs(void) const
+{
+    return count ? totalMs / count : 0.0;
+}
+
+void WorkerLatencyStats::Reset(void)
+{
+    for (int i = 0; i < NUM_KINDS; i++)
+    {
+        queued[i].Reset();
+        service[i].Reset();
+    }
+    frameToPulse.Reset();
+}
+
+const char *WorkerLatencyStats::KindName(int kind)
+{
+    switch (kind)
+    {
+        case KIND_EXPOSE:           return "expose";
+        case KIND_MOVE:             return "move";
+        case KIND_CALIBRATION_MOVE: return "calibration_move";
+        default:                    return "unknown";
+    }
+}
+
+/*************      Request ring      **************************/
+
+WorkerThread::WORKER_THREAD_REQUEST& WorkerThread::RequestRing::Push(const WORKER_THREAD_REQUEST& request)
+{
+    assert(!Full());
+    WORKER_THREAD_REQUEST& slot = m_slots[(m_head + m_count) % RING_SIZE];
+    slot = request;
+    ++m_count;
+    return slot;
+}
+
+void WorkerThread::RequestRing::Pop(WORKER_THREAD_REQUEST *request)
+{
+    assert(!Empty());
+    *request = m_slots[m_head];
+    m_head = (m_head + 1) % RING_SIZE;
+    --m_count;
+}
+
 WorkerThread::WorkerThread(MyFrame *pFrame)
     : wxThread(wxTHREAD_JOINABLE),
       m_interruptRequested(0),
-      m_killable(true)
+      m_killable(true),
+      m_queueNotEmpty(m_queueLock),
+      m_terminatePending(false)
 {
     m_pFrame = pFrame;
+    m_stats.Reset();
     Debug.AddLine("WorkerThread constructor called");
 }
 
@@ -49,24 +130,124 @@ WorkerThread::~WorkerThread(void)
     Debug.AddLine("WorkerThread destructor called");
 }
 
-void WorkerThread::EnqueueMessage(const WORKER_THREAD_REQUEST& message)
+// returns true if the ring was full and the request was not queued. Never
+// blocks: the caller may be the main thread, which the worker thread could be
+// waiting on.
+bool WorkerThread::EnqueueMessage(const WORKER_THREAD_REQUEST& message)
 {
-    wxMessageQueueError queueError;
+    bool full;
 
-    if (message.request == REQUEST_EXPOSE)
     {
-        queueError = m_lowPriorityQueue.Post(message);
+        wxMutexLocker lock(m_queueLock);
+
+        RequestRing& ring = message.request == REQUEST_EXPOSE ? m_lowPriorityRing : m_highPriorityRing;
+
+        full = ring.Full();
+
+        if (!full)
+        {
+            WORKER_THREAD_REQUEST& queued = ring.Push(message);
+            queued.enqueueTime = ::wxGetUTCTimeUSec().GetValue();
+        }
+        else if (message.request == REQUEST_TERMINATE)
+        {
+            m_terminatePending = true;
+        }
+
+        if (!full || message.request == REQUEST_TERMINATE)
+            m_queueNotEmpty.Signal();
+    }
+
+    if (full)
+    {
+        Debug.AddLine("worker thread request ring full, request type %d not queued", message.request);
+    }
+
+    return full;
+}
+
+void WorkerThread::DequeueMessage(WORKER_THREAD_REQUEST *message)
+{
+    wxMutexLocker lock(m_queueLock);
+
+    while (m_highPriorityRing.Empty() && m_lowPriorityRing.Empty() && !m_terminatePending)
+    {
+        m_queueNotEmpty.Wait();
+    }
+
+    if (m_terminatePending)
+    {
+        // the terminate request did not fit in the ring; anything still
+        // queued is abandoned, as it would have been interrupted anyway
+        memset(message, 0, sizeof(*message));
+        message->request = REQUEST_TERMINATE;
+        message->enqueueTime = ::wxGetUTCTimeUSec().GetValue();
+    }
+    else if (!m_highPriorityRing.Empty())
+    {
+        m_highPriorityRing.Pop(message);
     }
     else
     {
-        queueError = m_highPriorityQueue.Post(message);
+        m_lowPriorityRing.Pop(message);
     }
+}
+
+/*************      Latency      **************************/
+
+void WorkerThread::RecordLatency(const WORKER_THREAD_REQUEST& message, wxLongLong_t dispatchTime, wxLongLong_t completeTime)
+{
+    int kind;
+
+    if (message.request == REQUEST_EXPOSE)
+        kind = WorkerLatencyStats::KIND_EXPOSE;
+    else if (message.args.move.calibrationMove)
+        kind = WorkerLatencyStats::KIND_CALIBRATION_MOVE;
+    else
+        kind = WorkerLatencyStats::KIND_MOVE;
 
-    assert(queueError == wxMSGQUEUE_NO_ERROR);
+    double queuedMs = (double)(dispatchTime - message.enqueueTime) / 1000.0;
+    double serviceMs = (double)(completeTime - dispatchTime) / 1000.0;
 
-    queueError = m_wakeupQueue.Post(true);
+    wxCriticalSectionLocker lock(m_statsLock);
+    m_stats.queued[kind].Add(queuedMs);
+    m_stats.service[kind].Add(serviceMs);
+}
 
-    assert(queueError == wxMSGQUEUE_NO_ERROR);
+void WorkerThread::GetLatencyStats(WorkerLatencyStats *stats)
+{
+    wxCriticalSectionLocker lock(m_statsLock);
+    *stats = m_stats;
+}
+
+void WorkerThread::ResetLatencyStats(void)
+{
+    wxCriticalSectionLocker lock(m_statsLock);
+    m_stats.Reset();
+}
+
+void WorkerThread::LogLatencyStats(void)
+{
+    WorkerLatencyStats stats;
+    GetLatencyStats(&stats);
+
+    for (int kind = 0; kind < WorkerLatencyStats::NUM_KINDS; kind++)
+    {
+        const LatencyHistogram& queued = stats.queued[kind];
+        const LatencyHistogram& service = stats.service[kind];
+
+        if (!queued.count)
+            continue;
+
+        Debug.AddLine(wxString::Format("worker thread %s latency: n=%u queued mean=%.2f max=%.2f ms, service mean=%.1f max=%.1f ms",
+            WorkerLatencyStats::KindName(kind), queued.count, queued.MeanMs(), queued.maxMs, service.MeanMs(), service.maxMs));
+    }
+
+    if (stats.frameToPulse.count)
+    {
+        Debug.AddLine(wxString::Format("worker thread camera to pulse latency: n=%u mean=%.1f max=%.1f ms",
+            stats.frameToPulse.count, stats.frameToPulse.MeanMs(), stats.frameToPulse.maxMs));
+    }
 }
 
 /*************      Terminate      **************************/
@@ -91,7 +272,7 @@ void WorkerThread::EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposur
     WORKER_THREAD_REQUEST message;
     memset(&message, 0, sizeof(message));
 
-    Debug.AddLine("Enqueuing Expose request");
+    DEBUG_LOG(DBGLOG_CAMERA, DBGLOG_VERBOSE).AddLine("Enqueuing Expose request");
 
     message.request                      = REQUEST_EXPOSE;
     message.args.expose.pImage           = pImage;
@@ -100,7 +281,11 @@ void WorkerThread::EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposur
     message.args.expose.subframe = subframe;
     message.args.expose.pSemaphore       = NULL;
 
-    EnqueueMessage(message);
+    if (EnqueueMessage(message))
+    {
+        // report the exposure as failed so the frame is returned to the caller
+        SendWorkerThreadExposeComplete(pImage, true);
+    }
 }
 
 unsigned int WorkerThread::MilliSleep(int ms, unsigned int checkInterrupts)
@@ -142,10 +327,11 @@ bool WorkerThread::HandleExpose(MyFrame::EXPOSE_REQUEST *req)
 
         if (pCamera->HasNonGuiCapture())
         {
-            Debug.Write(wxString::Format("Handling exposure in thread, d=%d o=%x r=(%d,%d,%d,%d)\n", req->exposureDuration,
+            DEBUG_LOG(DBGLOG_CAMERA, DBGLOG_VERBOSE).Write(wxString::Format("Handling exposure in thread, d=%d o=%x r=(%d,%d,%d,%d)\n", req->exposureDuration,
                                          req->options, req->subframe.x, req->subframe.y, req->subframe.width, req->subframe.height));
 
             req->pImage->InitImgStartTime();
+            req->pImage->ImgStartMs = ::wxGetUTCTimeMillis();
 
             if (pCamera->Capture(req->exposureDuration, *req->pImage, req->options, req->subframe))
             {
@@ -154,12 +340,14 @@ bool WorkerThread::HandleExpose(MyFrame::EXPOSE_REQUEST *req)
         }
         else
         {
-            Debug.Write(wxString::Format("Handling exposure in myFrame, d=%d o=%x r=(%d,%d,%d,%d)\n", req->exposureDuration,
+            DEBUG_LOG(DBGLOG_CAMERA, DBGLOG_VERBOSE).Write(wxString::Format("Handling exposure in myFrame, d=%d o=%x r=(%d,%d,%d,%d)\n", req->exposureDuration,
                                          req->options, req->subframe.x, req->subframe.y, req->subframe.width, req->subframe.height));
 
             wxSemaphore semaphore;
             req->pSemaphore = &semaphore;
 
+            req->pImage->ImgStartMs = ::wxGetUTCTimeMillis();
+
             wxCommandEvent evt(REQUEST_EXPOSURE_EVENT, GetId());
             evt.SetClientData(req);
             wxQueueEvent(m_pFrame, evt.Clone());
@@ -171,24 +359,7 @@ bool WorkerThread::HandleExpose(MyFrame::EXPOSE_REQUEST *req)
             req->pSemaphore = NULL;
         }
 
-        Debug.AddLine("Exposure complete");
-
-        if (!bError)
-        {
-            switch (m_pFrame->GetNoiseReductionMethod())
-            {
-                case NR_NONE:
-                    break;
-                case NR_2x2MEAN:
-                    QuickLRecon(*req->pImage);
-                    break;
-                case NR_3x3MEDIAN:
-                    Median3(*req->pImage);
-                    break;
-            }
-
-            req->pImage->CalcStats();
-        }
+        DEBUG_LOG(DBGLOG_CAMERA, DBGLOG_VERBOSE).AddLine("Exposure complete");
     }
     catch (wxString Msg)
     {
@@ -196,36 +367,44 @@ bool WorkerThread::HandleExpose(MyFrame::EXPOSE_REQUEST *req)
         bError = true;
     }
 
+    // streaming cameras stamp the frame times themselves
+    if (req->pImage->ImgEndMs == 0)
+        req->pImage->ImgEndMs = ::wxGetUTCTimeMillis();
+
     return  bError;
 }
 
 void WorkerThread::SendWorkerThreadExposeComplete(usImage *pImage, bool bError)
 {
-    wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, MYFRAME_WORKER_THREAD_EXPOSE_COMPLETE);
-    event->SetPayload<usImage *>(pImage);
-    event->SetInt(bError);
-    wxQueueEvent(m_pFrame, event);
+    // noise reduction, stats and star measurement happen on the processing
+    // thread, which posts the completion event to the frame
+    assert(m_pFrame->m_pProcessingThread);
+    m_pFrame->m_pProcessingThread->EnqueueProcessingRequest(pImage, bError);
 }
 
 /*************      Move       **************************/
 
-void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *pMount, const PHD_Point& vectorEndpoint, bool normalMove)
+void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *pMount, const PHD_Point& vectorEndpoint, bool normalMove, const wxLongLong& frameEnd)
 {
     m_interruptRequested &= ~INT_STOP;
 
     WORKER_THREAD_REQUEST message;
     memset(&message, 0, sizeof(message));
 
-    Debug.AddLine(wxString::Format("Enqueuing Move request for %s (%.2f, %.2f)", pMount->GetMountClassName(), vectorEndpoint.X, vectorEndpoint.Y));
+    DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine(wxString::Format("Enqueuing Move request for %s (%.2f, %.2f)", pMount->GetMountClassName(), vectorEndpoint.X, vectorEndpoint.Y));
 
     message.request                   = REQUEST_MOVE;
     message.args.move.pMount          = pMount;
     message.args.move.calibrationMove = false;
     message.args.move.vectorEndpoint  = vectorEndpoint;
     message.args.move.normalMove      = normalMove;
+    message.args.move.frameEndMs      = frameEnd.GetValue();
     message.args.move.pSemaphore      = NULL;
 
-    EnqueueMessage(message);
+    if (EnqueueMessage(message))
+    {
+        SendWorkerThreadMoveComplete(pMount, Mount::MOVE_ERROR);
+    }
 }
 
 void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *pMount, const GUIDE_DIRECTION direction, int duration)
@@ -235,7 +414,7 @@ void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *pMount, const GUIDE_DIR
     WORKER_THREAD_REQUEST message;
     memset(&message, 0, sizeof(message));
 
-    Debug.AddLine("Enqueuing Calibration Move request for direction %d", direction);
+    DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine("Enqueuing Calibration Move request for direction %d", direction);
 
     message.request                   = REQUEST_MOVE;
     message.args.move.pMount          = pMount;
@@ -245,24 +424,29 @@ void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *pMount, const GUIDE_DIR
     message.args.move.normalMove      = true;
     message.args.move.pSemaphore      = NULL;
 
-    EnqueueMessage(message);
+    if (EnqueueMessage(message))
+    {
+        SendWorkerThreadMoveComplete(pMount, Mount::MOVE_ERROR);
+    }
 }
 
 Mount::MOVE_RESULT WorkerThread::HandleMove(MyFrame::PHD_MOVE_REQUEST *pArgs)
 {
     Mount::MOVE_RESULT result = Mount::MOVE_OK;
 
+    pArgs->pMount->SetLastMoveStartTime(::wxGetUTCTimeMillis());
+
     try
     {
         if (pArgs->pMount->HasNonGuiMove())
         {
-            Debug.AddLine(wxString::Format("Handling move in thread for %s dir=%d",
+            DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine(wxString::Format("Handling move in thread for %s dir=%d",
                     pArgs->pMount->GetMountClassName(),
                     pArgs->direction));
 
             if (pArgs->calibrationMove)
             {
-                Debug.AddLine("calibration move");
+                DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine("calibration move");
 
                 result = pArgs->pMount->CalibrationMove(pArgs->direction, pArgs->duration);
                 if (result != Mount::MOVE_OK)
@@ -272,7 +456,7 @@ Mount::MOVE_RESULT WorkerThread::HandleMove(MyFrame::PHD_MOVE_REQUEST *pArgs)
             }
             else
             {
-                Debug.AddLine(wxString::Format("endpoint = (%.2f, %.2f)",
+                DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine(wxString::Format("endpoint = (%.2f, %.2f)",
                     pArgs->vectorEndpoint.X, pArgs->vectorEndpoint.Y));
 
                 result = pArgs->pMount->Move(pArgs->vectorEndpoint, pArgs->normalMove);
@@ -287,7 +471,7 @@ Mount::MOVE_RESULT WorkerThread::HandleMove(MyFrame::PHD_MOVE_REQUEST *pArgs)
             // we don't have a non-gui guide function, so we send this to the
             // main frame routine that handles guides requests
 
-            Debug.AddLine("Sending move to myFrame");
+            DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine("Sending move to myFrame");
 
             wxSemaphore semaphore;
             pArgs->pSemaphore = &semaphore;
@@ -315,7 +499,10 @@ Mount::MOVE_RESULT WorkerThread::HandleMove(MyFrame::PHD_MOVE_REQUEST *pArgs)
             result = Mount::MOVE_ERROR;
     }
 
-    Debug.AddLine(wxString::Format("move complete, result=%d", result));
+    // lets the guider tell how much of an overlapped exposure was taken before this move finished
+    pArgs->pMount->SetLastMoveEndTime(::wxGetUTCTimeMillis());
+
+    DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine(wxString::Format("move complete, result=%d", result));
 
     return result;
 }
@@ -345,22 +532,11 @@ wxThread::ExitCode WorkerThread::Entry()
     while (!bDone)
     {
         WORKER_THREAD_REQUEST message;
-        bool dummy;
-        wxMessageQueueError queueError = m_wakeupQueue.Receive(dummy);
-
-        Debug.AddLine("Worker thread wakes up");
+        DequeueMessage(&message);
 
-        assert(queueError == wxMSGQUEUE_NO_ERROR);
+        wxLongLong_t dispatchTime = ::wxGetUTCTimeUSec().GetValue();
 
-        queueError = m_highPriorityQueue.ReceiveTimeout(0, message);
-
-        if (queueError == wxMSGQUEUE_TIMEOUT)
-        {
-            queueError = m_lowPriorityQueue.ReceiveTimeout(0, message);
-            assert(queueError != wxMSGQUEUE_TIMEOUT);
-        }
-
-        assert(queueError == wxMSGQUEUE_NO_ERROR);
+        DEBUG_LOG(DBGLOG_GENERAL, DBGLOG_VERBOSE).AddLine("Worker thread wakes up");
 
         switch(message.request)
         {
@@ -374,16 +550,26 @@ wxThread::ExitCode WorkerThread::Entry()
                 bDone = true;
                 break;
             case REQUEST_EXPOSE:
-                Debug.AddLine("worker thread servicing REQUEST_EXPOSE %d",
+                DEBUG_LOG(DBGLOG_CAMERA, DBGLOG_VERBOSE).AddLine("worker thread servicing REQUEST_EXPOSE %d",
                     message.args.expose.exposureDuration);
                 bError = HandleExpose(&message.args.expose);
+                RecordLatency(message, dispatchTime, ::wxGetUTCTimeUSec().GetValue());
                 SendWorkerThreadExposeComplete(message.args.expose.pImage, bError);
                 break;
             case REQUEST_MOVE: {
-                Debug.AddLine(wxString::Format("worker thread servicing REQUEST_MOVE %s dir %d (%.2f, %.2f)",
+                DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE).AddLine(wxString::Format("worker thread servicing REQUEST_MOVE %s dir %d (%.2f, %.2f)",
                     message.args.move.pMount->GetMountClassName(), message.args.move.direction,
                     message.args.move.vectorEndpoint.X, message.args.move.vectorEndpoint.Y));
+                if (message.args.move.frameEndMs)
+                {
+                    // the pulse goes out now; how long after the camera finished the frame?
+                    double frameToPulseMs = (double)(dispatchTime / 1000 - message.args.move.frameEndMs);
+                    Debug.AddLine(wxString::Format("camera to pulse latency %.0f ms", frameToPulseMs));
+                    wxCriticalSectionLocker lock(m_statsLock);
+                    m_stats.frameToPulse.Add(frameToPulseMs);
+                }
                 Mount::MOVE_RESULT moveResult = HandleMove(&message.args.move);
+                RecordLatency(message, dispatchTime, ::wxGetUTCTimeUSec().GetValue());
                 SendWorkerThreadMoveComplete(message.args.move.pMount, moveResult);
                 break;
             }
@@ -392,10 +578,12 @@ wxThread::ExitCode WorkerThread::Entry()
                 break;
         }
 
-        Debug.AddLine("worker thread done servicing request");
+        DEBUG_LOG(DBGLOG_GENERAL, DBGLOG_VERBOSE).AddLine("worker thread done servicing request");
         bDone |= TestDestroy();
     }
 
+    LogLatencyStats();
+
     Debug.AddLine("WorkerThread::Entry() ends");
     Debug.Flush();
 
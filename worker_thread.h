@@ -44,17 +44,63 @@ class MyFrame;
  * second mount, so that on systems with two mounts (probably an AO and a telescope), the
  * second mount can be moving while we image and guide with the first mount.
  *
- * The worker threads have three queues, one for move requests (higher priority)
- * and one for exposure requests (lower priority) and one "wakeup queue". The wx queue
- * routines do not have a way to wait on multiple queues, so there is no easy way
- * to implement the dual queue priority model without a third queue.
+ * Each worker thread has two fixed size request rings, one for move requests (higher
+ * priority) and one for exposure requests (lower priority).  Both rings are guarded by
+ * a single mutex, and a single condition wakes the thread when something is enqueued
+ * on either of them.  The thread then takes the work item from the high priority ring
+ * if there is one, and from the low priority ring otherwise.
  *
- * When something is enqueued on either of the work queues, a dummy message is
- * also enqueued on the wakeup queue, which wakes the thread up.  It then finds
- * the work item by looking first on the high priority queue and then the low
- * priority queue.
+ * The number of outstanding requests is small (one exposure, and a move or two per
+ * mount), so the rings never fill up in practice.  If one does, the request is not
+ * queued and its completion is reported right away with an error.  The caller must
+ * not wait for a free slot: it is usually the main thread, and the worker thread may
+ * itself be waiting for the main thread (see REQUEST_EXPOSURE_EVENT).  A terminate
+ * request that finds the ring full is recorded in m_terminatePending instead.
  *
+ * Each request is timestamped when it is enqueued, when the worker thread picks it up
+ * and when the worker thread is done with it.  The time spent waiting in the ring and
+ * the time spent servicing the request are accumulated in per request type histograms
+ * which can be fetched with GetLatencyStats().
+ *
+ */
+
+/*
+ * Histogram of request latencies. Bucket i counts the requests whose latency
+ * was less than BucketLimitMs(i) (and not less than the previous limit); the
+ * last bucket has no upper limit.
  */
+struct LatencyHistogram
+{
+    enum { NUM_BUCKETS = 15 };
+
+    unsigned int count;
+    double totalMs;
+    double maxMs;
+    unsigned int buckets[NUM_BUCKETS];
+
+    void Reset(void);
+    void Add(double ms);
+    double MeanMs(void) const;
+    static double BucketLimitMs(int bucket);
+};
+
+struct WorkerLatencyStats
+{
+    enum RequestKind
+    {
+        KIND_EXPOSE,
+        KIND_MOVE,
+        KIND_CALIBRATION_MOVE,
+        NUM_KINDS
+    };
+
+    LatencyHistogram queued[NUM_KINDS];     // enqueue to dispatch
+    LatencyHistogram service[NUM_KINDS];    // dispatch to completion
+    LatencyHistogram frameToPulse;          // end of the guide exposure to dispatch of its correction
+
+    void Reset(void);
+    static const char *KindName(int kind);
+};
 
 class WorkerThread : public wxThread
 {
@@ -86,14 +132,39 @@ class WorkerThread : public wxThread
     {
         WORKER_REQUEST_TYPE request;
         WORKER_REQUEST_ARGS args;
+        wxLongLong_t enqueueTime;   // microseconds
+    };
+
+    /*
+    * fixed size FIFO of requests, guarded by WorkerThread::m_queueLock
+    */
+    class RequestRing
+    {
+        enum { RING_SIZE = 16 };
+
+        WORKER_THREAD_REQUEST m_slots[RING_SIZE];
+        unsigned int m_head;
+        unsigned int m_count;
+
+    public:
+        RequestRing() : m_head(0), m_count(0) { }
+        bool Empty(void) const { return m_count == 0; }
+        bool Full(void) const { return m_count == RING_SIZE; }
+        WORKER_THREAD_REQUEST& Push(const WORKER_THREAD_REQUEST& request);
+        void Pop(WORKER_THREAD_REQUEST *request);
     };
 
     MyFrame *m_pFrame;
     volatile unsigned int m_interruptRequested;
     volatile bool m_killable;
-    wxMessageQueue<bool> m_wakeupQueue;
-    wxMessageQueue<WORKER_THREAD_REQUEST> m_highPriorityQueue;
-    wxMessageQueue<WORKER_THREAD_REQUEST> m_lowPriorityQueue;
+    wxMutex m_queueLock;
+    wxCondition m_queueNotEmpty;
+    RequestRing m_highPriorityRing;
+    RequestRing m_lowPriorityRing;
+    bool m_terminatePending;
+
+    wxCriticalSection m_statsLock;
+    WorkerLatencyStats m_stats;
 
 public:
 
@@ -112,6 +183,9 @@ public:
 
     static WorkerThread *This(void);
 
+    void GetLatencyStats(WorkerLatencyStats *stats);
+    void ResetLatencyStats(void);
+
 private:
     wxThread::ExitCode Entry();
 
@@ -159,18 +233,22 @@ public:
 protected:
     bool HandleExpose(MyFrame::EXPOSE_REQUEST *pArgs);
     void SendWorkerThreadExposeComplete(usImage *pImage, bool bError);
-    // in the frame class: void MyFrame::OnWorkerThreadExposeComplete(wxThreadEvent& event);
+    // the frame goes on to the ProcessingThread, which posts the completion event
+    // handled by void MyFrame::OnExposeComplete(wxThreadEvent& event);
 
     /*************      Guide       **************************/
 public:
-    void EnqueueWorkerThreadMoveRequest(Mount *pMount, const PHD_Point& vectorEndpoint, bool normalMove);
+    void EnqueueWorkerThreadMoveRequest(Mount *pMount, const PHD_Point& vectorEndpoint, bool normalMove, const wxLongLong& frameEnd = 0);
     void EnqueueWorkerThreadMoveRequest(Mount *pMount, const GUIDE_DIRECTION direction, int duration);
 protected:
     Mount::MOVE_RESULT HandleMove(MyFrame::PHD_MOVE_REQUEST *pArgs);
     void SendWorkerThreadMoveComplete(Mount *pMount, Mount::MOVE_RESULT moveResult);
     // in the frame class: void MyFrame::OnWorkerThreadGuideComplete(wxThreadEvent& event);
 
-    void EnqueueMessage(const WORKER_THREAD_REQUEST& message);
+    bool EnqueueMessage(const WORKER_THREAD_REQUEST& message);
+    void DequeueMessage(WORKER_THREAD_REQUEST *message);
+    void RecordLatency(const WORKER_THREAD_REQUEST& message, wxLongLong_t dispatchTime, wxLongLong_t completeTime);
+    void LogLatencyStats(void);
 };
 
 inline void WorkerThread::RequestStop(void)